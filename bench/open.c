@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "eizo/handle.h"
+#include "eizo/control.h"
+
+// Compares the latency of an eager and a lazy open, each followed by the
+// first command a hot-key daemon would issue.
+//
+// The monitor is taken from $EIZO_BENCH_DEVICE, e.g. /dev/hidraw3.
+
+static double
+now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+static int
+bench(const char *device, enum eizo_open_flags flags, int iterations, const char *name)
+{
+    double total = 0.0, min = 0.0, max = 0.0;
+
+    for (int i = 0; i < iterations; ++i) {
+        double start = now_ms();
+
+        eizo_handle_t handle = nullptr;
+        enum eizo_result res = eizo_open_ex(device, flags, &handle);
+        if (res < EIZO_SUCCESS) {
+            fprintf(stderr, "%s: open failed %i\n", name, res);
+            return -1;
+        }
+
+        int brightness = 0;
+        res = eizo_get_brightness(handle, &brightness);
+        double t = now_ms() - start;
+
+        eizo_close(handle);
+        if (res < EIZO_SUCCESS) {
+            fprintf(stderr, "%s: get brightness failed %i\n", name, res);
+            return -1;
+        }
+
+        total += t;
+        if (i == 0 || t < min) {
+            min = t;
+        }
+        if (t > max) {
+            max = t;
+        }
+    }
+
+    printf("%-6s %4i runs, mean %8.3f ms, min %8.3f ms, max %8.3f ms\n",
+           name, iterations, total / iterations, min, max);
+    return 0;
+}
+
+int
+main(int argc, const char *argv[])
+{
+    const char *device = getenv("EIZO_BENCH_DEVICE");
+    if (!device) {
+        fprintf(stderr, "EIZO_BENCH_DEVICE is not set, skipping.\n");
+        return 77;
+    }
+
+    int iterations = 20;
+    if (argc > 1) {
+        iterations = atoi(argv[1]);
+        if (iterations <= 0) {
+            fprintf(stderr, "Invalid iteration count\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (bench(device, EIZO_OPEN_DEFAULT, iterations, "eager") < 0) {
+        return EXIT_FAILURE;
+    }
+    if (bench(device, EIZO_OPEN_LAZY, iterations, "lazy") < 0) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,620 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <limits.h>
+#include <errno.h>
+#include <math.h>
+
+#include <unistd.h>
+#include <pthread.h>
+
+#include "eizo/handle.h"
+#include "eizo/control.h"
+#include "eizo/emulator.h"
+#include "eizo/eeprom.h"
+#include "eizo/lut.h"
+#include "internal.h"
+
+// Measures the hot paths of the library against the emulator, so the
+// numbers only depend on the library itself. Every operation reports the
+// wall time percentiles, the number of feature report requests and the
+// number of heap allocations per iteration.
+//
+// $EIZO_BENCH_LATENCY_US adds a delay to every request, to get an idea of
+// the time spent on a real monitor. $EIZO_BENCH_EEPROM_AUTOINCREMENT makes
+// the emulated EEPROM advance its address on every access.
+// $EIZO_BENCH_DESCRIPTORS is a colon separated list of raw secondary
+// descriptor dumps to parse, by default the descriptor of the emulator is
+// used.
+
+static atomic_ulong allocations;
+
+// Allocations are counted by replacing the allocator entry points and
+// forwarding to glibc's own, which glibc supports for every allocation it
+// makes itself as well, e.g. in strdup() or on behalf of libsystemd. With
+// another libc the alloc column reads nan.
+#ifdef __GLIBC__
+#define BENCH_COUNT_ALLOCATIONS 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+void *
+malloc(size_t size)
+{
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *
+calloc(size_t n, size_t size)
+{
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __libc_calloc(n, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+void *
+reallocarray(void *ptr, size_t n, size_t size)
+{
+    size_t bytes;
+    if (__builtin_mul_overflow(n, size, &bytes)) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __libc_realloc(ptr, bytes);
+}
+
+void *
+aligned_alloc(size_t alignment, size_t size)
+{
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+void *
+memalign(size_t alignment, size_t size)
+{
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+int
+posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+    if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    void *p = __libc_memalign(alignment, size);
+    if (!p) {
+        return ENOMEM;
+    }
+    *ptr = p;
+    return 0;
+}
+
+void
+free(void *ptr)
+{
+    __libc_free(ptr);
+}
+#else
+#define BENCH_COUNT_ALLOCATIONS 0
+#endif
+
+struct bench {
+    eizo_emulator_t emu;
+    eizo_handle_t handle;
+    enum eizo_open_flags flags;
+    const uint8_t *desc;
+    size_t desc_len;
+    float lut[3][EIZO_LUT_ENTRIES];
+    size_t lut_iteration;
+    const struct eizo_control_table *ctrl;
+    size_t n_ctrl;
+    uint8_t event_value;
+    atomic_bool stop;
+};
+
+typedef enum eizo_result (*bench_fn)(struct bench *b);
+
+static uint64_t
+now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static int
+compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int
+run(struct bench *b, const char *name, int iterations, bench_fn fn)
+{
+    uint64_t *samples = calloc((size_t)iterations, sizeof(uint64_t));
+    if (!samples) {
+        return -1;
+    }
+
+    uint64_t requests = eizo_emulator_get_request_count(b->emu);
+    unsigned long allocs = atomic_load(&allocations);
+
+    for (int i = 0; i < iterations; ++i) {
+        uint64_t start = now_ns();
+        enum eizo_result res = fn(b);
+        samples[i] = now_ns() - start;
+
+        if (res < EIZO_SUCCESS) {
+            fprintf(stderr, "%s: failed at iteration %i. %i\n", name, i, res);
+            free(samples);
+            return -1;
+        }
+    }
+
+    allocs = atomic_load(&allocations) - allocs;
+    requests = eizo_emulator_get_request_count(b->emu) - requests;
+
+    qsort(samples, (size_t)iterations, sizeof(uint64_t), compare_u64);
+
+    size_t n = (size_t)iterations;
+    printf("%-16s %6i runs  p50 %10.3f us  p90 %10.3f us  p99 %10.3f us  %7.1f req  %7.1f alloc\n",
+           name, iterations,
+           (double)samples[n * 50 / 100] / 1e3,
+           (double)samples[n * 90 / 100] / 1e3,
+           (double)samples[n * 99 / 100] / 1e3,
+           (double)requests / iterations,
+           BENCH_COUNT_ALLOCATIONS ? (double)allocs / iterations : NAN);
+
+    free(samples);
+    return 0;
+}
+
+static enum eizo_result
+bench_open(struct bench *b)
+{
+    eizo_handle_t handle = nullptr;
+    enum eizo_result res = eizo_emulator_open(b->emu, b->flags, &handle);
+    if (res >= EIZO_SUCCESS) {
+        eizo_close(handle);
+    }
+    return res;
+}
+
+static enum eizo_result
+bench_get_short(struct bench *b)
+{
+    uint8_t value[2];
+    return eizo_get_value(b->handle, EIZO_USAGE_BRIGHTNESS, value, sizeof(value));
+}
+
+static enum eizo_result
+bench_set_short(struct bench *b)
+{
+    uint8_t value[2] = { 120, 0 };
+    return eizo_set_value(b->handle, EIZO_USAGE_BRIGHTNESS, value, sizeof(value));
+}
+
+// A get right after another client took over the monitor.
+static enum eizo_result
+bench_get_race(struct bench *b)
+{
+    eizo_emulator_bump_counter(b->emu);
+    return bench_get_short(b);
+}
+
+static enum eizo_result
+bench_get_long(struct bench *b)
+{
+    uint8_t value[256];
+    return eizo_get_value(b->handle, EIZO_USAGE_EDID, value, sizeof(value));
+}
+
+static enum eizo_result
+bench_set_long(struct bench *b)
+{
+    uint8_t value[256] = {};
+    return eizo_set_value(b->handle, EIZO_USAGE_EDID, value, sizeof(value));
+}
+
+static enum eizo_result
+bench_custom_key_lock(struct bench *b)
+{
+    uint8_t *data = nullptr;
+    size_t len = 0;
+    enum eizo_result res = eizo_get_available_custom_key_lock_raw(b->handle, &data, &len);
+    free(data);
+    return res;
+}
+
+static enum eizo_result
+bench_eeprom(struct bench *b)
+{
+    uint8_t buf[EIZO_EEPROM_SIZE];
+    return eizo_read_eeprom(b->handle, 0, sizeof(buf), buf);
+}
+
+// Touch a single entry per iteration, like a small calibration tweak.
+static enum eizo_result
+bench_lut_delta(struct bench *b)
+{
+    size_t i = b->lut_iteration++ % EIZO_LUT_ENTRIES;
+    b->lut[1][i] = b->lut[1][i] > 0.5f ? b->lut[1][i] - 0.25f : b->lut[1][i] + 0.25f;
+    return eizo_write_lut(b->handle, EIZO_LUT_FRONT, b->lut[0], b->lut[1], b->lut[2], nullptr);
+}
+
+static enum eizo_result
+bench_lut_full(struct bench *b)
+{
+    eizo_invalidate_lut(b->handle, EIZO_LUT_FRONT);
+    return eizo_write_lut(b->handle, EIZO_LUT_FRONT, b->lut[0], b->lut[1], b->lut[2], nullptr);
+}
+
+// Keep uploading the whole front LUT until told to stop.
+static void *
+lut_writer(void *arg)
+{
+    struct bench *b = arg;
+    while (!atomic_load(&b->stop)) {
+        if (bench_lut_full(b) < EIZO_SUCCESS) {
+            break;
+        }
+    }
+    return nullptr;
+}
+
+// Short gets while another thread keeps writing the LUT through the same
+// handle, opened with flags.
+static int
+run_contended(struct bench *b, const char *name, int iterations, enum eizo_open_flags flags)
+{
+    eizo_close(b->handle);
+    b->handle = nullptr;
+    if (eizo_emulator_open(b->emu, flags, &b->handle) < EIZO_SUCCESS) {
+        return -1;
+    }
+
+    pthread_t writer;
+    atomic_store(&b->stop, false);
+    if (pthread_create(&writer, nullptr, lut_writer, b) != 0) {
+        return -1;
+    }
+
+    int rc = run(b, name, iterations, bench_get_short);
+
+    atomic_store(&b->stop, true);
+    pthread_join(writer, nullptr);
+
+    eizo_close(b->handle);
+    b->handle = nullptr;
+    if (eizo_emulator_open(b->emu, EIZO_OPEN_DEFAULT, &b->handle) < EIZO_SUCCESS) {
+        return -1;
+    }
+    return rc;
+}
+
+// Look up every control of the handle once.
+static enum eizo_result
+bench_find(struct bench *b)
+{
+    for (size_t i = 0; i < b->n_ctrl; ++i) {
+        if (!eizo_control_find(b->handle, b->ctrl->usage[i], nullptr)) {
+            return EIZO_ERROR_INVALID_USAGE;
+        }
+    }
+    return EIZO_SUCCESS;
+}
+
+static int
+compare_usage(const void *a, const void *b)
+{
+    enum eizo_usage x = *(const enum eizo_usage *)a, y = *(const enum eizo_usage *)b;
+    return (x > y) - (x < y);
+}
+
+// The same with bsearch(), like eizo_control_find() used to.
+static enum eizo_result
+bench_find_bsearch(struct bench *b)
+{
+    for (size_t i = 0; i < b->n_ctrl; ++i) {
+        const enum eizo_usage *usage = b->ctrl->usage;
+        if (!bsearch(&usage[i], usage, b->n_ctrl, sizeof(usage[0]), compare_usage)) {
+            return EIZO_ERROR_INVALID_USAGE;
+        }
+    }
+    return EIZO_SUCCESS;
+}
+
+static int
+run_find(struct bench *b, const char *name, int iterations, bench_fn fn)
+{
+    uint64_t start = now_ns();
+    if (run(b, name, iterations, fn) < 0) {
+        return -1;
+    }
+    double ns = (double)(now_ns() - start);
+    printf("%-16s %zu controls, %.1f ns/lookup\n", "", b->n_ctrl, ns / iterations / (double)b->n_ctrl);
+    return 0;
+}
+
+// An input report from the monitor, decoded and dispatched.
+static enum eizo_result
+bench_event(struct bench *b)
+{
+    uint8_t value[2] = { b->event_value++ % 200, 0 };
+    eizo_emulator_set_value(b->emu, EIZO_USAGE_BRIGHTNESS, value, sizeof(value));
+    return eizo_dispatch(b->handle) == 1 ? EIZO_SUCCESS : EIZO_ERROR_IO;
+}
+
+static void
+bench_event_cb(eizo_handle_t, const struct eizo_value_event *, void *)
+{
+}
+
+// The shared controls behind the table of a handle.
+static struct eizo_controls *
+bench_controls(const struct eizo_control_table *table)
+{
+    return (struct eizo_controls *)((uintptr_t)table - offsetof(struct eizo_controls, table));
+}
+
+// Lookups and input reports on a monitor with about as many controls as
+// a real one, once through the page index and once through the binary
+// search it falls back to.
+static int
+run_events(const struct eizo_emulator_config *config, int iterations)
+{
+    struct eizo_emulator_config c = *config;
+    c.extra_controls = 160;
+
+    struct bench b = {};
+    if (eizo_emulator_new(&c, &b.emu) < EIZO_SUCCESS) {
+        return -1;
+    }
+
+    int rc = -1;
+    if (eizo_emulator_open(b.emu, EIZO_OPEN_DEFAULT, &b.handle) < EIZO_SUCCESS ||
+        eizo_add_value_callback(b.handle, 0, bench_event_cb, nullptr) < EIZO_SUCCESS)
+    {
+        goto end;
+    }
+
+    b.n_ctrl = eizo_get_controls(b.handle, &b.ctrl);
+    struct eizo_controls *ctrl = bench_controls(b.ctrl);
+    uint16_t *slots = ctrl->index.slots;
+    if (!slots) {
+        fprintf(stderr, "event: %zu controls have no index\n", b.n_ctrl);
+        goto end;
+    }
+
+    if (run_find(&b, "find index", iterations, bench_find) < 0 ||
+        run(&b, "event index", iterations, bench_event) < 0)
+    {
+        goto end;
+    }
+
+    // Without slots every lookup takes the binary search. No other handle
+    // shares the table, its descriptor is unlike the one of the others.
+    ctrl->index.slots = nullptr;
+    if (run_find(&b, "find search", iterations, bench_find) < 0 ||
+        run(&b, "event search", iterations, bench_event) < 0)
+    {
+        ctrl->index.slots = slots;
+        goto end;
+    }
+    ctrl->index.slots = slots;
+    rc = 0;
+
+end:
+    if (b.handle) {
+        eizo_close(b.handle);
+    }
+    eizo_emulator_free(b.emu);
+    return rc;
+}
+
+static enum eizo_result
+bench_parse(struct bench *b)
+{
+    // Count, then fill, like a handle does.
+    alignas(enum eizo_usage) uint8_t block[256 * EIZO_CONTROL_ENTRY_SIZE];
+    struct eizo_control_table table = { .n = 256 };
+    enum eizo_result res = eizo_parse_descriptor(b->desc, b->desc_len, &table);
+    if (res < EIZO_SUCCESS) {
+        return res;
+    }
+
+    eizo_control_table_init(&table, block, table.n);
+    return eizo_parse_descriptor(b->desc, b->desc_len, &table);
+}
+
+static int
+run_parse(struct bench *b, const char *name, int iterations)
+{
+    uint64_t start = now_ns();
+    if (run(b, name, iterations, bench_parse) < 0) {
+        return -1;
+    }
+    double s = (double)(now_ns() - start) / 1e9;
+    printf("%-16s %zu bytes, %.1f MiB/s\n", "", b->desc_len,
+           (double)b->desc_len * iterations / s / (1024 * 1024));
+    return 0;
+}
+
+static int
+parse_files(struct bench *b, const char *list, int iterations)
+{
+    char *paths = strdup(list);
+    if (!paths) {
+        return -1;
+    }
+
+    int rc = 0;
+    char *save = nullptr;
+    for (char *path = strtok_r(paths, ":", &save); path; path = strtok_r(nullptr, ":", &save)) {
+        FILE *f = fopen(path, "rb");
+        if (!f) {
+            fprintf(stderr, "Failed to open %s\n", path);
+            rc = -1;
+            break;
+        }
+
+        uint8_t desc[4096];
+        size_t len = fread(desc, 1, sizeof(desc), f);
+        fclose(f);
+
+        b->desc = desc;
+        b->desc_len = len;
+        const char *base = strrchr(path, '/');
+        if (run_parse(b, base ? base + 1 : path, iterations) < 0) {
+            rc = -1;
+            break;
+        }
+    }
+
+    free(paths);
+    return rc;
+}
+
+int
+main(int argc, const char *argv[])
+{
+    int iterations = 200;
+    if (argc > 1) {
+        iterations = atoi(argv[1]);
+        if (iterations <= 0) {
+            fprintf(stderr, "Invalid iteration count\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Keep the descriptor cache of the warm open away from the user's.
+    char cache[] = "/tmp/eizo-bench-XXXXXX";
+    if (!mkdtemp(cache)) {
+        return EXIT_FAILURE;
+    }
+    setenv("XDG_CACHE_HOME", cache, 1);
+
+    const char *latency = getenv("EIZO_BENCH_LATENCY_US");
+    struct eizo_emulator_config config = {
+        .pid = EIZO_PID_FLEXSCAN_EV2760,
+        .serial = 12345678,
+        .product = "EV2760",
+        .latency_us = latency ? (unsigned)atoi(latency) : 0,
+        .eeprom_autoincrement = getenv("EIZO_BENCH_EEPROM_AUTOINCREMENT") != nullptr,
+    };
+
+    struct bench b = {};
+    if (eizo_emulator_new(&config, &b.emu) < EIZO_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+
+    int rc = EXIT_FAILURE;
+
+    b.flags = EIZO_OPEN_DEFAULT;
+    if (run(&b, "open cold", iterations, bench_open) < 0) {
+        goto end;
+    }
+
+    b.flags = EIZO_OPEN_CACHE_DESCRIPTOR;
+    if (bench_open(&b) < EIZO_SUCCESS || run(&b, "open warm", iterations, bench_open) < 0) {
+        goto end;
+    }
+
+    // Another handle of the same model holds the control table. Every open
+    // takes over the monitor, so this one is closed again afterwards.
+    if (eizo_emulator_open(b.emu, EIZO_OPEN_DEFAULT, &b.handle) < EIZO_SUCCESS) {
+        goto end;
+    }
+    b.flags = EIZO_OPEN_DEFAULT;
+    if (run(&b, "open shared", iterations, bench_open) < 0) {
+        goto end;
+    }
+    eizo_close(b.handle);
+    b.handle = nullptr;
+
+    if (eizo_emulator_open(b.emu, EIZO_OPEN_DEFAULT, &b.handle) < EIZO_SUCCESS) {
+        goto end;
+    }
+
+    if (run(&b, "get 39", iterations, bench_get_short) < 0 ||
+        run(&b, "get 39 race", iterations, bench_get_race) < 0 ||
+        run(&b, "set 39", iterations, bench_set_short) < 0 ||
+        run(&b, "get 519", iterations, bench_get_long) < 0 ||
+        run(&b, "set 519", iterations, bench_set_long) < 0 ||
+        run(&b, "custom key lock", iterations, bench_custom_key_lock) < 0 ||
+        run(&b, "eeprom 512", iterations / 10 + 1, bench_eeprom) < 0 ||
+        eizo_read_lut(b.handle, EIZO_LUT_FRONT, b.lut[0], b.lut[1], b.lut[2]) < EIZO_SUCCESS ||
+        run(&b, "lut full", iterations, bench_lut_full) < 0 ||
+        run(&b, "lut delta", iterations, bench_lut_delta) < 0 ||
+        run_contended(&b, "get 39 lut", iterations, EIZO_OPEN_DEFAULT) < 0 ||
+        run_contended(&b, "get 39 lut io", iterations, EIZO_OPEN_IO_WORKER) < 0)
+    {
+        goto end;
+    }
+
+    b.n_ctrl = eizo_get_controls(b.handle, &b.ctrl);
+    if (run_find(&b, "find", iterations * 10, bench_find) < 0 ||
+        run_find(&b, "find bsearch", iterations * 10, bench_find_bsearch) < 0)
+    {
+        goto end;
+    }
+
+    if (run_events(&config, iterations * 10) < 0) {
+        goto end;
+    }
+
+    const char *files = getenv("EIZO_BENCH_DESCRIPTORS");
+    if (files) {
+        if (parse_files(&b, files, iterations * 10) < 0) {
+            goto end;
+        }
+    } else {
+        uint8_t desc[4096];
+        size_t len = 0;
+        if (eizo_get_secondary_descriptor(b.handle, desc, &len) < EIZO_SUCCESS) {
+            goto end;
+        }
+        b.desc = desc;
+        b.desc_len = len;
+        if (run_parse(&b, "parse", iterations * 10) < 0) {
+            goto end;
+        }
+    }
+
+    rc = EXIT_SUCCESS;
+
+end:
+    if (b.handle) {
+        eizo_close(b.handle);
+    }
+    eizo_emulator_free(b.emu);
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/libeizo/%04x-%04x-%lu.ctl", cache, EIZO_VID, config.pid, config.serial);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/libeizo", cache);
+    rmdir(path);
+    rmdir(cache);
+    return rc;
+}
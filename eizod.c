@@ -0,0 +1,514 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <stddef.h>
+
+#include <sys/epoll.h>
+
+#include <time.h>
+
+#include <systemd/sd-bus.h>
+#include <systemd/sd-event.h>
+
+#include "eizo/handle.h"
+#include "eizo/monitor.h"
+#include "eizo/snapshot.h"
+
+// eizod owns the handles of every Eizo monitor of the session and serves
+// them on the user bus, so clients neither open the hidraw nodes nor take
+// the handle counter from each other. Every monitor is an object below
+// EIZOD_PATH, named after its serial, and the object manager announces
+// them as they come and go.
+//
+// Reads are answered from the value cache of the handle, which input
+// reports and writes keep coherent. Requests of all clients are served
+// one at a time from the event loop, so the monitor sees them back to
+// back. Changes are broadcast as ValueChanged, which is all there is to
+// subscribing.
+//
+// Widgets that only show the basics can skip the bus after GetSnapshot,
+// the memfd it returns holds the decoded state of every monitor and is
+// read without a syscall, see eizo/snapshot.h.
+
+static const char EIZOD_NAME[] = "org.libeizo.eizod";
+static const char EIZOD_PATH[] = "/org/libeizo/eizod";
+static const char EIZOD_INTERFACE[] = "org.libeizo.eizod.Monitor";
+static const char EIZOD_MANAGER_INTERFACE[] = "org.libeizo.eizod.Manager";
+
+constexpr unsigned EIZOD_DEFAULT_TTL_MS = 30000;
+
+// Temperatures and the usage time change without an input report, so the
+// snapshot is read again from the monitors this often.
+constexpr uint64_t EIZOD_REFRESH_USEC = 60 * 1000000ull;
+
+// Largest value a feature report carries.
+constexpr size_t EIZOD_MAX_VALUE_SIZE = 512;
+
+struct eizod_monitor {
+    struct eizod_monitor *next;
+    struct eizod *daemon;
+    eizo_handle_t handle;
+    char *devname;
+    char *path;
+    sd_bus_slot *slot;
+    sd_event_source *input;
+    // SIZE_MAX if all slots of the snapshot are taken.
+    size_t snapshot_slot;
+    struct eizo_snapshot_monitor state;
+};
+
+struct eizod {
+    sd_event *event;
+    sd_bus *bus;
+    eizo_monitor_t monitor;
+    unsigned ttl_ms;
+    struct eizod_monitor *monitors;
+    eizo_snapshot_t snapshot;
+    struct eizod_monitor *slots[EIZO_SNAPSHOT_SLOTS];
+    sd_event_source *refresh;
+};
+
+void
+print_help()
+{
+    printf("Usage: ./eizod [options]\n");
+    printf("\n");
+    printf("Options:\n");
+    printf("\t--ttl <ms> - How long a value read from a monitor is served from memory. Default %u.\n",
+           EIZOD_DEFAULT_TTL_MS);
+    printf("\t--help     - Show this help message.\n");
+}
+
+static int
+eizod_error(sd_bus_error *error, enum eizo_result res)
+{
+    switch (res) {
+        case EIZO_ERROR_INVALID_USAGE:
+            return sd_bus_error_set(error, "org.libeizo.eizod.InvalidUsage", "The monitor has no such usage.");
+        case EIZO_ERROR_INVALID_ARGUMENT:
+        case EIZO_ERROR_OUT_OF_RANGE:
+            return sd_bus_error_setf(error, SD_BUS_ERROR_INVALID_ARGS, "Invalid value. %i", res);
+        case EIZO_ERROR_NO_MEMORY:
+            return sd_bus_error_set(error, SD_BUS_ERROR_NO_MEMORY, nullptr);
+        default:
+            return sd_bus_error_setf(error, SD_BUS_ERROR_IO_ERROR, "Request failed. %i", res);
+    }
+}
+
+static void
+eizod_emit_value(struct eizod_monitor *mon, uint32_t usage, const uint8_t *value, size_t len)
+{
+    [[gnu::cleanup(sd_bus_message_unrefp)]]
+    sd_bus_message *m = nullptr;
+
+    int ret = sd_bus_message_new_signal(mon->daemon->bus, &m, mon->path, EIZOD_INTERFACE, "ValueChanged");
+    if (ret >= 0) {
+        ret = sd_bus_message_append(m, "u", usage);
+    }
+    if (ret >= 0) {
+        ret = sd_bus_message_append_array(m, 'y', value, len);
+    }
+    if (ret >= 0) {
+        ret = sd_bus_send(mon->daemon->bus, m, nullptr);
+    }
+    if (ret < 0) {
+        fprintf(stderr, "%s: failed to emit %08x on %s. %s\n", __func__, usage, mon->path, strerror(-ret));
+    }
+}
+
+static void
+eizod_snapshot_publish(struct eizod_monitor *mon)
+{
+    if (mon->snapshot_slot != SIZE_MAX) {
+        eizo_snapshot_update(mon->daemon->snapshot, mon->snapshot_slot, &mon->state);
+    }
+}
+
+static void
+eizod_snapshot_refresh(struct eizod_monitor *mon)
+{
+    eizo_snapshot_monitor_refresh(mon->handle, &mon->state);
+    eizod_snapshot_publish(mon);
+}
+
+static void
+eizod_value_changed(struct eizod_monitor *mon, uint32_t usage, const uint8_t *value, size_t len)
+{
+    eizod_emit_value(mon, usage, value, len);
+    if (eizo_snapshot_monitor_apply(mon->handle, &mon->state, usage, value, len)) {
+        eizod_snapshot_publish(mon);
+    }
+}
+
+static int
+eizod_get_value(sd_bus_message *m, void *userdata, sd_bus_error *error)
+{
+    struct eizod_monitor *mon = userdata;
+
+    uint32_t usage = 0;
+    int ret = sd_bus_message_read(m, "u", &usage);
+    if (ret < 0) {
+        return ret;
+    }
+
+    uint8_t value[EIZOD_MAX_VALUE_SIZE];
+    size_t len = eizo_get_value_size(mon->handle, usage);
+    if (len == 0) {
+        return eizod_error(error, EIZO_ERROR_INVALID_USAGE);
+    }
+    if (len > sizeof(value)) {
+        return eizod_error(error, EIZO_ERROR_BAD_DATA);
+    }
+
+    enum eizo_result res = eizo_get_value(mon->handle, usage, value, len);
+    if (res < EIZO_SUCCESS) {
+        return eizod_error(error, res);
+    }
+
+    [[gnu::cleanup(sd_bus_message_unrefp)]]
+    sd_bus_message *reply = nullptr;
+
+    ret = sd_bus_message_new_method_return(m, &reply);
+    if (ret >= 0) {
+        ret = sd_bus_message_append_array(reply, 'y', value, len);
+    }
+    if (ret >= 0) {
+        ret = sd_bus_send(nullptr, reply, nullptr);
+    }
+    return ret;
+}
+
+static int
+eizod_set_value(sd_bus_message *m, void *userdata, sd_bus_error *error)
+{
+    struct eizod_monitor *mon = userdata;
+
+    uint32_t usage = 0;
+    int ret = sd_bus_message_read(m, "u", &usage);
+    if (ret < 0) {
+        return ret;
+    }
+
+    const void *data = nullptr;
+    size_t len = 0;
+    ret = sd_bus_message_read_array(m, 'y', &data, &len);
+    if (ret < 0) {
+        return ret;
+    }
+
+    size_t size = eizo_get_value_size(mon->handle, usage);
+    if (size == 0) {
+        return eizod_error(error, EIZO_ERROR_INVALID_USAGE);
+    }
+    if (len == 0 || len > size || len > EIZOD_MAX_VALUE_SIZE) {
+        return eizod_error(error, EIZO_ERROR_INVALID_ARGUMENT);
+    }
+
+    uint8_t value[EIZOD_MAX_VALUE_SIZE];
+    memcpy(value, data, len);
+
+    enum eizo_result res = eizo_set_value(mon->handle, usage, value, len);
+    if (res < EIZO_SUCCESS) {
+        return eizod_error(error, res);
+    }
+
+    // Input reports announce what changed on the monitor itself, the other
+    // clients want to hear about this change as well.
+    eizod_value_changed(mon, usage, data, len);
+    return sd_bus_reply_method_return(m, "");
+}
+
+static int
+eizod_get_product(sd_bus *, const char *, const char *, const char *, sd_bus_message *reply, void *userdata, sd_bus_error *)
+{
+    struct eizod_monitor *mon = userdata;
+    const char *product = eizo_get_product(mon->handle);
+    return sd_bus_message_append(reply, "s", product ? product : "");
+}
+
+static int
+eizod_get_serial(sd_bus *, const char *, const char *, const char *, sd_bus_message *reply, void *userdata, sd_bus_error *)
+{
+    struct eizod_monitor *mon = userdata;
+    return sd_bus_message_append(reply, "t", (uint64_t)eizo_get_serial(mon->handle));
+}
+
+static int
+eizod_get_pid(sd_bus *, const char *, const char *, const char *, sd_bus_message *reply, void *userdata, sd_bus_error *)
+{
+    struct eizod_monitor *mon = userdata;
+    return sd_bus_message_append(reply, "q", (uint16_t)eizo_get_pid(mon->handle));
+}
+
+static int
+eizod_get_snapshot_slot(sd_bus *, const char *, const char *, const char *, sd_bus_message *reply, void *userdata, sd_bus_error *)
+{
+    struct eizod_monitor *mon = userdata;
+    return sd_bus_message_append(
+        reply, "u", mon->snapshot_slot == SIZE_MAX ? UINT32_MAX : (uint32_t)mon->snapshot_slot);
+}
+
+static const sd_bus_vtable eizod_monitor_vtable[] = {
+    SD_BUS_VTABLE_START(0),
+    SD_BUS_PROPERTY("Product", "s", eizod_get_product, 0, SD_BUS_VTABLE_PROPERTY_CONST),
+    SD_BUS_PROPERTY("Serial", "t", eizod_get_serial, 0, SD_BUS_VTABLE_PROPERTY_CONST),
+    SD_BUS_PROPERTY("ProductId", "q", eizod_get_pid, 0, SD_BUS_VTABLE_PROPERTY_CONST),
+    SD_BUS_PROPERTY("DevName", "s", nullptr, offsetof(struct eizod_monitor, devname), SD_BUS_VTABLE_PROPERTY_CONST),
+    SD_BUS_PROPERTY("SnapshotSlot", "u", eizod_get_snapshot_slot, 0, SD_BUS_VTABLE_PROPERTY_CONST),
+    SD_BUS_METHOD("GetValue", "u", "ay", eizod_get_value, SD_BUS_VTABLE_UNPRIVILEGED),
+    SD_BUS_METHOD("SetValue", "uay", "", eizod_set_value, SD_BUS_VTABLE_UNPRIVILEGED),
+    SD_BUS_SIGNAL("ValueChanged", "uay", 0),
+    SD_BUS_VTABLE_END,
+};
+
+static int
+eizod_get_snapshot(sd_bus_message *m, void *userdata, sd_bus_error *)
+{
+    struct eizod *d = userdata;
+    return sd_bus_reply_method_return(m, "h", eizo_snapshot_get_fd(d->snapshot));
+}
+
+static const sd_bus_vtable eizod_manager_vtable[] = {
+    SD_BUS_VTABLE_START(0),
+    SD_BUS_METHOD("GetSnapshot", "", "h", eizod_get_snapshot, SD_BUS_VTABLE_UNPRIVILEGED),
+    SD_BUS_VTABLE_END,
+};
+
+static void
+eizod_on_value(eizo_handle_t, const struct eizo_value_event *event, void *userdata)
+{
+    eizod_value_changed(userdata, event->usage, event->value, event->len);
+}
+
+static int
+eizod_on_input(sd_event_source *source, int, uint32_t, void *userdata)
+{
+    struct eizod_monitor *mon = userdata;
+
+    // The fd stays readable once the monitor is gone, wait for the
+    // removal instead of spinning.
+    int n = eizo_dispatch(mon->handle);
+    if (n < 0) {
+        fprintf(stderr, "%s: failed to read input reports of %s. %i\n", __func__, mon->devname, n);
+        sd_event_source_set_enabled(source, SD_EVENT_OFF);
+    }
+    return 0;
+}
+
+static int
+eizod_on_refresh(sd_event_source *source, uint64_t, void *userdata)
+{
+    struct eizod *d = userdata;
+    for (struct eizod_monitor *mon = d->monitors; mon; mon = mon->next) {
+        eizod_snapshot_refresh(mon);
+    }
+
+    sd_event_source_set_time_relative(source, EIZOD_REFRESH_USEC);
+    return sd_event_source_set_enabled(source, SD_EVENT_ONESHOT);
+}
+
+static void
+eizod_monitor_free(struct eizod_monitor *mon)
+{
+    if (mon->snapshot_slot != SIZE_MAX) {
+        eizo_snapshot_update(mon->daemon->snapshot, mon->snapshot_slot, nullptr);
+        mon->daemon->slots[mon->snapshot_slot] = nullptr;
+    }
+    eizo_remove_value_callback(mon->handle, 0, eizod_on_value, mon);
+    sd_event_source_disable_unref(mon->input);
+    sd_bus_slot_unref(mon->slot);
+    free(mon->path);
+    free(mon->devname);
+    free(mon);
+}
+
+static void
+eizod_on_add(eizo_monitor_t, eizo_handle_t handle, const char *devname, void *userdata)
+{
+    struct eizod *d = userdata;
+
+    struct eizod_monitor *mon = calloc(1, sizeof(*mon));
+    if (!mon) {
+        return;
+    }
+    mon->daemon = d;
+    mon->handle = handle;
+    mon->snapshot_slot = SIZE_MAX;
+
+    char serial[32];
+    snprintf(serial, sizeof(serial), "%lu", eizo_get_serial(handle));
+
+    int ret = -ENOMEM;
+    mon->devname = strdup(devname);
+    if (mon->devname) {
+        ret = sd_bus_path_encode(EIZOD_PATH, serial, &mon->path);
+    }
+    if (ret >= 0) {
+        ret = sd_bus_add_object_vtable(d->bus, &mon->slot, mon->path, EIZOD_INTERFACE, eizod_monitor_vtable, mon);
+    }
+    if (ret >= 0) {
+        ret = sd_event_add_io(d->event, &mon->input, eizo_get_fd(handle), EPOLLIN, eizod_on_input, mon);
+    }
+    if (ret < 0) {
+        fprintf(stderr, "%s: failed to publish %s. %s\n", __func__, devname, strerror(-ret));
+        eizod_monitor_free(mon);
+        return;
+    }
+
+    enum eizo_result res = eizo_enable_value_cache(handle, d->ttl_ms);
+    if (res >= EIZO_SUCCESS) {
+        res = eizo_add_value_callback(handle, 0, eizod_on_value, mon);
+    }
+    if (res < EIZO_SUCCESS) {
+        fprintf(stderr, "%s: failed to track values of %s. %i\n", __func__, devname, res);
+        eizod_monitor_free(mon);
+        return;
+    }
+
+    for (size_t i = 0; i < EIZO_SNAPSHOT_SLOTS; ++i) {
+        if (!d->slots[i]) {
+            d->slots[i] = mon;
+            mon->snapshot_slot = i;
+            break;
+        }
+    }
+
+    const char *product = eizo_get_product(handle);
+    mon->state.fields = EIZO_SNAPSHOT_PRESENT;
+    mon->state.pid = eizo_get_pid(handle);
+    mon->state.serial = eizo_get_serial(handle);
+    snprintf(mon->state.product, sizeof(mon->state.product), "%s", product ? product : "");
+    eizod_snapshot_refresh(mon);
+
+    mon->next = d->monitors;
+    d->monitors = mon;
+
+    sd_bus_emit_object_added(d->bus, mon->path);
+}
+
+static void
+eizod_on_remove(eizo_monitor_t, eizo_handle_t handle, const char *, void *userdata)
+{
+    struct eizod *d = userdata;
+
+    for (struct eizod_monitor **pp = &d->monitors; *pp; pp = &(*pp)->next) {
+        struct eizod_monitor *mon = *pp;
+        if (mon->handle != handle) {
+            continue;
+        }
+
+        sd_bus_emit_object_removed(d->bus, mon->path);
+        *pp = mon->next;
+        eizod_monitor_free(mon);
+        return;
+    }
+}
+
+int
+main(int argc, const char *argv[])
+{
+    struct eizod d = { .ttl_ms = EIZOD_DEFAULT_TTL_MS };
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--ttl") == 0 && i + 1 < argc) {
+            char *end = nullptr;
+            unsigned long u = strtoul(argv[++i], &end, 10);
+            if (*end != '\0' || u > UINT32_MAX) {
+                fprintf(stderr, "Invalid value for '--ttl'\n");
+                return EXIT_FAILURE;
+            }
+            d.ttl_ms = (unsigned)u;
+        } else if (strcmp(argv[i], "--help") == 0) {
+            print_help();
+            return EXIT_SUCCESS;
+        } else {
+            print_help();
+            return EXIT_FAILURE;
+        }
+    }
+
+    int rc = EXIT_FAILURE;
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGINT);
+    sigprocmask(SIG_BLOCK, &mask, nullptr);
+
+    int ret = sd_event_default(&d.event);
+    if (ret < 0) {
+        fprintf(stderr, "Failed to create event loop. %s\n", strerror(-ret));
+        return EXIT_FAILURE;
+    }
+
+    // Without a handler the loop exits on the signal.
+    if ((ret = sd_event_add_signal(d.event, nullptr, SIGTERM, nullptr, nullptr)) < 0 ||
+        (ret = sd_event_add_signal(d.event, nullptr, SIGINT, nullptr, nullptr)) < 0)
+    {
+        fprintf(stderr, "Failed to watch signals. %s\n", strerror(-ret));
+        goto end;
+    }
+
+    enum eizo_result res = eizo_snapshot_new(&d.snapshot);
+    if (res < EIZO_SUCCESS) {
+        fprintf(stderr, "Failed to create the snapshot. %i\n", res);
+        goto end;
+    }
+
+    if ((ret = sd_event_add_time_relative(
+            d.event, &d.refresh, CLOCK_MONOTONIC, EIZOD_REFRESH_USEC, 0, eizod_on_refresh, &d)) < 0)
+    {
+        fprintf(stderr, "Failed to schedule refreshes. %s\n", strerror(-ret));
+        goto end;
+    }
+
+    if ((ret = sd_bus_default_user(&d.bus)) < 0 ||
+        (ret = sd_bus_add_object_manager(d.bus, nullptr, EIZOD_PATH)) < 0 ||
+        (ret = sd_bus_add_object_vtable(
+            d.bus, nullptr, EIZOD_PATH, EIZOD_MANAGER_INTERFACE, eizod_manager_vtable, &d)) < 0 ||
+        (ret = sd_bus_attach_event(d.bus, d.event, SD_EVENT_PRIORITY_NORMAL)) < 0)
+    {
+        fprintf(stderr, "Failed to connect to the user bus. %s\n", strerror(-ret));
+        goto end;
+    }
+
+    ret = sd_bus_request_name(d.bus, EIZOD_NAME, 0);
+    if (ret < 0) {
+        fprintf(stderr, "Failed to acquire %s, is eizod already running? %s\n", EIZOD_NAME, strerror(-ret));
+        goto end;
+    }
+
+    res = eizo_monitor_new(
+        d.event, EIZO_OPEN_CACHE_DESCRIPTOR, eizod_on_add, eizod_on_remove, &d, &d.monitor);
+    if (res < EIZO_SUCCESS) {
+        fprintf(stderr, "Failed to watch for monitors. %i\n", res);
+        goto end;
+    }
+
+    ret = sd_event_loop(d.event);
+    if (ret < 0) {
+        fprintf(stderr, "Event loop failed. %s\n", strerror(-ret));
+        goto end;
+    }
+
+    rc = EXIT_SUCCESS;
+
+end:
+    while (d.monitors) {
+        struct eizod_monitor *next = d.monitors->next;
+        eizod_monitor_free(d.monitors);
+        d.monitors = next;
+    }
+    if (d.monitor) {
+        eizo_monitor_free(d.monitor);
+    }
+    sd_event_source_disable_unref(d.refresh);
+    if (d.snapshot) {
+        eizo_snapshot_free(d.snapshot);
+    }
+    sd_bus_flush_close_unref(d.bus);
+    sd_event_unref(d.event);
+    return rc;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "handle.h"
+
+typedef struct eizo_context *eizo_context_t;
+
+// Called once for every monitor that was opened, as soon as it is ready.
+// Calls are serialized, but happen on the worker threads.
+typedef void (*eizo_ready_callback)(
+    eizo_context_t ctx,
+    eizo_handle_t handle,
+    const char *devname,
+    void *userdata);
+
+enum eizo_result
+eizo_context_new(eizo_context_t *ctx);
+
+// Closes every handle opened through the context.
+void
+eizo_context_free(eizo_context_t ctx);
+
+// Open every Eizo hidraw device in parallel. Returns once all opens have
+// finished, EIZO_INCOMPLETE if some of them failed.
+enum eizo_result
+eizo_context_open_all(
+    eizo_context_t ctx,
+    enum eizo_open_flags flags,
+    eizo_ready_callback cb,
+    void *userdata);
+
+size_t
+eizo_context_get_handles(eizo_context_t ctx, eizo_handle_t const **handles);
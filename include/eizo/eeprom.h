@@ -0,0 +1,58 @@
+#pragma once
+
+#include "handle.h"
+
+// Only tested on the ev2760.
+constexpr size_t EIZO_EEPROM_SIZE = 512;
+
+struct eizo_eeprom_image {
+    enum eizo_pid pid;
+    unsigned long serial;
+    uint8_t firmware[32];
+    uint8_t data[EIZO_EEPROM_SIZE];
+};
+
+// Read len bytes starting at offset. Monitors that advance the EEPROM
+// address on every data read are detected, the address is then only
+// written once.
+enum eizo_result
+eizo_read_eeprom(eizo_handle_t handle, uint16_t offset, size_t len, uint8_t *buf);
+
+// Read the whole EEPROM together with what identifies the monitor it
+// came from.
+enum eizo_result
+eizo_read_eeprom_image(eizo_handle_t handle, struct eizo_eeprom_image *image);
+
+// Write every byte of image that differs from the EEPROM of the monitor
+// and read it back. The serial and product strings are never written, so
+// one image can be restored onto every monitor of the same model. Images
+// taken on another firmware version are refused with
+// EIZO_ERROR_NOT_PERMITTED. written receives the number of bytes written,
+// also on failure, and may be null.
+enum eizo_result
+eizo_restore_eeprom_image(
+    eizo_handle_t handle,
+    const struct eizo_eeprom_image *image,
+    size_t *written);
+
+enum eizo_restore_flags : unsigned {
+    EIZO_RESTORE_DEFAULT = 0,
+    // Restore an image taken on another firmware version, whose EEPROM
+    // layout may differ.
+    EIZO_RESTORE_ANY_FIRMWARE = 1 << 0,
+};
+
+enum eizo_result
+eizo_restore_eeprom_image_ex(
+    eizo_handle_t handle,
+    const struct eizo_eeprom_image *image,
+    enum eizo_restore_flags flags,
+    size_t *written);
+
+// Store image in a versioned, checksummed file that is portable between
+// machines.
+enum eizo_result
+eizo_save_eeprom_image(const struct eizo_eeprom_image *image, const char *path);
+
+enum eizo_result
+eizo_load_eeprom_image(const char *path, struct eizo_eeprom_image *image);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "handle.h"
+
+typedef struct eizo_emulator *eizo_emulator_t;
+
+struct eizo_emulator_config {
+    enum eizo_pid pid;
+    unsigned long serial;
+    const char *product;
+    // Time every feature report request takes, in microseconds.
+    unsigned latency_us;
+    // EEPROM data reads and writes advance the address by one.
+    bool eeprom_autoincrement;
+    // Pad the secondary descriptor with this many vendor controls that
+    // can't be read or written, real monitors have around 200 controls
+    // in total. At most EIZO_EMULATOR_MAX_EXTRA_CONTROLS.
+    uint16_t extra_controls;
+};
+
+// The emulator has 43 controls of its own, which together with these
+// make the most a handle accepts.
+constexpr uint16_t EIZO_EMULATOR_MAX_EXTRA_CONTROLS = 213;
+
+// Create an in-process monitor that speaks the same protocol over feature
+// reports as a real one. Meant for benchmarks and tests that should not
+// depend on hardware.
+enum eizo_result
+eizo_emulator_new(const struct eizo_emulator_config *config, eizo_emulator_t *emulator);
+
+// Every handle opened on the emulator has to be closed before.
+void
+eizo_emulator_free(eizo_emulator_t emulator);
+
+// Open a handle on the emulated monitor, like eizo_open_ex would on a
+// hidraw node. eizo_get_fd of the handle becomes readable when the
+// emulator sends an input report.
+enum eizo_result
+eizo_emulator_open(eizo_emulator_t emulator, enum eizo_open_flags flags, eizo_handle_t *handle);
+
+// Change a value as if it was done on the OSD, every open handle is sent
+// an input report. Like a set request, switching EIZO_USAGE_PROFILE loads
+// the LUTs of that profile.
+enum eizo_result
+eizo_emulator_set_value(eizo_emulator_t emulator, uint32_t usage, const uint8_t *value, size_t len);
+
+// Pretend another client acquired a handle counter, which makes every
+// request of the open handles fail with EIZO_ERROR_RACE_CONDITION.
+void
+eizo_emulator_bump_counter(eizo_emulator_t emulator);
+
+// The same, once requests more feature report requests came in, right
+// before the last of them is served. Meant to interrupt a transfer at a
+// known point, 0 cancels it.
+void
+eizo_emulator_bump_counter_after(eizo_emulator_t emulator, uint64_t requests);
+
+// Number of feature report requests served so far.
+uint64_t
+eizo_emulator_get_request_count(eizo_emulator_t emulator);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
 
 typedef struct eizo_handle *eizo_handle_t;
 
@@ -18,6 +19,33 @@ enum eizo_result : int {
     EIZO_ERROR_OUT_OF_RANGE = -9,
 };
 
+typedef void (*eizo_set_callback)(
+    eizo_handle_t handle,
+    uint32_t usage,
+    const uint8_t *value,
+    size_t len,
+    enum eizo_result res,
+    void *userdata);
+
+struct eizo_value_event {
+    uint8_t report_id;
+    uint32_t usage;
+    uint16_t counter;
+    const uint8_t *value;
+    // Trimmed to the size of the control once the handle loaded its
+    // controls, see EIZO_OPEN_LAZY_CONTROLS.
+    size_t len;
+    // The value decoded as a little endian integer, sign extended if the
+    // control is known to have a negative logical minimum. Only set if
+    // len <= 4.
+    int64_t integer;
+};
+
+typedef void (*eizo_value_callback)(
+    eizo_handle_t handle,
+    const struct eizo_value_event *event,
+    void *userdata);
+
 constexpr uint16_t EIZO_VID = 0x056d;
 
 enum eizo_pid : uint16_t {
@@ -77,12 +105,86 @@ enum eizo_pid : uint16_t {
     // EIZO_PID_COLOREDGE_CX271
 };
 
+enum eizo_open_flags : unsigned {
+    EIZO_OPEN_DEFAULT = 0,
+    // Keep the parsed secondary descriptor in $XDG_CACHE_HOME/libeizo,
+    // keyed by pid, serial and firmware version, and reuse it on later opens.
+    EIZO_OPEN_CACHE_DESCRIPTOR = 1 << 0,
+    // Defer reading the serial and product string until
+    // eizo_get_serial() or eizo_get_product() is called.
+    EIZO_OPEN_LAZY_PRODUCT = 1 << 1,
+    // Defer fetching and parsing the secondary descriptor until the
+    // control table is first needed, e.g. by a get or set request.
+    EIZO_OPEN_LAZY_CONTROLS = 1 << 2,
+    EIZO_OPEN_LAZY = EIZO_OPEN_LAZY_PRODUCT | EIZO_OPEN_LAZY_CONTROLS,
+    // Hand every request to an I/O thread of the handle instead of taking
+    // turns on a lock. Single gets and sets are served before queued LUT
+    // and EEPROM transfers or batched gets, and in between the steps of
+    // one that is already running, so they never wait for all of it.
+    EIZO_OPEN_IO_WORKER = 1 << 3,
+};
+
+// Which requests are sent again after they failed with
+// EIZO_ERROR_RACE_CONDITION, see eizo_set_retry_policy().
+enum eizo_retry_flags : unsigned {
+    EIZO_RETRY_NONE = 0,
+    // Gets never change the monitor, so repeating them is always safe.
+    EIZO_RETRY_GETS = 1 << 0,
+    // Sets are written again with the new counter, which overwrites
+    // whatever the other client wrote to the same usage in between.
+    // Sets that trigger an action, like a factory reset, run twice if
+    // the monitor took the first one despite the race.
+    EIZO_RETRY_SETS = 1 << 1,
+};
+
+// Calls timed by eizo_get_stats().
+enum eizo_stats_op : unsigned {
+    EIZO_STATS_GET_VALUE = 0,
+    EIZO_STATS_SET_VALUE = 1,
+    // The verify report that concludes every get and set request.
+    EIZO_STATS_VERIFY    = 2,
+};
+
+constexpr size_t EIZO_STATS_OPS = 3;
+constexpr size_t EIZO_STATS_LATENCY_BUCKETS = 24;
+
+constexpr int EIZO_STATS_RESULT_MIN = EIZO_ERROR_OUT_OF_RANGE;
+constexpr size_t EIZO_STATS_RESULTS = EIZO_INCOMPLETE - EIZO_ERROR_OUT_OF_RANGE + 1;
+
+struct eizo_op_stats {
+    uint64_t count;
+    uint64_t total_ns;
+    // Bucket 0 counts calls that took less than 1 us, bucket i calls of
+    // [2^(i-1), 2^i) us, and the last one also everything longer.
+    uint64_t latency[EIZO_STATS_LATENCY_BUCKETS];
+    // Calls by their enum eizo_result, at result - EIZO_STATS_RESULT_MIN.
+    uint64_t results[EIZO_STATS_RESULTS];
+};
+
+struct eizo_stats {
+    struct eizo_op_stats op[EIZO_STATS_OPS];
+    // Feature report ioctls, and input reports read.
+    uint64_t get_feature;
+    uint64_t set_feature;
+    uint64_t read;
+    // Feature report bytes, by report size.
+    uint64_t bytes_short;
+    uint64_t bytes_long;
+    uint64_t bytes_other;
+};
+
 enum eizo_result
 eizo_open(const char *hidraw, eizo_handle_t *handle);
 
+enum eizo_result
+eizo_open_ex(const char *hidraw, enum eizo_open_flags flags, eizo_handle_t *handle);
+
 enum eizo_result
 eizo_new(int fd, eizo_handle_t *handle);
 
+enum eizo_result
+eizo_new_ex(int fd, enum eizo_open_flags flags, eizo_handle_t *handle);
+
 void
 eizo_close(eizo_handle_t handle);
 
@@ -97,3 +199,82 @@ eizo_get_serial(eizo_handle_t handle);
 
 const char *
 eizo_get_product(eizo_handle_t handle);
+
+// Size in bytes of the value of usage, 0 if the monitor has no such
+// control or its value isn't byte aligned.
+size_t
+eizo_get_value_size(eizo_handle_t handle, uint32_t usage);
+
+// Read len bytes of the value of usage as the monitor sends them, little
+// endian for numbers. len must not exceed eizo_get_value_size().
+enum eizo_result
+eizo_get_value(eizo_handle_t handle, uint32_t usage, uint8_t *value, size_t len);
+
+// Write the first len bytes of the value of usage. Returns EIZO_INCOMPLETE
+// if the write was queued, see eizo_enable_coalescing().
+enum eizo_result
+eizo_set_value(eizo_handle_t handle, uint32_t usage, uint8_t *value, size_t len);
+
+// Serve repeated reads of short values from memory for up to ttl_ms.
+// Entries are dropped by eizo_set_value() and by input reports the
+// monitor sends when a value changes. A ttl of 0 disables caching for
+// a usage, see eizo_set_value_cache_ttl() for per-usage overrides.
+enum eizo_result
+eizo_enable_value_cache(eizo_handle_t handle, unsigned ttl_ms);
+
+void
+eizo_disable_value_cache(eizo_handle_t handle);
+
+// Override the ttl of a single usage once the cache is enabled, 0 always
+// reads it from the monitor. Returns EIZO_ERROR_INVALID_ARGUMENT if the
+// cache is disabled.
+enum eizo_result
+eizo_set_value_cache_ttl(eizo_handle_t handle, uint32_t usage, unsigned ttl_ms);
+
+// When another client, e.g. another process or the OSD, takes over the
+// monitor, requests still carrying the old handle counter fail with
+// EIZO_ERROR_RACE_CONDITION. The handle then acquires the new counter,
+// and requests selected by flags are sent again, at most retries times.
+// Other requests fail once and the next one goes through. Handles start
+// out with EIZO_RETRY_GETS and 1 retry.
+void
+eizo_set_retry_policy(eizo_handle_t handle, enum eizo_retry_flags flags, unsigned retries);
+
+// Counters of everything the handle did since it was opened or last
+// reset. They are always kept, updating them costs a few relaxed atomic
+// adds per request, so stats may be taken from any thread at any time.
+void
+eizo_get_stats(eizo_handle_t handle, struct eizo_stats *stats);
+
+void
+eizo_reset_stats(eizo_handle_t handle);
+
+// Queue short writes instead of issuing them right away. A background
+// thread writes them back to back in the order they were made. A new
+// value of a usage that is still queued replaces the old one, which is
+// dropped, and goes to the tail. Writes that switch the profile or start
+// an action, like EIZO_USAGE_PROFILE or EIZO_USAGE_FACTORY_RESET, are
+// never dropped and nothing is merged across them. A full queue makes
+// the caller wait, writes that can't be queued wait for the queue to
+// drain. Queued writes return EIZO_INCOMPLETE, cb is called from the
+// background thread with the value that was actually written.
+enum eizo_result
+eizo_enable_coalescing(eizo_handle_t handle, eizo_set_callback cb, void *userdata);
+
+// Write out every pending value and stop coalescing.
+void
+eizo_disable_coalescing(eizo_handle_t handle);
+
+// Call cb for every input report of usage, or of any usage if usage is 0.
+enum eizo_result
+eizo_add_value_callback(eizo_handle_t handle, uint32_t usage, eizo_value_callback cb, void *userdata);
+
+void
+eizo_remove_value_callback(eizo_handle_t handle, uint32_t usage, eizo_value_callback cb, void *userdata);
+
+// Decode every input report that is queued on eizo_get_fd() and invoke
+// the matching callbacks. Never blocks, the fd is switched to O_NONBLOCK
+// on first use, so it can be watched with poll, epoll or sd-event.
+// Returns the number of reports dispatched or a negative eizo_result.
+int
+eizo_dispatch(eizo_handle_t handle);
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "handle.h"
+
+enum eizo_log_level : unsigned {
+    EIZO_LOG_ERROR   = 0,
+    EIZO_LOG_WARNING = 1,
+    EIZO_LOG_INFO    = 2,
+    // Failures that are reported to the caller anyway, e.g. a usage the
+    // monitor doesn't have.
+    EIZO_LOG_DEBUG   = 3,
+};
+
+// func is the library function the message comes from, msg has no
+// trailing newline.
+typedef void (*eizo_log_callback)(
+    enum eizo_log_level level,
+    const char *func,
+    const char *msg,
+    void *userdata);
+
+// Hand every message to cb instead of writing it to stderr, a null cb
+// goes back to stderr. The setting is process wide and cb may be called
+// from any thread, even shortly after it was replaced. cb may log itself.
+void
+eizo_set_log_callback(eizo_log_callback cb, void *userdata);
+
+// Drop messages above level, EIZO_LOG_INFO by default. Messages above
+// the level the library was built with never get this far.
+void
+eizo_set_log_level(enum eizo_log_level level);
+
+// Keep messages in memory instead of passing them on, the oldest are
+// overwritten once there are EIZO_LOG_RING_SIZE. Writing to the ring
+// never blocks.
+constexpr size_t EIZO_LOG_RING_SIZE = 256;
+
+void
+eizo_set_log_ring(bool enabled);
+
+// Pass the messages in the ring to cb, oldest first. Messages that are
+// overwritten while dumping are skipped.
+void
+eizo_dump_log_ring(eizo_log_callback cb, void *userdata);
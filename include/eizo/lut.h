@@ -0,0 +1,47 @@
+#pragma once
+
+#include "handle.h"
+
+enum eizo_lut : unsigned {
+    EIZO_LUT_FRONT = 0,
+    EIZO_LUT_REAR  = 1,
+};
+
+// Entries per channel.
+constexpr size_t EIZO_LUT_ENTRIES = 1024;
+
+// Read the red, green and blue curves of lut, each EIZO_LUT_ENTRIES long
+// and normalised to [0, 1].
+enum eizo_result
+eizo_read_lut(eizo_handle_t handle, enum eizo_lut lut, float *red, float *green, float *blue);
+
+// Write the curves of lut, values outside [0, 1] are clamped. Only the parts
+// that differ from what the handle last read or wrote are uploaded, after
+// one page read back confirmed the monitor still has it. Switching the
+// profile through the handle makes the next write upload everything. pages
+// receives the number of reports sent and may be null.
+enum eizo_result
+eizo_write_lut(
+    eizo_handle_t handle,
+    enum eizo_lut lut,
+    const float *red,
+    const float *green,
+    const float *blue,
+    size_t *pages);
+
+// Forget what the handle knows about lut, the next write uploads all of it.
+void
+eizo_invalidate_lut(eizo_handle_t handle, enum eizo_lut lut);
+
+enum eizo_result
+eizo_get_front_lut_enabled(eizo_handle_t handle, bool *enabled);
+
+enum eizo_result
+eizo_set_front_lut_enabled(eizo_handle_t handle, bool enabled);
+
+// The 3x3 color matrix in row major order.
+enum eizo_result
+eizo_get_color_matrix(eizo_handle_t handle, float matrix[9]);
+
+enum eizo_result
+eizo_set_color_matrix(eizo_handle_t handle, const float matrix[9]);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "handle.h"
+
+typedef struct sd_event sd_event;
+typedef struct eizo_monitor *eizo_monitor_t;
+
+typedef void (*eizo_monitor_callback)(
+    eizo_monitor_t monitor,
+    eizo_handle_t handle,
+    const char *devname,
+    void *userdata);
+
+// Track Eizo hidraw devices as they come and go. Monitors that are
+// already connected and ones plugged in later are opened on a background
+// thread, add_cb is called from the event loop once a handle is ready.
+// remove_cb is called before the handle of an unplugged monitor is closed.
+enum eizo_result
+eizo_monitor_new(
+    sd_event *event,
+    enum eizo_open_flags flags,
+    eizo_monitor_callback add_cb,
+    eizo_monitor_callback remove_cb,
+    void *userdata,
+    eizo_monitor_t *monitor);
+
+// Closes every handle without calling remove_cb.
+void
+eizo_monitor_free(eizo_monitor_t monitor);
+
+// Fill handles with up to n ready handles, returns the total number.
+size_t
+eizo_monitor_get_handles(eizo_monitor_t monitor, eizo_handle_t *handles, size_t n);
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "handle.h"
+
+// The decoded state of a set of monitors in shared memory, published by
+// eizod. Readers map it once and then read it without any syscall, every
+// monitor has its own slot guarded by a sequence counter.
+typedef struct eizo_snapshot *eizo_snapshot_t;
+
+constexpr size_t EIZO_SNAPSHOT_SLOTS = 16;
+
+// Which members of struct eizo_snapshot_monitor are set.
+enum eizo_snapshot_fields : uint32_t {
+    // The slot holds a monitor.
+    EIZO_SNAPSHOT_PRESENT       = 1 << 0,
+    EIZO_SNAPSHOT_BRIGHTNESS    = 1 << 1,
+    EIZO_SNAPSHOT_CONTRAST      = 1 << 2,
+    EIZO_SNAPSHOT_PROFILE       = 1 << 3,
+    EIZO_SNAPSHOT_INPUT_PORT    = 1 << 4,
+    EIZO_SNAPSHOT_POWER         = 1 << 5,
+    EIZO_SNAPSHOT_TEMPERATURE_1 = 1 << 6,
+    EIZO_SNAPSHOT_TEMPERATURE_2 = 1 << 7,
+    EIZO_SNAPSHOT_TEMPERATURE_3 = 1 << 8,
+    EIZO_SNAPSHOT_TEMPERATURE_4 = 1 << 9,
+    EIZO_SNAPSHOT_USAGE_TIME    = 1 << 10,
+};
+
+// Fixed layout, any change bumps the version of the shared memory.
+struct eizo_snapshot_monitor {
+    uint32_t fields;
+    uint16_t pid;
+    // An enum eizo_input_port.
+    uint16_t input_port;
+    uint64_t serial;
+    uint16_t brightness;
+    uint16_t contrast;
+    // An enum eizo_profile.
+    uint8_t  profile;
+    // An enum eizo_power.
+    uint8_t  power;
+    uint8_t  reserved[2];
+    int32_t  temperature[4];
+    // In minutes.
+    int64_t  usage_time;
+    char     product[24];
+};
+
+// Read every value of the snapshot the monitor behind handle has into
+// monitor and add their fields, the others are left as they are.
+void
+eizo_snapshot_monitor_refresh(eizo_handle_t handle, struct eizo_snapshot_monitor *monitor);
+
+// Fold a new value of usage into monitor, e.g. from an input report or a
+// write of the caller. Returns false if the usage is not part of it.
+bool
+eizo_snapshot_monitor_apply(
+    eizo_handle_t handle,
+    struct eizo_snapshot_monitor *monitor,
+    uint32_t usage,
+    const uint8_t *value,
+    size_t len);
+
+// Create an empty snapshot in a memfd, for the one process that writes it.
+// Only the mapping of the writer can change it, which needs Linux 5.1.
+enum eizo_result
+eizo_snapshot_new(eizo_snapshot_t *snapshot);
+
+// Map the snapshot behind fd read only. fd may be closed afterwards.
+enum eizo_result
+eizo_snapshot_map(int fd, eizo_snapshot_t *snapshot);
+
+void
+eizo_snapshot_free(eizo_snapshot_t snapshot);
+
+// The memfd of a snapshot created with eizo_snapshot_new(), to hand out
+// to readers.
+int
+eizo_snapshot_get_fd(eizo_snapshot_t snapshot);
+
+// Publish monitor in slot, or clear the slot if monitor is null.
+enum eizo_result
+eizo_snapshot_update(eizo_snapshot_t snapshot, size_t slot, const struct eizo_snapshot_monitor *monitor);
+
+// Copy a consistent picture of slot into monitor. Returns EIZO_INCOMPLETE
+// for an empty slot, and EIZO_ERROR_RACE_CONDITION if the writer kept
+// changing it.
+enum eizo_result
+eizo_snapshot_read(eizo_snapshot_t snapshot, size_t slot, struct eizo_snapshot_monitor *monitor);
+
+// Counts every update of any slot.
+uint32_t
+eizo_snapshot_get_generation(eizo_snapshot_t snapshot);
+
+// Sleep until the generation differs from generation, or for at most
+// timeout_ms, -1 waits forever. Returns EIZO_INCOMPLETE on timeout.
+enum eizo_result
+eizo_snapshot_wait(eizo_snapshot_t snapshot, uint32_t generation, int timeout_ms);
@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory.h>
+#include <errno.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+
+#include "eizo/handle.h"
+#include "eizo/log.h"
+#include "internal.h"
+
+// On-disk layout of a cached control table. The header is followed
+// directly by the block of a struct eizo_control_table of n_ctrl sorted
+// controls, so a mapping of the file can be used without copying.
+// The file is only ever read back on the machine that wrote it, so
+// everything is stored in native byte order.
+struct eizo_cache_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+    uint16_t vid;
+    uint16_t pid;
+    uint32_t n_ctrl;
+    uint64_t serial;
+    uint8_t  firmware[EIZO_FIRMWARE_VERSION_SIZE];
+    uint32_t crc;
+    uint32_t reserved;
+};
+static_assert(sizeof(struct eizo_cache_header) % alignof(enum eizo_usage) == 0);
+
+static const char EIZO_CACHE_MAGIC[8] = "EIZOCTL";
+constexpr uint32_t EIZO_CACHE_VERSION = 2;
+
+uint32_t
+eizo_crc32(const uint8_t *data, size_t len)
+{
+    uint32_t crc = 0xffffffff;
+    for (size_t i = 0; i < len; ++i) {
+        crc ^= data[i];
+        for (int k = 0; k < 8; ++k) {
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static int
+eizo_cache_dir(char *path, size_t size)
+{
+    int n;
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    if (xdg && xdg[0] == '/') {
+        n = snprintf(path, size, "%s/libeizo", xdg);
+    } else {
+        const char *home = getenv("HOME");
+        if (!home || home[0] != '/') {
+            return -1;
+        }
+        n = snprintf(path, size, "%s/.cache/libeizo", home);
+    }
+
+    if (n < 0 || (size_t)n >= size) {
+        return -1;
+    }
+    return n;
+}
+
+static int
+eizo_cache_path(char *path, size_t size, enum eizo_pid pid, unsigned long serial)
+{
+    int n = eizo_cache_dir(path, size);
+    if (n < 0) {
+        return -1;
+    }
+
+    int m = snprintf(path + n, size - (size_t)n, "/%04w16x-%04w16x-%lu.ctl", EIZO_VID, pid, serial);
+    if (m < 0 || (size_t)(n + m) >= size) {
+        return -1;
+    }
+    return n + m;
+}
+
+static int
+eizo_cache_mkdir(char *dir)
+{
+    // Create every missing component, the cache home itself may not exist yet.
+    for (char *p = dir + 1; *p; ++p) {
+        if (*p != '/') {
+            continue;
+        }
+        *p = '\0';
+        int rc = mkdir(dir, 0700);
+        *p = '/';
+        if (rc < 0 && errno != EEXIST) {
+            return -1;
+        }
+    }
+
+    if (mkdir(dir, 0700) < 0 && errno != EEXIST) {
+        return -1;
+    }
+    return 0;
+}
+
+static void
+eizo_cache_header_init(
+    struct eizo_cache_header *hdr,
+    enum eizo_pid pid,
+    unsigned long serial,
+    const uint8_t firmware[EIZO_FIRMWARE_VERSION_SIZE],
+    size_t n_ctrl)
+{
+    memset(hdr, 0, sizeof(*hdr));
+    memcpy(hdr->magic, EIZO_CACHE_MAGIC, sizeof(hdr->magic));
+    hdr->version = EIZO_CACHE_VERSION;
+    hdr->entry_size = EIZO_CONTROL_ENTRY_SIZE;
+    hdr->vid = EIZO_VID;
+    hdr->pid = pid;
+    hdr->n_ctrl = (uint32_t)n_ctrl;
+    hdr->serial = serial;
+    memcpy(hdr->firmware, firmware, EIZO_FIRMWARE_VERSION_SIZE);
+}
+
+enum eizo_result
+eizo_cache_load(
+    enum eizo_pid pid,
+    unsigned long serial,
+    const uint8_t firmware[EIZO_FIRMWARE_VERSION_SIZE],
+    struct eizo_cache_map *map)
+{
+    char path[PATH_MAX];
+    if (eizo_cache_path(path, sizeof(path), pid, serial) < 0) {
+        return EIZO_ERROR_INVALID_ARGUMENT;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return EIZO_ERROR_IO;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return EIZO_ERROR_IO;
+    }
+
+    size_t size = (size_t)st.st_size;
+    if (size <= sizeof(struct eizo_cache_header)) {
+        close(fd);
+        return EIZO_ERROR_BAD_DATA;
+    }
+
+    void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return EIZO_ERROR_IO;
+    }
+
+    const struct eizo_cache_header *hdr = addr;
+    struct eizo_cache_header exp;
+    eizo_cache_header_init(&exp, pid, serial, firmware, hdr->n_ctrl);
+    exp.crc = hdr->crc;
+
+    const uint8_t *payload = (const uint8_t *)addr + sizeof(*hdr);
+    size_t payload_size = (size_t)hdr->n_ctrl * EIZO_CONTROL_ENTRY_SIZE;
+
+    if (memcmp(hdr, &exp, sizeof(exp)) != 0
+        || hdr->n_ctrl == 0
+        || size != sizeof(*hdr) + payload_size
+        || eizo_crc32(payload, payload_size) != hdr->crc)
+    {
+        munmap(addr, size);
+        return EIZO_ERROR_BAD_DATA;
+    }
+
+    map->addr = addr;
+    map->size = size;
+    map->block = payload;
+    map->n_ctrl = hdr->n_ctrl;
+    return EIZO_SUCCESS;
+}
+
+void
+eizo_cache_unmap(struct eizo_cache_map *map)
+{
+    if (map->addr) {
+        munmap(map->addr, map->size);
+    }
+    memset(map, 0, sizeof(*map));
+}
+
+enum eizo_result
+eizo_cache_store(
+    enum eizo_pid pid,
+    unsigned long serial,
+    const uint8_t firmware[EIZO_FIRMWARE_VERSION_SIZE],
+    const struct eizo_control_table *table)
+{
+    char path[PATH_MAX], tmp[PATH_MAX];
+    int n = eizo_cache_path(path, sizeof(path), pid, serial);
+    if (n < 0 || (size_t)n + 8 > sizeof(tmp)) {
+        return EIZO_ERROR_INVALID_ARGUMENT;
+    }
+
+    int d = eizo_cache_dir(tmp, sizeof(tmp));
+    if (d < 0 || eizo_cache_mkdir(tmp) < 0) {
+        eizo_log_warning("failed to create cache directory %s. %s", tmp, strerror(errno));
+        return EIZO_ERROR_IO;
+    }
+
+    snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path);
+    int fd = mkstemp(tmp);
+    if (fd < 0) {
+        return EIZO_ERROR_IO;
+    }
+
+    // The arrays of the table are one block, starting with usage.
+    const uint8_t *payload = (const uint8_t *)table->usage;
+    size_t payload_size = table->n * EIZO_CONTROL_ENTRY_SIZE;
+
+    struct eizo_cache_header hdr;
+    eizo_cache_header_init(&hdr, pid, serial, firmware, table->n);
+    hdr.crc = eizo_crc32(payload, payload_size);
+
+    bool ok = write(fd, &hdr, sizeof(hdr)) == (ssize_t)sizeof(hdr)
+           && write(fd, payload, payload_size) == (ssize_t)payload_size;
+    close(fd);
+
+    // Rename into place, so concurrent readers only ever see a complete file.
+    if (!ok || rename(tmp, path) < 0) {
+        unlink(tmp);
+        return EIZO_ERROR_IO;
+    }
+
+    return EIZO_SUCCESS;
+}
@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <systemd/sd-device.h>
+
+#include "eizo/handle.h"
+#include "eizo/context.h"
+#include "eizo/log.h"
+#include "internal.h"
+
+constexpr size_t EIZO_CONTEXT_MAX_WORKERS = 8;
+
+struct eizo_context {
+    pthread_mutex_t lock;
+    eizo_handle_t *handles;
+    size_t n_handles;
+};
+
+struct eizo_open_job {
+    struct eizo_context *ctx;
+    enum eizo_open_flags flags;
+    eizo_ready_callback cb;
+    void *userdata;
+    char **devnames;
+    eizo_handle_t *handles;
+    size_t n;
+    atomic_size_t next;
+    atomic_size_t failed;
+};
+
+bool
+eizo_device_get_pid(sd_device *device, enum eizo_pid *pid)
+{
+    sd_device *parent = nullptr;
+    int ret = sd_device_get_parent_with_subsystem_devtype(
+            device,
+            "usb",
+            "usb_device",
+            &parent);
+    if (ret < 0) {
+        return false;
+    }
+
+    const char *vid_str = nullptr, *pid_str = nullptr;
+    int rv = sd_device_get_sysattr_value(parent, "idVendor", &vid_str);
+    int rp = sd_device_get_sysattr_value(parent, "idProduct", &pid_str);
+    if (rv < 0 || rp < 0) {
+        return false;
+    }
+
+    if (strtoul(vid_str, nullptr, 16) != EIZO_VID) {
+        return false;
+    }
+
+    if (pid) {
+        *pid = (enum eizo_pid)strtoul(pid_str, nullptr, 16);
+    }
+    return true;
+}
+
+static enum eizo_result
+eizo_context_discover(char ***devnames, size_t *n)
+{
+    [[gnu::cleanup(sd_device_enumerator_unrefp)]]
+    sd_device_enumerator *enumerator = nullptr;
+
+    int ret = sd_device_enumerator_new(&enumerator);
+    if (ret < 0) {
+        return EIZO_ERROR_NO_MEMORY;
+    }
+
+    ret = sd_device_enumerator_add_match_subsystem(enumerator, "hidraw", true);
+    if (ret < 0) {
+        return EIZO_ERROR_UNKNOWN;
+    }
+
+    char **names = nullptr;
+    size_t count = 0;
+
+    for (sd_device *device = sd_device_enumerator_get_device_first(enumerator);
+         device;
+         device = sd_device_enumerator_get_device_next(enumerator))
+    {
+        if (!eizo_device_get_pid(device, nullptr)) {
+            continue;
+        }
+
+        const char *devname = nullptr;
+        if (sd_device_get_devname(device, &devname) < 0) {
+            continue;
+        }
+
+        char **tmp = reallocarray(names, count + 1, sizeof(char *));
+        if (tmp) {
+            names = tmp;
+        }
+        if (!tmp || !(names[count] = strdup(devname))) {
+            for (size_t i = 0; i < count; ++i) {
+                free(names[i]);
+            }
+            free(names);
+            return EIZO_ERROR_NO_MEMORY;
+        }
+        ++count;
+    }
+
+    *devnames = names;
+    *n = count;
+    return EIZO_SUCCESS;
+}
+
+static void *
+eizo_context_worker(void *arg)
+{
+    struct eizo_open_job *job = arg;
+
+    while (true) {
+        size_t i = atomic_fetch_add(&job->next, 1);
+        if (i >= job->n) {
+            break;
+        }
+
+        eizo_handle_t handle = nullptr;
+        enum eizo_result res = eizo_open_ex(job->devnames[i], job->flags, &handle);
+        if (res < EIZO_SUCCESS) {
+            eizo_log_warning("failed to open %s. %i", job->devnames[i], res);
+            atomic_fetch_add(&job->failed, 1);
+            continue;
+        }
+
+        job->handles[i] = handle;
+
+        if (job->cb) {
+            pthread_mutex_lock(&job->ctx->lock);
+            job->cb(job->ctx, handle, job->devnames[i], job->userdata);
+            pthread_mutex_unlock(&job->ctx->lock);
+        }
+    }
+
+    return nullptr;
+}
+
+enum eizo_result
+eizo_context_new(struct eizo_context **ctx)
+{
+    struct eizo_context *c = calloc(1, sizeof(*c));
+    if (!c) {
+        return EIZO_ERROR_NO_MEMORY;
+    }
+
+    pthread_mutex_init(&c->lock, nullptr);
+    *ctx = c;
+    return EIZO_SUCCESS;
+}
+
+void
+eizo_context_free(struct eizo_context *ctx)
+{
+    for (size_t i = 0; i < ctx->n_handles; ++i) {
+        eizo_close(ctx->handles[i]);
+    }
+    free(ctx->handles);
+    pthread_mutex_destroy(&ctx->lock);
+    free(ctx);
+}
+
+enum eizo_result
+eizo_context_open_all(
+    struct eizo_context *ctx,
+    enum eizo_open_flags flags,
+    eizo_ready_callback cb,
+    void *userdata)
+{
+    struct eizo_open_job job = {
+        .ctx = ctx,
+        .flags = flags,
+        .cb = cb,
+        .userdata = userdata,
+    };
+
+    enum eizo_result res = eizo_context_discover(&job.devnames, &job.n);
+    if (res < EIZO_SUCCESS || job.n == 0) {
+        return res;
+    }
+
+    job.handles = calloc(job.n, sizeof(eizo_handle_t));
+    if (!job.handles) {
+        res = EIZO_ERROR_NO_MEMORY;
+        goto end;
+    }
+
+    eizo_handle_t *all = reallocarray(ctx->handles, ctx->n_handles + job.n, sizeof(eizo_handle_t));
+    if (!all) {
+        res = EIZO_ERROR_NO_MEMORY;
+        goto end;
+    }
+    ctx->handles = all;
+
+    // Opening a monitor is dominated by waiting on the device, so one
+    // thread per monitor lets the transfers overlap. The calling thread
+    // works through the queue as well.
+    size_t n_workers = job.n - 1;
+    if (n_workers > EIZO_CONTEXT_MAX_WORKERS) {
+        n_workers = EIZO_CONTEXT_MAX_WORKERS;
+    }
+
+    pthread_t workers[EIZO_CONTEXT_MAX_WORKERS];
+    size_t started = 0;
+    for (; started < n_workers; ++started) {
+        if (pthread_create(&workers[started], nullptr, eizo_context_worker, &job) != 0) {
+            break;
+        }
+    }
+
+    eizo_context_worker(&job);
+
+    for (size_t i = 0; i < started; ++i) {
+        pthread_join(workers[i], nullptr);
+    }
+
+    // Keep the handles in discovery order, independent of which open
+    // finished first.
+    for (size_t i = 0; i < job.n; ++i) {
+        if (job.handles[i]) {
+            ctx->handles[ctx->n_handles++] = job.handles[i];
+        }
+    }
+
+    res = atomic_load(&job.failed) ? EIZO_INCOMPLETE : EIZO_SUCCESS;
+
+end:
+    for (size_t i = 0; i < job.n; ++i) {
+        free(job.devnames[i]);
+    }
+    free(job.devnames);
+    free(job.handles);
+    return res;
+}
+
+size_t
+eizo_context_get_handles(struct eizo_context *ctx, eizo_handle_t const **handles)
+{
+    if (handles) {
+        *handles = ctx->handles;
+    }
+    return ctx->n_handles;
+}
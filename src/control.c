@@ -7,6 +7,7 @@
 
 #include "eizo/handle.h"
 #include "eizo/control.h"
+#include "eizo/log.h"
 #include "internal.h"
 
 static enum eizo_result
@@ -110,81 +111,59 @@ eizo_set_usage_time(struct eizo_handle *handle, long time)
     return eizo_set_value(handle, EIZO_USAGE_USAGE_TIME, u.buf, 3);
 }
 
-enum eizo_result
-eizo_get_available_custom_key_lock_raw(struct eizo_handle *handle, uint8_t **ptr, size_t *len)
+struct eizo_custom_key_lock_args {
+    uint8_t **ptr;
+    size_t *len;
+};
+
+static enum eizo_result
+eizo_get_available_custom_key_lock_job(struct eizo_handle *handle, void *arg)
 {
-    union {
-        struct {
-            uint16_t offset;
-            uint16_t size;
-        };
-        uint8_t buf[64];
-    } u;
+    struct eizo_custom_key_lock_args *a = arg;
+    struct eizo_transfer t;
+    uint8_t *data = nullptr;
 
-    enum eizo_result res = eizo_get_value(
+    enum eizo_result res = eizo_transfer_begin(
         handle,
+        &t,
         EIZO_USAGE_EV_AVAILABLE_CUSTOM_KEY_LOCK_OFFSET_SIZE,
-        u.buf, 4);
+        EIZO_USAGE_EV_AVAILABLE_CUSTOM_KEY_LOCK_DATA);
     if (res < EIZO_SUCCESS) {
-        fprintf(stderr, "%s: Failed to get offset and size\n", __func__);
-        return res;
-    }
-
-    size_t size = le16toh(u.size);
-    if (size == 0) {
-        *len = 0;
-        *ptr = nullptr;
-        return EIZO_SUCCESS;
-    }
-
-    size_t offset = le16toh(u.offset);
-    if (offset != 0) {
-        memset(u.buf, 0, 4);
-        res = eizo_set_value(
-            handle,
-            EIZO_USAGE_EV_AVAILABLE_CUSTOM_KEY_LOCK_OFFSET_SIZE,
-            u.buf, 4);
-        if (res < EIZO_SUCCESS) {
-            fprintf(stderr, "%s: Failed to reset offset.\n", __func__);
-            return res;
-        }
+        eizo_log_debug("Failed to get offset and size");
+        goto end;
     }
 
-    uint8_t *data = malloc(size);
-    if (!data) {
-        fprintf(stderr, "%s: %s\n", __func__, strerror(errno));
-        return EIZO_ERROR_NO_MEMORY;
-    }
-
-    for (size_t i = 0; i < size; i += 62) {
-        res = eizo_get_value(
-            handle,
-            EIZO_USAGE_EV_AVAILABLE_CUSTOM_KEY_LOCK_DATA,
-            u.buf, 64);
-        if (res < EIZO_SUCCESS) {
-            fprintf(stderr, "%s: Failed to get data at %ld.\n", __func__, i);
+    if (t.size > 0) {
+        data = malloc(t.size);
+        if (!data) {
+            eizo_log_debug("%s", strerror(errno));
+            res = EIZO_ERROR_NO_MEMORY;
             goto end;
         }
 
-        offset = le16toh(u.offset);
-        if (offset != i) {
-            fprintf(stderr, "%s: Offset %ld != %ld.\n", __func__, offset, i);
-            res = EIZO_ERROR_BAD_DATA;
+        res = eizo_transfer_read(handle, &t, data);
+        if (res < EIZO_SUCCESS) {
+            eizo_log_debug("Failed to get data at %zu.", t.pos);
+            free(data);
+            data = nullptr;
             goto end;
         }
-
-        size_t cpy = MIN(size - i, 62);
-        memcpy(data + i, u.buf + 2, cpy);
     }
 
-    *ptr = data;
-    *len = size;
-    return EIZO_SUCCESS;
+    *a->ptr = data;
+    *a->len = t.size;
+
 end:
-    free(data);
     return res;
 }
 
+enum eizo_result
+eizo_get_available_custom_key_lock_raw(struct eizo_handle *handle, uint8_t **ptr, size_t *len)
+{
+    struct eizo_custom_key_lock_args a = { ptr, len };
+    return eizo_io_run(handle, EIZO_IO_LONG, eizo_get_available_custom_key_lock_job, &a);
+}
+
 enum eizo_result
 eizo_set_debug_mode(struct eizo_handle *handle, enum eizo_debug_mode mode)
 {
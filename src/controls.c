@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory.h>
+#include <pthread.h>
+
+#include "eizo/handle.h"
+#include "eizo/log.h"
+#include "internal.h"
+
+// Every parsed control table in use by a handle. A desk full of identical
+// monitors reports identical descriptors, which are parsed and stored once.
+static pthread_mutex_t eizo_controls_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct eizo_controls *eizo_controls_pool = nullptr;
+
+// Insertion sort by usage. Descriptors list most of their controls in
+// order already, which makes this close to a single pass.
+static void
+eizo_control_table_sort(struct eizo_control_table *t)
+{
+    for (size_t i = 1; i < t->n; ++i) {
+        struct eizo_control c = eizo_control_get(t, i);
+
+        size_t j = i;
+        for (; j > 0 && t->usage[j - 1] > c.usage; --j) {
+            t->usage[j] = t->usage[j - 1];
+            t->logical_minimum[j] = t->logical_minimum[j - 1];
+            t->logical_maximum[j] = t->logical_maximum[j - 1];
+            t->report_count[j] = t->report_count[j - 1];
+            t->report_id[j] = t->report_id[j - 1];
+            t->report_size[j] = t->report_size[j - 1];
+        }
+
+        t->usage[j] = c.usage;
+        t->logical_minimum[j] = c.logical_minimum;
+        t->logical_maximum[j] = c.logical_maximum;
+        t->report_count[j] = c.report_count;
+        t->report_id[j] = c.report_id;
+        t->report_size[j] = c.report_size;
+    }
+}
+
+// Build the page index over the sorted control table. On failure the
+// index stays empty and lookups use binary search.
+static void
+eizo_control_index_build(struct eizo_control_index *index, const struct eizo_control_table *table)
+{
+    const enum eizo_usage *usage = table->usage;
+    size_t n = table->n;
+
+    if (n == 0 || n >= UINT16_MAX) {
+        return;
+    }
+
+    struct eizo_control_page pages[EIZO_CONTROL_INDEX_MAX_PAGES];
+    size_t n_pages = 0;
+    size_t total = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t page = usage[i] >> 16;
+        uint32_t id = usage[i] & 0xffff;
+
+        if (i > 0 && usage[i] < usage[i - 1]) {
+            return;
+        }
+
+        if (n_pages > 0 && pages[n_pages - 1].page == page) {
+            struct eizo_control_page *p = &pages[n_pages - 1];
+            size_t span = id - p->first + 1;
+            if (span > EIZO_CONTROL_INDEX_MAX_SPAN) {
+                return;
+            }
+            total += span - p->span;
+            p->span = (uint32_t)span;
+            continue;
+        }
+
+        if (n_pages == EIZO_CONTROL_INDEX_MAX_PAGES || (page >= 0x100 && page < 0xff00)) {
+            return;
+        }
+        pages[n_pages++] = (struct eizo_control_page) {
+            .page = page,
+            .first = id,
+            .span = 1,
+        };
+        ++total;
+    }
+
+    uint16_t *slots = calloc(total, sizeof(uint16_t));
+    if (!slots) {
+        return;
+    }
+
+    size_t off = 0;
+    for (size_t i = 0; i < n_pages; ++i) {
+        pages[i].slot = slots + off;
+        off += pages[i].span;
+    }
+
+    // The table is sorted, so the controls of a page follow each other.
+    size_t k = 0;
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t page = usage[i] >> 16;
+        while (pages[k].page != page) {
+            ++k;
+        }
+        uint16_t *slot = &pages[k].slot[(usage[i] & 0xffff) - pages[k].first];
+        if (*slot == 0) {
+            *slot = (uint16_t)(i + 1);
+        }
+    }
+
+    memcpy(index->pages, pages, n_pages * sizeof(pages[0]));
+    memset(index->page_map, 0, sizeof(index->page_map));
+    for (size_t i = 0; i < n_pages; ++i) {
+        index->page_map[eizo_control_page_key(pages[i].page)] = (uint8_t)(i + 1);
+    }
+    index->n_pages = n_pages;
+    index->slots = slots;
+}
+
+static enum eizo_result
+eizo_controls_parse(const uint8_t *desc, size_t len, struct eizo_control_table *table)
+{
+    // Count first, so the table can be allocated at its exact size.
+    *table = (struct eizo_control_table) { .n = EIZO_MAX_CONTROLS };
+    enum eizo_result res = eizo_parse_descriptor(desc, len, table);
+    if (res < EIZO_SUCCESS) {
+        return res;
+    }
+
+    // Dropping the rest would make controls disappear without a trace.
+    if (res == EIZO_INCOMPLETE) {
+        eizo_log_error("Descriptor has more than %zu controls.", EIZO_MAX_CONTROLS);
+        return EIZO_ERROR_BAD_DATA;
+    }
+
+    if (table->n == 0) {
+        return EIZO_ERROR_BAD_DATA;
+    }
+
+    void *block = calloc(table->n, EIZO_CONTROL_ENTRY_SIZE);
+    if (!block) {
+        return EIZO_ERROR_NO_MEMORY;
+    }
+
+    eizo_control_table_init(table, block, table->n);
+    res = eizo_parse_descriptor(desc, len, table);
+    if (res < EIZO_SUCCESS) {
+        free(block);
+        return res;
+    }
+
+    eizo_control_table_sort(table);
+    return EIZO_SUCCESS;
+}
+
+static struct eizo_controls *
+eizo_controls_lookup(enum eizo_pid pid, uint32_t hash, const uint8_t *desc, size_t len)
+{
+    for (struct eizo_controls *c = eizo_controls_pool; c; c = c->next) {
+        if (c->pid == pid && c->hash == hash && c->desc_len == len && memcmp(c->desc, desc, len) == 0) {
+            return c;
+        }
+    }
+    return nullptr;
+}
+
+enum eizo_result
+eizo_controls_acquire(
+    enum eizo_pid pid,
+    const uint8_t *desc,
+    size_t len,
+    struct eizo_controls **ctrl)
+{
+    uint32_t hash = eizo_crc32(desc, len);
+    enum eizo_result res = EIZO_SUCCESS;
+
+    pthread_mutex_lock(&eizo_controls_lock);
+
+    struct eizo_controls *c = eizo_controls_lookup(pid, hash, desc, len);
+    if (c) {
+        ++c->refs;
+        goto end;
+    }
+
+    c = calloc(1, sizeof(*c));
+    uint8_t *copy = malloc(len);
+    if (!c || !copy) {
+        free(c);
+        free(copy);
+        c = nullptr;
+        res = EIZO_ERROR_NO_MEMORY;
+        goto end;
+    }
+
+    res = eizo_controls_parse(desc, len, &c->table);
+    if (res < EIZO_SUCCESS) {
+        free(c);
+        free(copy);
+        c = nullptr;
+        goto end;
+    }
+
+    memcpy(copy, desc, len);
+    eizo_control_index_build(&c->index, &c->table);
+    c->refs = 1;
+    c->pooled = true;
+    c->pid = pid;
+    c->hash = hash;
+    c->desc_len = len;
+    c->desc = copy;
+    c->next = eizo_controls_pool;
+    eizo_controls_pool = c;
+
+end:
+    pthread_mutex_unlock(&eizo_controls_lock);
+    *ctrl = c;
+    return res;
+}
+
+enum eizo_result
+eizo_controls_wrap(const void *block, size_t n, struct eizo_controls **ctrl)
+{
+    struct eizo_controls *c = calloc(1, sizeof(*c));
+    if (!c) {
+        return EIZO_ERROR_NO_MEMORY;
+    }
+
+    eizo_control_table_init(&c->table, (void *)block, n);
+    eizo_control_index_build(&c->index, &c->table);
+    c->refs = 1;
+    *ctrl = c;
+    return EIZO_SUCCESS;
+}
+
+void
+eizo_controls_release(struct eizo_controls *ctrl)
+{
+    if (!ctrl) {
+        return;
+    }
+
+    if (ctrl->pooled) {
+        pthread_mutex_lock(&eizo_controls_lock);
+        bool last = --ctrl->refs == 0;
+        if (last) {
+            struct eizo_controls **p = &eizo_controls_pool;
+            while (*p != ctrl) {
+                p = &(*p)->next;
+            }
+            *p = ctrl->next;
+        }
+        pthread_mutex_unlock(&eizo_controls_lock);
+
+        if (!last) {
+            return;
+        }
+        free(ctrl->table.usage);
+        free(ctrl->desc);
+    }
+
+    free(ctrl->index.slots);
+    free(ctrl);
+}
@@ -12,6 +12,7 @@
 #include "eizo/handle.h"
 #include "eizo/control.h"
 #include "eizo/debug.h"
+#include "eizo/eeprom.h"
 #include "internal.h"
 
 static void
@@ -32,25 +33,26 @@ eizo_print_hex(uint8_t *data, size_t size)
 void
 eizo_dbg_dump_secondary_descriptor(struct eizo_handle *handle)
 {
-    const struct eizo_control *ctrl = nullptr;
-    size_t n = eizo_get_controls(handle, &ctrl);
+    const struct eizo_control_table *table = nullptr;
+    size_t n = eizo_get_controls(handle, &table);
     if (n == 0) {
         return;
     }
 
     for (size_t i = 0; i < n; ++i) {
-        const char *ustr = eizo_usage_to_string(ctrl[i].usage);
+        struct eizo_control ctrl = eizo_control_get(table, i);
+        const char *ustr = eizo_usage_to_string(ctrl.usage);
         if (!ustr) {
             ustr = "?";
         }
-        printf("%3w32u | %08w32x | %-40s | %4w32u | %5w32u | %11w32i | %11w32i |\n",
-               ctrl[i].report_id,
-               ctrl[i].usage,
+        printf("%3w8u | %08w32x | %-40s | %4w8u | %5w16u | %11w32i | %11w32i |\n",
+               ctrl.report_id,
+               ctrl.usage,
                ustr,
-               ctrl[i].report_size,
-               ctrl[i].report_count,
-               ctrl[i].logical_minimum,
-               ctrl[i].logical_maximum);
+               ctrl.report_size,
+               ctrl.report_count,
+               ctrl.logical_minimum,
+               ctrl.logical_maximum);
     }
 }
 
@@ -95,33 +97,16 @@ eizo_dbg_dump_ff300009(struct eizo_handle *handle)
 void
 eizo_dbg_dump_eeprom(struct eizo_handle *handle)
 {
-#define EEP_SIZE 512
-    uint8_t buf[EEP_SIZE];
+    uint8_t buf[EIZO_EEPROM_SIZE];
 
-    union {
-        uint16_t value;
-        uint8_t buf[2];
-    } u;
-
-    for (uint16_t i = 0; i < EEP_SIZE; ++i) {
-        u.value = htole16(i);
-        enum eizo_result res = eizo_set_value(handle, EIZO_USAGE_EEPROM_ADDRESS, u.buf, 2);
-        if (res < EIZO_SUCCESS) {
-            fprintf(stderr, "%s: Failed to set eep address %w16u.\n", __func__, i);
-            return;
-        }
-
-        res = eizo_get_value(handle, EIZO_USAGE_EEPROM_DATA, u.buf, 2);
-        if (res < EIZO_SUCCESS) {
-            fprintf(stderr, "%s: Failed to get eep data at address %w16u.\n", __func__, i);
-            return;
-        }
-        buf[i] = (uint8_t)le16toh(u.value);
+    enum eizo_result res = eizo_read_eeprom(handle, 0, sizeof(buf), buf);
+    if (res < EIZO_SUCCESS) {
+        fprintf(stderr, "%s: Failed to read eep data. %i\n", __func__, res);
+        return;
     }
 
     printf("eep data ");
-    eizo_print_hex(buf, EEP_SIZE);
-#undef EEP_SIZE
+    eizo_print_hex(buf, sizeof(buf));
 }
 
 void
@@ -289,48 +274,92 @@ eizo_dbg_dump_gain_definition(struct eizo_handle *handle)
 void
 eizo_dbg_dump_all_usages(struct eizo_handle *handle)
 {
-    uint8_t buf[512];
+    const struct eizo_control_table *table = nullptr;
+    size_t n = eizo_get_controls(handle, &table);
+    if (n == 0) {
+        return;
+    }
 
-    const struct eizo_control *ctrl = nullptr;
-    size_t n = eizo_get_controls(handle, &ctrl);
+    enum eizo_usage *usages = calloc(n, sizeof(*usages));
+    uint8_t **values = calloc(n, sizeof(*values));
+    uint8_t *buf = calloc(n, 512);
+    size_t *lens = calloc(n, sizeof(*lens));
+    enum eizo_result *results = calloc(n, sizeof(*results));
+    if (!usages || !values || !buf || !lens || !results) {
+        fprintf(stderr, "%s: %s\n", __func__, strerror(errno));
+        goto end;
+    }
 
+    size_t m = 0;
     for (size_t i = 0; i < n; ++i) {
-        if (ctrl[i].report_size % 8 != 0) {
-            continue;
-        }
-
-        size_t len = (ctrl[i].report_size / 8) * ctrl[i].report_count;
+        struct eizo_control ctrl = eizo_control_get(table, i);
+        size_t len = eizo_control_size(&ctrl);
         if (len > 512 || len == 0) {
             continue;
         }
 
-        const char *ustr = eizo_usage_to_string(ctrl[i].usage);
-        if (!ustr) {
-            ustr = "?";
-        }
+        usages[m] = ctrl.usage;
+        values[m] = buf + m * 512;
+        lens[m] = 512;
+        ++m;
+    }
+
+    eizo_get_values(handle, usages, m, values, lens, results);
 
-        printf("%08w32x | %-40s | ", ctrl[i].usage, ustr);
+    for (size_t i = 0; i < m; ++i) {
+        const struct eizo_usage_info *info = eizo_usage_get_info(usages[i]);
 
-        memset(buf, 0, len);
-        enum eizo_result res = eizo_get_value(handle, ctrl[i].usage, buf, len);
-        if (res < EIZO_SUCCESS) {
-            printf("error %i\n", res);
+        printf("%08w32x | %-40s | ", usages[i], info ? info->name : "?");
+
+        if (results[i] < EIZO_SUCCESS) {
+            printf("error %i\n", results[i]);
             continue;
         }
 
-        for (size_t j = 0; j < len; ++j) {
-            printf("%02w8x", buf[j]);
+        for (size_t j = 0; j < lens[i]; ++j) {
+            printf("%02w8x", values[i][j]);
+        }
+
+        if (info && info->format != EIZO_VALUE_FORMAT_RAW) {
+            char str[128];
+            eizo_usage_format_value(info, values[i], lens[i], str, sizeof(str));
+            printf(" | %s", str);
         }
 
         printf("\n");
-        usleep(10000);
     }
+
+end:
+    free(results);
+    free(lens);
+    free(buf);
+    free(values);
+    free(usages);
+}
+
+static void
+eizo_dbg_print_event(eizo_handle_t, const struct eizo_value_event *ev, void *)
+{
+    const char *ustr = eizo_usage_to_string(ev->usage);
+    if (!ustr) {
+        printf("%3w8u %3w16u %-20x ", ev->report_id, ev->counter, ev->usage);
+    } else {
+        printf("%3w8u %3w16u %-20s ", ev->report_id, ev->counter, ustr);
+    }
+
+    for (size_t i = 0; i < ev->len; ++i) {
+        printf("%02w8x", ev->value[i]);
+    }
+    printf("\n");
 }
 
 int
 eizo_dbg_poll(struct eizo_handle *handle)
 {
-    struct eizo_value_report r = {};
+    enum eizo_result res = eizo_add_value_callback(handle, 0, eizo_dbg_print_event, nullptr);
+    if (res < EIZO_SUCCESS) {
+        return res;
+    }
 
     struct pollfd pfds[1];
     pfds[0].fd = eizo_get_fd(handle);
@@ -345,44 +374,22 @@ eizo_dbg_poll(struct eizo_handle *handle)
         }
 
         if (pfds[0].revents & POLLIN) {
-            ssize_t n = read(pfds[0].fd, &r, sizeof(r));
-
-            if (n >= 7) {
-                enum eizo_usage usage = eizo_swap_usage(r.usage);
-                uint16_t counter = le16toh(r.counter);
-
-                size_t len = (size_t)n - 7;
-
-                const struct eizo_control *ctrl = eizo_control_find(handle, usage);
-                if (ctrl && ctrl->report_size % 8 == 0) {
-                    uint32_t q = (ctrl->report_size / 8) * ctrl->report_count;
-                    if (q > 0 && q <= 512) {
-                        len = (size_t)q;
-                    }
-                }
-
-                const char *ustr = eizo_usage_to_string(usage);
-                if (!ustr) {
-                    printf("%3w8u %3w16u %-20x ", r.report_id, counter, usage);
-                } else {
-                    printf("%3w8u %3w16u %-20s ", r.report_id, counter, ustr);
-                }
-
-                for (size_t i = 0; i < len; ++i) {
-                    printf("%02w8x", r.value[i]);
-                }
-                printf("\n");
-            } else {
-                fprintf(stderr, "%s: read < 7\n", __func__);
+            rc = eizo_dispatch(handle);
+            if (rc < 0) {
+                fprintf(stderr, "%s: failed to read input report %i\n", __func__, rc);
+                break;
             }
         } else if (pfds[0].revents & POLLERR) {
           fprintf(stderr, "%s: communication error (POLLERR)\n", __func__);
-          return -1;
+          rc = -1;
+          break;
         } else if (pfds[0].revents & POLLHUP) {
           fprintf(stderr, "%s: communication error (POLLHUP)\n", __func__);
-          return -1;
+          rc = -1;
+          break;
         }
     }
 
+    eizo_remove_value_callback(handle, 0, eizo_dbg_print_event, nullptr);
     return rc;
 }
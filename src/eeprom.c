@@ -0,0 +1,403 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory.h>
+#include <errno.h>
+
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "eizo/handle.h"
+#include "eizo/eeprom.h"
+#include "eizo/log.h"
+#include "internal.h"
+
+// On-disk layout of an EEPROM image, all fields are little endian. The
+// header is followed by size bytes of EEPROM data, starting at address 0.
+struct [[gnu::packed]] eizo_eeprom_header {
+    char     magic[8];
+    uint32_t version;
+    uint16_t vid;
+    uint16_t pid;
+    uint64_t serial;
+    uint8_t  firmware[EIZO_FIRMWARE_VERSION_SIZE];
+    uint32_t size;
+    uint32_t crc;
+};
+static_assert(sizeof(struct eizo_eeprom_header) == 64);
+static_assert(sizeof(((struct eizo_eeprom_image *)nullptr)->firmware) == EIZO_FIRMWARE_VERSION_SIZE);
+
+static const char EIZO_EEPROM_MAGIC[8] = "EIZOEEP";
+constexpr uint32_t EIZO_EEPROM_VERSION = 1;
+
+// Give up on detecting auto-increment after this many reads, e.g. when the
+// EEPROM is filled with a single value.
+constexpr size_t EIZO_EEPROM_MAX_PROBES = 8;
+
+enum eizo_eeprom_mode {
+    EIZO_EEPROM_MODE_UNKNOWN,
+    EIZO_EEPROM_MODE_EXPLICIT,
+    EIZO_EEPROM_MODE_AUTOINCREMENT,
+};
+
+static enum eizo_result
+eizo_eeprom_set_address(struct eizo_handle *handle, size_t address)
+{
+    uint8_t buf[2] = { (uint8_t)address, (uint8_t)(address >> 8) };
+    return eizo_set_value_raw(handle, EIZO_USAGE_EEPROM_ADDRESS, buf, 2);
+}
+
+static enum eizo_result
+eizo_eeprom_get_data(struct eizo_handle *handle, uint8_t *data)
+{
+    // The report has room for two bytes, but only the low one carries data.
+    uint8_t buf[2];
+    enum eizo_result res = eizo_get_value_raw(handle, EIZO_USAGE_EEPROM_DATA, buf, 2);
+    if (res >= EIZO_SUCCESS) {
+        *data = buf[0];
+    }
+    return res;
+}
+
+static enum eizo_result
+eizo_read_eeprom_locked(struct eizo_handle *handle, uint16_t offset, size_t len, uint8_t *buf)
+{
+    enum eizo_eeprom_mode mode = EIZO_EEPROM_MODE_UNKNOWN;
+    uint8_t probe = 0;
+
+    for (size_t i = 0; i < len; ++i) {
+        enum eizo_result res;
+
+        if (mode != EIZO_EEPROM_MODE_AUTOINCREMENT) {
+            res = eizo_eeprom_set_address(handle, offset + i);
+            if (res < EIZO_SUCCESS) {
+                return res;
+            }
+        }
+
+        res = eizo_eeprom_get_data(handle, &buf[i]);
+        if (res < EIZO_SUCCESS) {
+            return res;
+        }
+
+        if (mode != EIZO_EEPROM_MODE_UNKNOWN) {
+            // Other requests may only go in between if the address is
+            // written for every byte anyway.
+            if (mode == EIZO_EEPROM_MODE_EXPLICIT) {
+                eizo_io_yield(handle);
+            }
+            continue;
+        }
+
+        // The previous iteration read its address a second time without
+        // writing it. That returned this byte if the device moved on, and
+        // the previous byte otherwise. Only bytes that differ tell.
+        if (i > 0 && buf[i] != buf[i - 1]) {
+            mode = probe == buf[i] ? EIZO_EEPROM_MODE_AUTOINCREMENT : EIZO_EEPROM_MODE_EXPLICIT;
+            continue;
+        }
+
+        if (i + 1 >= EIZO_EEPROM_MAX_PROBES) {
+            mode = EIZO_EEPROM_MODE_EXPLICIT;
+            continue;
+        }
+
+        if (i + 1 < len) {
+            res = eizo_eeprom_get_data(handle, &probe);
+            if (res < EIZO_SUCCESS) {
+                return res;
+            }
+        }
+    }
+
+    return EIZO_SUCCESS;
+}
+
+struct eizo_eeprom_args {
+    uint16_t offset;
+    size_t len;
+    uint8_t *buf;
+    struct eizo_eeprom_image *image;
+    const struct eizo_eeprom_image *restore;
+    enum eizo_restore_flags flags;
+    size_t written;
+};
+
+static enum eizo_result
+eizo_read_eeprom_job(struct eizo_handle *handle, void *arg)
+{
+    struct eizo_eeprom_args *a = arg;
+    return eizo_read_eeprom_locked(handle, a->offset, a->len, a->buf);
+}
+
+enum eizo_result
+eizo_read_eeprom(struct eizo_handle *handle, uint16_t offset, size_t len, uint8_t *buf)
+{
+    if (offset > EIZO_EEPROM_SIZE || len > EIZO_EEPROM_SIZE - offset) {
+        return EIZO_ERROR_OUT_OF_RANGE;
+    }
+
+    // The address is shared by everyone talking to the monitor, so the
+    // whole transfer has to happen without other requests in between.
+    struct eizo_eeprom_args a = { .offset = offset, .len = len, .buf = buf };
+    return eizo_io_run(handle, EIZO_IO_LONG, eizo_read_eeprom_job, &a);
+}
+
+static enum eizo_result
+eizo_read_eeprom_image_job(struct eizo_handle *handle, void *arg)
+{
+    struct eizo_eeprom_image *image = ((struct eizo_eeprom_args *)arg)->image;
+
+    // Not every monitor knows the firmware version, leave it empty then.
+    eizo_get_value_raw(handle, EIZO_USAGE_FIRMWARE_VERSION, image->firmware, EIZO_FIRMWARE_VERSION_SIZE);
+    return eizo_read_eeprom_locked(handle, 0, EIZO_EEPROM_SIZE, image->data);
+}
+
+enum eizo_result
+eizo_read_eeprom_image(struct eizo_handle *handle, struct eizo_eeprom_image *image)
+{
+    memset(image, 0, sizeof(*image));
+    image->pid = eizo_get_pid(handle);
+    image->serial = eizo_get_serial(handle);
+
+    struct eizo_eeprom_args a = { .image = image };
+    return eizo_io_run(handle, EIZO_IO_LONG, eizo_read_eeprom_image_job, &a);
+}
+
+// Bytes that identify a single monitor, a restore never touches them.
+static const struct {
+    uint16_t address;
+    uint16_t len;
+} eizo_eeprom_identity[] = {
+    { EIZO_EEPROM_ADDRESS_PRODUCT_STRING_1, 8 },
+    { EIZO_EEPROM_ADDRESS_SERIAL_STRING, 8 },
+    { EIZO_EEPROM_ADDRESS_PRODUCT_STRING_2, 8 },
+};
+
+static bool
+eizo_eeprom_is_identity(size_t address)
+{
+    for (size_t i = 0; i < sizeof(eizo_eeprom_identity) / sizeof(eizo_eeprom_identity[0]); ++i) {
+        size_t start = eizo_eeprom_identity[i].address;
+        if (address >= start && address < start + eizo_eeprom_identity[i].len) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static enum eizo_result
+eizo_eeprom_write_byte(struct eizo_handle *handle, size_t address, uint8_t data)
+{
+    enum eizo_result res = eizo_eeprom_set_address(handle, address);
+    if (res < EIZO_SUCCESS) {
+        return res;
+    }
+
+    uint8_t buf[2] = { data, 0 };
+    res = eizo_set_value_raw(handle, EIZO_USAGE_EEPROM_DATA, buf, 2);
+    if (res < EIZO_SUCCESS) {
+        return res;
+    }
+
+    // Always go back to the address, the write may have moved it on.
+    res = eizo_eeprom_set_address(handle, address);
+    if (res < EIZO_SUCCESS) {
+        return res;
+    }
+
+    uint8_t check = 0;
+    res = eizo_eeprom_get_data(handle, &check);
+    if (res < EIZO_SUCCESS) {
+        return res;
+    }
+
+    if (check != data) {
+        eizo_log_error("read back %02w8x instead of %02w8x at %04zx.", check, data, address);
+        return EIZO_ERROR_BAD_DATA;
+    }
+    return EIZO_SUCCESS;
+}
+
+static enum eizo_result
+eizo_restore_eeprom_locked(
+    struct eizo_handle *handle,
+    const struct eizo_eeprom_image *image,
+    size_t *written)
+{
+    uint8_t current[EIZO_EEPROM_SIZE];
+    enum eizo_result res = eizo_read_eeprom_locked(handle, 0, EIZO_EEPROM_SIZE, current);
+    if (res < EIZO_SUCCESS) {
+        return res;
+    }
+
+    // Reads are free as far as wear goes, so only bytes that actually
+    // differ are written.
+    for (size_t i = 0; i < EIZO_EEPROM_SIZE; ++i) {
+        if (image->data[i] == current[i] || eizo_eeprom_is_identity(i)) {
+            continue;
+        }
+
+        res = eizo_eeprom_write_byte(handle, i, image->data[i]);
+        if (res < EIZO_SUCCESS) {
+            return res;
+        }
+        ++*written;
+
+        // Every byte starts out by writing its address.
+        eizo_io_yield(handle);
+    }
+
+    return EIZO_SUCCESS;
+}
+
+static bool
+eizo_firmware_is_empty(const uint8_t firmware[EIZO_FIRMWARE_VERSION_SIZE])
+{
+    for (size_t i = 0; i < EIZO_FIRMWARE_VERSION_SIZE; ++i) {
+        if (firmware[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static enum eizo_result
+eizo_restore_eeprom_job(struct eizo_handle *handle, void *arg)
+{
+    struct eizo_eeprom_args *a = arg;
+
+    // The layout may change between firmware versions. Either side not
+    // knowing its version can't be told apart from a match.
+    uint8_t fw[EIZO_FIRMWARE_VERSION_SIZE] = {};
+    if (!(a->flags & EIZO_RESTORE_ANY_FIRMWARE)
+        && !eizo_firmware_is_empty(a->restore->firmware)
+        && eizo_get_value_raw(handle, EIZO_USAGE_FIRMWARE_VERSION, fw, sizeof(fw)) >= EIZO_SUCCESS
+        && !eizo_firmware_is_empty(fw)
+        && memcmp(fw, a->restore->firmware, sizeof(fw)) != 0)
+    {
+        eizo_log_warning("image is for firmware %.32s, monitor runs %.32s.", a->restore->firmware, fw);
+        return EIZO_ERROR_NOT_PERMITTED;
+    }
+
+    return eizo_restore_eeprom_locked(handle, a->restore, &a->written);
+}
+
+enum eizo_result
+eizo_restore_eeprom_image(
+    struct eizo_handle *handle,
+    const struct eizo_eeprom_image *image,
+    size_t *written)
+{
+    return eizo_restore_eeprom_image_ex(handle, image, EIZO_RESTORE_DEFAULT, written);
+}
+
+enum eizo_result
+eizo_restore_eeprom_image_ex(
+    struct eizo_handle *handle,
+    const struct eizo_eeprom_image *image,
+    enum eizo_restore_flags flags,
+    size_t *written)
+{
+    // The layout is only known to hold within one model.
+    if (image->pid != eizo_get_pid(handle)) {
+        eizo_log_warning("image is for pid %04w16x, monitor is %04w16x.",
+                         image->pid, eizo_get_pid(handle));
+        return EIZO_ERROR_INVALID_ARGUMENT;
+    }
+
+    struct eizo_eeprom_args a = { .restore = image, .flags = flags };
+    enum eizo_result res = eizo_io_run(handle, EIZO_IO_LONG, eizo_restore_eeprom_job, &a);
+
+    if (written) {
+        *written = a.written;
+    }
+    return res;
+}
+
+enum eizo_result
+eizo_save_eeprom_image(const struct eizo_eeprom_image *image, const char *path)
+{
+    struct eizo_eeprom_header hdr = {};
+    memcpy(hdr.magic, EIZO_EEPROM_MAGIC, sizeof(hdr.magic));
+    hdr.version = htole32(EIZO_EEPROM_VERSION);
+    hdr.vid = htole16(EIZO_VID);
+    hdr.pid = htole16(image->pid);
+    hdr.serial = htole64(image->serial);
+    memcpy(hdr.firmware, image->firmware, EIZO_FIRMWARE_VERSION_SIZE);
+    hdr.size = htole32(EIZO_EEPROM_SIZE);
+    hdr.crc = htole32(eizo_crc32(image->data, EIZO_EEPROM_SIZE));
+
+    // Write next to path and rename into place, so an earlier image at
+    // path survives a crash or a full disk.
+    char tmp[PATH_MAX];
+    int n = snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path);
+    if (n < 0 || (size_t)n >= sizeof(tmp)) {
+        return EIZO_ERROR_INVALID_ARGUMENT;
+    }
+
+    int fd = mkstemp(tmp);
+    if (fd < 0) {
+        eizo_log_warning("failed to create %s. %s", tmp, strerror(errno));
+        return EIZO_ERROR_IO;
+    }
+
+    // mkstemp() creates the file for the owner only.
+    bool ok = fchmod(fd, 0644) == 0
+           && write(fd, &hdr, sizeof(hdr)) == (ssize_t)sizeof(hdr)
+           && write(fd, image->data, EIZO_EEPROM_SIZE) == (ssize_t)EIZO_EEPROM_SIZE
+           && fsync(fd) == 0;
+    if (close(fd) < 0) {
+        ok = false;
+    }
+
+    if (!ok || rename(tmp, path) < 0) {
+        unlink(tmp);
+        return EIZO_ERROR_IO;
+    }
+
+    return EIZO_SUCCESS;
+}
+
+enum eizo_result
+eizo_load_eeprom_image(const char *path, struct eizo_eeprom_image *image)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        eizo_log_warning("failed to open %s. %s", path, strerror(errno));
+        return EIZO_ERROR_IO;
+    }
+
+    struct eizo_eeprom_header hdr;
+    uint8_t data[EIZO_EEPROM_SIZE + 1];
+
+    ssize_t n = read(fd, &hdr, sizeof(hdr));
+    ssize_t m = n == (ssize_t)sizeof(hdr) ? read(fd, data, sizeof(data)) : -1;
+    close(fd);
+
+    if (n != (ssize_t)sizeof(hdr) || m < 0) {
+        return EIZO_ERROR_IO;
+    }
+
+    if (memcmp(hdr.magic, EIZO_EEPROM_MAGIC, sizeof(hdr.magic)) != 0
+        || le32toh(hdr.version) != EIZO_EEPROM_VERSION
+        || le16toh(hdr.vid) != EIZO_VID
+        || le32toh(hdr.size) != EIZO_EEPROM_SIZE
+        || m != EIZO_EEPROM_SIZE)
+    {
+        eizo_log_warning("%s is not a supported EEPROM image.", path);
+        return EIZO_ERROR_BAD_DATA;
+    }
+
+    if (eizo_crc32(data, EIZO_EEPROM_SIZE) != le32toh(hdr.crc)) {
+        eizo_log_warning("checksum mismatch in %s.", path);
+        return EIZO_ERROR_BAD_DATA;
+    }
+
+    image->pid = le16toh(hdr.pid);
+    image->serial = le64toh(hdr.serial);
+    memcpy(image->firmware, hdr.firmware, EIZO_FIRMWARE_VERSION_SIZE);
+    memcpy(image->data, data, EIZO_EEPROM_SIZE);
+    return EIZO_SUCCESS;
+}
@@ -0,0 +1,856 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory.h>
+#include <errno.h>
+#include <time.h>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <linux/hidraw.h>
+
+#include "eizo/handle.h"
+#include "eizo/emulator.h"
+#include "eizo/log.h"
+#include "internal.h"
+
+enum eizo_emulator_rid : uint8_t {
+    EIZO_EMULATOR_RID_DESC = 1,
+    EIZO_EMULATOR_RID_SET = 2,
+    EIZO_EMULATOR_RID_GET = 3,
+    EIZO_EMULATOR_RID_SET_V2 = 4,
+    EIZO_EMULATOR_RID_GET_V2 = 5,
+    EIZO_EMULATOR_RID_COUNTER = 6,
+    EIZO_EMULATOR_RID_VERIFY = 7,
+    EIZO_EMULATOR_RID_SN_PROD = 8,
+    EIZO_EMULATOR_RID_KEY_VALUE = 9,
+    EIZO_EMULATOR_RID_INPUT = 10,
+};
+
+constexpr size_t EIZO_EMULATOR_EEPROM_SIZE = 512;
+constexpr size_t EIZO_EMULATOR_CKL_SIZE = 150;
+constexpr size_t EIZO_EMULATOR_CKL_PAGE = 62;
+constexpr size_t EIZO_EMULATOR_LUT_ENTRIES = 1024;
+constexpr size_t EIZO_EMULATOR_LUT_SIZE = 3 * EIZO_EMULATOR_LUT_ENTRIES * 2;
+constexpr size_t EIZO_EMULATOR_LUT_PAGE = 510;
+
+struct eizo_emulator_control {
+    enum eizo_usage usage;
+    int32_t logical_minimum;
+    int32_t logical_maximum;
+    uint16_t size;
+    uint32_t initial;
+};
+
+// Loosely modelled on an EV2760.
+static const struct eizo_emulator_control eizo_emulator_controls[] = {
+    { EIZO_USAGE_VOLUME,                  0, 30, 1, 10 },
+    { EIZO_USAGE_BRIGHTNESS,              0, 200, 2, 120 },
+    { EIZO_USAGE_CONTRAST,                0, 140, 2, 100 },
+    { EIZO_USAGE_GAIN_RED,                0, 255, 2, 255 },
+    { EIZO_USAGE_GAIN_GREEN,              0, 255, 2, 255 },
+    { EIZO_USAGE_GAIN_BLUE,               0, 255, 2, 255 },
+    { EIZO_USAGE_COLOR_TEMPERATURE,       0, 24, 1, 6 },
+    { EIZO_USAGE_FF000009_OPTIONS,        0, 0xffff, 2, 0 },
+    { EIZO_USAGE_OSD_INDICATOR,           0, 0xffff, 2, 0 },
+    { EIZO_USAGE_PROFILE,                 0, 48, 1, 0 },
+    { EIZO_USAGE_EEPROM_ADDRESS,          0, 0xffff, 2, 0 },
+    { EIZO_USAGE_EEPROM_DATA,             0, 0xffff, 2, 0 },
+    { EIZO_USAGE_USAGE_TIME,              0, 0x7fffffff, 3, 0x1234 },
+    { EIZO_USAGE_GAMMA,                   0, 255, 1, 4 },
+    { EIZO_USAGE_SATURATION,              -128, 127, 1, 0 },
+    { EIZO_USAGE_HUE,                     -128, 127, 1, 0 },
+    { EIZO_USAGE_POWER,                   0, 1, 1, 1 },
+    { EIZO_USAGE_AUTO_ECOVIEW,            0, 1, 1, 0 },
+    { EIZO_USAGE_OSD_LANGUAGE,            0, 15, 1, 0 },
+    { EIZO_USAGE_POWER_LED,               0, 1, 1, 1 },
+    { EIZO_USAGE_BOOT_LOGO,               0, 1, 1, 1 },
+    { EIZO_USAGE_FIRMWARE_VERSION,        0, 255, 8, 0 },
+    { EIZO_USAGE_ECOVIEW_SENSOR,          0, 1, 1, 0 },
+    { EIZO_USAGE_TEMPERATURE_1,           -128, 127, 1, 38 },
+    { EIZO_USAGE_OSD_KEY_LOCK,            0, 2, 1, 0 },
+    { EIZO_USAGE_INPUT_PORT,              0, 0xffff, 2, 0x0300 },
+    { EIZO_USAGE_AUTO_INPUT,              0, 1, 1, 1 },
+    { EIZO_USAGE_POWER_SAVE,              0, 1, 1, 1 },
+    { EIZO_USAGE_SUPER_RESOLUTION,        0, 3, 1, 0 },
+    { EIZO_USAGE_EV_AVAILABLE_CUSTOM_KEY_LOCK_OFFSET_SIZE, 0, 0xffff, 4, 0 },
+    { EIZO_USAGE_EV_AVAILABLE_CUSTOM_KEY_LOCK_DATA, 0, 255, 64, 0 },
+    { EIZO_USAGE_EV_CUSTOM_KEY_LOCK,      0, 255, 6, 0 },
+    { EIZO_USAGE_USB_SELECTION,           0, 1, 1, 0 },
+    { EIZO_USAGE_KVM_SWITCH,              0, 1, 1, 0 },
+    { EIZO_USAGE_DEBUG_MODE,              0, 1, 1, 0 },
+    { EIZO_USAGE_EDID,                    0, 255, 256, 0 },
+    { EIZO_USAGE_SERIAL_STRING,           0, 255, 8, 0 },
+    { EIZO_USAGE_GAIN_DEFINITION_UNKNOWN, 0, 255, 1, 0 },
+    { EIZO_USAGE_GAIN_DEFINITION_DATA,    0, 255, 75, 0 },
+    { EIZO_USAGE_COLOR_MATRIX_32,         0, 255, 36, 0 },
+    { EIZO_USAGE_FRONT_LUT,               0, 255, 512, 0 },
+    { EIZO_USAGE_FRONT_LUT_ENABLED,       0, 1, 1, 0 },
+    { EIZO_USAGE_REAR_LUT,                0, 255, 512, 0 },
+};
+
+constexpr size_t EIZO_EMULATOR_N_CONTROLS = sizeof(eizo_emulator_controls) / sizeof(eizo_emulator_controls[0]);
+
+// Filler controls are spread over vendor pages of their own, every third
+// usage id.
+static_assert(EIZO_EMULATOR_N_CONTROLS + EIZO_EMULATOR_MAX_EXTRA_CONTROLS == EIZO_MAX_CONTROLS);
+constexpr uint32_t EIZO_EMULATOR_EXTRA_PAGE = 0xff10;
+constexpr size_t EIZO_EMULATOR_EXTRA_PAGES = 8;
+
+// Short items, the low two bits of the prefix select the data size.
+enum eizo_emulator_item : uint8_t {
+    EIZO_EMULATOR_ITEM_USAGE_PAGE = 0x06,
+    EIZO_EMULATOR_ITEM_LOGICAL_MINIMUM = 0x17,
+    EIZO_EMULATOR_ITEM_LOGICAL_MAXIMUM = 0x27,
+    EIZO_EMULATOR_ITEM_REPORT_SIZE = 0x75,
+    EIZO_EMULATOR_ITEM_REPORT_ID = 0x85,
+    EIZO_EMULATOR_ITEM_REPORT_COUNT = 0x96,
+    EIZO_EMULATOR_ITEM_USAGE = 0x0a,
+    EIZO_EMULATOR_ITEM_INPUT = 0x81,
+    EIZO_EMULATOR_ITEM_FEATURE = 0xb1,
+    EIZO_EMULATOR_ITEM_COLLECTION = 0xa1,
+    EIZO_EMULATOR_ITEM_END_COLLECTION = 0xc0,
+};
+
+struct eizo_emulator_client {
+    struct eizo_emulator_client *next;
+    struct eizo_emulator *emulator;
+    // The other end of the transport fd, input reports are sent here.
+    int peer;
+};
+
+struct eizo_emulator {
+    struct eizo_emulator_config config;
+    char product[17];
+
+    pthread_mutex_t lock;
+    struct eizo_emulator_client *clients;
+    uint64_t requests;
+    uint16_t counter;
+    // Request count at which the counter is bumped, 0 for never.
+    uint64_t race_at;
+
+    uint8_t *values;
+    size_t offsets[EIZO_EMULATOR_N_CONTROLS];
+
+    uint8_t primary[512];
+    size_t primary_len;
+    uint8_t secondary[HID_MAX_DESCRIPTOR_SIZE];
+    size_t secondary_len;
+    size_t desc_pos;
+
+    // State of the last value request, read back through the get and
+    // verify reports.
+    uint32_t last_usage;
+    uint8_t last_result;
+    uint8_t response[512];
+
+    uint8_t eeprom[EIZO_EMULATOR_EEPROM_SIZE];
+    uint16_t eeprom_address;
+
+    uint8_t ckl[EIZO_EMULATOR_CKL_SIZE];
+    uint16_t ckl_offset;
+
+    // Front and rear LUT.
+    uint8_t lut[2][EIZO_EMULATOR_LUT_SIZE];
+};
+
+static uint8_t *
+eizo_emulator_item(uint8_t *p, uint8_t prefix, uint32_t data)
+{
+    static const size_t sizes[] = { 0, 1, 2, 4 };
+    size_t n = sizes[prefix & 3];
+
+    *p++ = prefix;
+    for (size_t i = 0; i < n; ++i) {
+        *p++ = (uint8_t)(data >> (8 * i));
+    }
+    return p;
+}
+
+static uint8_t *
+eizo_emulator_feature(
+    uint8_t *p,
+    uint8_t report_id,
+    uint32_t usage,
+    int32_t logical_minimum,
+    int32_t logical_maximum,
+    uint16_t count)
+{
+    p = eizo_emulator_item(p, EIZO_EMULATOR_ITEM_USAGE_PAGE, usage >> 16);
+    p = eizo_emulator_item(p, EIZO_EMULATOR_ITEM_REPORT_ID, report_id);
+    p = eizo_emulator_item(p, EIZO_EMULATOR_ITEM_USAGE, usage & 0xffff);
+    p = eizo_emulator_item(p, EIZO_EMULATOR_ITEM_LOGICAL_MINIMUM, (uint32_t)logical_minimum);
+    p = eizo_emulator_item(p, EIZO_EMULATOR_ITEM_LOGICAL_MAXIMUM, (uint32_t)logical_maximum);
+    p = eizo_emulator_item(p, EIZO_EMULATOR_ITEM_REPORT_SIZE, 8);
+    p = eizo_emulator_item(p, EIZO_EMULATOR_ITEM_REPORT_COUNT, count);
+    return eizo_emulator_item(p, EIZO_EMULATOR_ITEM_FEATURE, 0x02);
+}
+
+static void
+eizo_emulator_build_descriptors(struct eizo_emulator *emu)
+{
+    static const struct {
+        uint8_t report_id;
+        enum eizo_usage usage;
+        uint16_t count;
+    } reports[] = {
+        { EIZO_EMULATOR_RID_DESC,      EIZO_USAGE_SECONDARY_DESCRIPTOR,      516 },
+        { EIZO_EMULATOR_RID_SET,       EIZO_USAGE_SET_VALUE,                 38 },
+        { EIZO_EMULATOR_RID_GET,       EIZO_USAGE_GET_VALUE,                 38 },
+        { EIZO_EMULATOR_RID_SET_V2,    EIZO_USAGE_SET_VALUE_V2,              518 },
+        { EIZO_EMULATOR_RID_GET_V2,    EIZO_USAGE_GET_VALUE_V2,              518 },
+        { EIZO_EMULATOR_RID_COUNTER,   EIZO_USAGE_HANDLE_COUNTER,            2 },
+        { EIZO_EMULATOR_RID_VERIFY,    EIZO_USAGE_VERIFY_LAST_REQUEST,       7 },
+        { EIZO_EMULATOR_RID_SN_PROD,   EIZO_USAGE_SERIAL_PRODUCT_STRING_2,   24 },
+        { EIZO_EMULATOR_RID_KEY_VALUE, EIZO_USAGE_UNKNOWN_KEY_VALUE_PAIRS_2, EIZO_FF300009_MAX_SIZE },
+    };
+
+    uint8_t *p = emu->primary;
+    p = eizo_emulator_item(p, EIZO_EMULATOR_ITEM_USAGE_PAGE, 0xff30);
+    p = eizo_emulator_item(p, EIZO_EMULATOR_ITEM_USAGE, 0x0000);
+    p = eizo_emulator_item(p, EIZO_EMULATOR_ITEM_COLLECTION, 0x01);
+    for (size_t i = 0; i < sizeof(reports) / sizeof(reports[0]); ++i) {
+        p = eizo_emulator_feature(p, reports[i].report_id, reports[i].usage, 0, 255, reports[i].count);
+    }
+    p = eizo_emulator_item(p, EIZO_EMULATOR_ITEM_REPORT_ID, EIZO_EMULATOR_RID_INPUT);
+    p = eizo_emulator_item(p, EIZO_EMULATOR_ITEM_USAGE, EIZO_USAGE_GET_VALUE_V2 & 0xffff);
+    p = eizo_emulator_item(p, EIZO_EMULATOR_ITEM_REPORT_COUNT, 518);
+    p = eizo_emulator_item(p, EIZO_EMULATOR_ITEM_INPUT, 0x02);
+    p = eizo_emulator_item(p, EIZO_EMULATOR_ITEM_END_COLLECTION, 0);
+    emu->primary_len = (size_t)(p - emu->primary);
+
+    p = emu->secondary;
+    for (size_t i = 0; i < EIZO_EMULATOR_N_CONTROLS; ++i) {
+        const struct eizo_emulator_control *c = &eizo_emulator_controls[i];
+        p = eizo_emulator_feature(
+            p, EIZO_EMULATOR_RID_GET, c->usage, c->logical_minimum, c->logical_maximum, c->size);
+    }
+
+    // The filler shares every global item but the page, so each control
+    // only adds a usage and a main item.
+    size_t n = emu->config.extra_controls;
+    for (size_t page = 0; page < EIZO_EMULATOR_EXTRA_PAGES && page < n; ++page) {
+        for (size_t i = page; i < n; i += EIZO_EMULATOR_EXTRA_PAGES) {
+            uint32_t id = 0x100 + (uint32_t)(i / EIZO_EMULATOR_EXTRA_PAGES) * 3;
+            uint32_t usage = (EIZO_EMULATOR_EXTRA_PAGE + (uint32_t)page) << 16 | id;
+            if (i == 0) {
+                p = eizo_emulator_feature(p, EIZO_EMULATOR_RID_GET, usage, 0, 255, 1);
+                continue;
+            }
+            if (i == page) {
+                p = eizo_emulator_item(p, EIZO_EMULATOR_ITEM_USAGE_PAGE, usage >> 16);
+            }
+            p = eizo_emulator_item(p, EIZO_EMULATOR_ITEM_USAGE, usage & 0xffff);
+            p = eizo_emulator_item(p, EIZO_EMULATOR_ITEM_FEATURE, 0x02);
+        }
+    }
+    emu->secondary_len = (size_t)(p - emu->secondary);
+}
+
+// Every profile comes with its own LUTs, linear ones a little dimmer the
+// higher the profile.
+static void
+eizo_emulator_load_luts(struct eizo_emulator *emu, uint8_t profile)
+{
+    for (size_t i = 0; i < 3 * EIZO_EMULATOR_LUT_ENTRIES; ++i) {
+        uint32_t x = (uint32_t)(i % EIZO_EMULATOR_LUT_ENTRIES * 0xffff / (EIZO_EMULATOR_LUT_ENTRIES - 1));
+        x = x * 64 / (64 + profile);
+        emu->lut[0][2 * i] = emu->lut[1][2 * i] = (uint8_t)x;
+        emu->lut[0][2 * i + 1] = emu->lut[1][2 * i + 1] = (uint8_t)(x >> 8);
+    }
+}
+
+static void
+eizo_emulator_init_values(struct eizo_emulator *emu)
+{
+    char serial[9];
+    snprintf(serial, sizeof(serial), "%08lu", emu->config.serial % 100000000);
+
+    for (size_t i = 0; i < EIZO_EMULATOR_N_CONTROLS; ++i) {
+        const struct eizo_emulator_control *c = &eizo_emulator_controls[i];
+        uint8_t *v = emu->values + emu->offsets[i];
+
+        for (size_t k = 0; k < c->size && k < 4; ++k) {
+            v[k] = (uint8_t)(c->initial >> (8 * k));
+        }
+
+        switch (c->usage) {
+            case EIZO_USAGE_FIRMWARE_VERSION:
+                memcpy(v, "1.0.0", 5);
+                break;
+            case EIZO_USAGE_SERIAL_STRING:
+                memcpy(v, serial, 8);
+                break;
+            case EIZO_USAGE_EDID:
+                memcpy(v, "\x00\xff\xff\xff\xff\xff\xff\x00", 8);
+                break;
+            case EIZO_USAGE_COLOR_MATRIX_32:
+                // Identity in 16.16 fixed point.
+                v[2] = v[18] = v[34] = 1;
+                break;
+            default:
+                break;
+        }
+    }
+
+    for (size_t i = 0; i < EIZO_EMULATOR_EEPROM_SIZE; ++i) {
+        emu->eeprom[i] = (uint8_t)(i * 31 + 7);
+    }
+    memcpy(emu->eeprom + EIZO_EEPROM_ADDRESS_SERIAL_STRING, serial, 8);
+    memcpy(emu->eeprom + EIZO_EEPROM_ADDRESS_PRODUCT_STRING_1, emu->product, 8);
+
+    for (size_t i = 0; i < EIZO_EMULATOR_CKL_SIZE; ++i) {
+        emu->ckl[i] = (uint8_t)i;
+    }
+
+    eizo_emulator_load_luts(emu, 0);
+}
+
+static uint8_t *
+eizo_emulator_lut(struct eizo_emulator *emu, uint32_t usage)
+{
+    return emu->lut[usage == EIZO_USAGE_REAR_LUT];
+}
+
+static ssize_t
+eizo_emulator_find(uint32_t usage)
+{
+    for (size_t i = 0; i < EIZO_EMULATOR_N_CONTROLS; ++i) {
+        if (eizo_emulator_controls[i].usage == usage) {
+            return (ssize_t)i;
+        }
+    }
+    return -1;
+}
+
+static void
+eizo_emulator_delay(const struct eizo_emulator *emu)
+{
+    if (emu->config.latency_us == 0) {
+        return;
+    }
+
+    struct timespec ts = {
+        .tv_sec = emu->config.latency_us / 1000000,
+        .tv_nsec = (long)(emu->config.latency_us % 1000000) * 1000,
+    };
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR) {
+    }
+}
+
+static void
+eizo_emulator_advance_eeprom(struct eizo_emulator *emu)
+{
+    if (emu->config.eeprom_autoincrement) {
+        emu->eeprom_address = (emu->eeprom_address + 1) % EIZO_EMULATOR_EEPROM_SIZE;
+    }
+}
+
+// Handle the set half of a get request, the value is latched into the
+// response until the matching get report is read. arg is the value sent
+// along with the request.
+static void
+eizo_emulator_prepare_get(struct eizo_emulator *emu, size_t idx, const uint8_t *arg)
+{
+    const struct eizo_emulator_control *c = &eizo_emulator_controls[idx];
+    uint8_t *v = emu->values + emu->offsets[idx];
+
+    memset(emu->response, 0, sizeof(emu->response));
+
+    switch (c->usage) {
+        case EIZO_USAGE_EEPROM_DATA:
+            emu->response[0] = emu->eeprom[emu->eeprom_address];
+            eizo_emulator_advance_eeprom(emu);
+            break;
+
+        case EIZO_USAGE_EV_AVAILABLE_CUSTOM_KEY_LOCK_OFFSET_SIZE:
+            emu->response[0] = (uint8_t)emu->ckl_offset;
+            emu->response[1] = (uint8_t)(emu->ckl_offset >> 8);
+            emu->response[2] = (uint8_t)EIZO_EMULATOR_CKL_SIZE;
+            emu->response[3] = (uint8_t)(EIZO_EMULATOR_CKL_SIZE >> 8);
+            break;
+
+        case EIZO_USAGE_EV_AVAILABLE_CUSTOM_KEY_LOCK_DATA: {
+            uint16_t off = emu->ckl_offset;
+            emu->response[0] = (uint8_t)off;
+            emu->response[1] = (uint8_t)(off >> 8);
+            if (off < EIZO_EMULATOR_CKL_SIZE) {
+                size_t n = EIZO_EMULATOR_CKL_SIZE - off;
+                if (n > EIZO_EMULATOR_CKL_PAGE) {
+                    n = EIZO_EMULATOR_CKL_PAGE;
+                }
+                memcpy(emu->response + 2, emu->ckl + off, n);
+            }
+            emu->ckl_offset = off + EIZO_EMULATOR_CKL_PAGE;
+            break;
+        }
+
+        case EIZO_USAGE_FRONT_LUT:
+        case EIZO_USAGE_REAR_LUT: {
+            // Self addressed, the request carries the offset.
+            uint16_t off = arg[0] | arg[1] << 8;
+            emu->response[0] = arg[0];
+            emu->response[1] = arg[1];
+            if (off < EIZO_EMULATOR_LUT_SIZE) {
+                size_t n = EIZO_EMULATOR_LUT_SIZE - off;
+                if (n > EIZO_EMULATOR_LUT_PAGE) {
+                    n = EIZO_EMULATOR_LUT_PAGE;
+                }
+                memcpy(emu->response + 2, eizo_emulator_lut(emu, c->usage) + off, n);
+            }
+            break;
+        }
+
+        default:
+            memcpy(emu->response, v, c->size);
+            break;
+    }
+}
+
+static uint8_t
+eizo_emulator_apply_set(struct eizo_emulator *emu, size_t idx, const uint8_t *value, size_t len)
+{
+    const struct eizo_emulator_control *c = &eizo_emulator_controls[idx];
+    uint8_t *v = emu->values + emu->offsets[idx];
+
+    if (len > c->size) {
+        len = c->size;
+    }
+
+    switch (c->usage) {
+        case EIZO_USAGE_EEPROM_ADDRESS:
+            emu->eeprom_address = (value[0] | value[1] << 8) % EIZO_EMULATOR_EEPROM_SIZE;
+            break;
+
+        case EIZO_USAGE_EEPROM_DATA:
+            emu->eeprom[emu->eeprom_address] = value[0];
+            eizo_emulator_advance_eeprom(emu);
+            return 0;
+
+        case EIZO_USAGE_EV_AVAILABLE_CUSTOM_KEY_LOCK_OFFSET_SIZE:
+            emu->ckl_offset = value[0] | value[1] << 8;
+            return 0;
+
+        case EIZO_USAGE_FRONT_LUT:
+        case EIZO_USAGE_REAR_LUT: {
+            uint16_t off = value[0] | value[1] << 8;
+            if (off >= EIZO_EMULATOR_LUT_SIZE) {
+                return 1;
+            }
+            size_t n = EIZO_EMULATOR_LUT_SIZE - off;
+            if (n > EIZO_EMULATOR_LUT_PAGE) {
+                n = EIZO_EMULATOR_LUT_PAGE;
+            }
+            memcpy(eizo_emulator_lut(emu, c->usage) + off, value + 2, n);
+            return 0;
+        }
+
+        case EIZO_USAGE_EV_AVAILABLE_CUSTOM_KEY_LOCK_DATA:
+        case EIZO_USAGE_FIRMWARE_VERSION:
+        case EIZO_USAGE_SERIAL_STRING:
+        case EIZO_USAGE_USAGE_TIME:
+        case EIZO_USAGE_TEMPERATURE_1:
+            // Read only.
+            return 1;
+
+        default:
+            break;
+    }
+
+    // Reject values outside of the logical range, like the monitor does.
+    if (c->size <= 2) {
+        int32_t x = value[0];
+        if (c->size == 2) {
+            x |= value[1] << 8;
+        } else if (c->logical_minimum < 0) {
+            x = (int8_t)value[0];
+        }
+        if (x < c->logical_minimum || x > c->logical_maximum) {
+            return 1;
+        }
+    }
+
+    memcpy(v, value, len);
+    if (c->usage == EIZO_USAGE_PROFILE) {
+        eizo_emulator_load_luts(emu, v[0]);
+    }
+    return 0;
+}
+
+// Called with the lock held for every feature report request.
+static void
+eizo_emulator_count_request(struct eizo_emulator *emu)
+{
+    if (++emu->requests == emu->race_at) {
+        ++emu->counter;
+        emu->race_at = 0;
+    }
+}
+
+static void
+eizo_emulator_request(struct eizo_emulator *emu, const struct eizo_value_report *r, size_t len, bool set)
+{
+    uint32_t usage = eizo_swap_usage(r->usage);
+    ssize_t idx = eizo_emulator_find(usage);
+
+    emu->last_usage = usage;
+    if (le16toh(r->counter) != emu->counter || idx < 0) {
+        emu->last_result = 1;
+        memset(emu->response, 0, sizeof(emu->response));
+        return;
+    }
+
+    if (set) {
+        emu->last_result = eizo_emulator_apply_set(
+            emu, (size_t)idx, r->value, len - offsetof(struct eizo_value_report, value));
+    } else {
+        eizo_emulator_prepare_get(emu, (size_t)idx, r->value);
+        emu->last_result = 0;
+    }
+}
+
+static int
+eizo_emulator_get_feature(struct eizo_transport *t, void *buf, size_t len)
+{
+    struct eizo_emulator_client *client = t->data;
+    struct eizo_emulator *emu = client->emulator;
+    uint8_t *p = buf;
+
+    if (len == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pthread_mutex_lock(&emu->lock);
+    eizo_emulator_count_request(emu);
+    eizo_emulator_delay(emu);
+
+    union {
+        uint8_t buf[sizeof(struct eizo_value_report)];
+        struct eizo_descriptor_report desc;
+        struct eizo_value_report value;
+        struct eizo_counter_report counter;
+        struct eizo_verify_report verify;
+    } u = {};
+    u.buf[0] = p[0];
+
+    size_t n = 0;
+    switch (p[0]) {
+        case EIZO_EMULATOR_RID_DESC: {
+            u.desc.offset = htole16((uint16_t)emu->desc_pos);
+            u.desc.length = htole16((uint16_t)emu->secondary_len);
+            if (emu->desc_pos < emu->secondary_len) {
+                size_t cpy = emu->secondary_len - emu->desc_pos;
+                memcpy(u.desc.desc, emu->secondary + emu->desc_pos, cpy > 512 ? 512 : cpy);
+            }
+            emu->desc_pos += 512;
+            n = sizeof(u.desc);
+            break;
+        }
+
+        case EIZO_EMULATOR_RID_COUNTER:
+            // Every client that asks for a counter gets a new one, which
+            // invalidates the counter of everyone else.
+            u.counter.counter = htole16(++emu->counter);
+            n = sizeof(u.counter);
+            break;
+
+        case EIZO_EMULATOR_RID_VERIFY:
+            u.verify.usage = eizo_swap_usage(emu->last_usage);
+            u.verify.counter = htole16(emu->counter);
+            u.verify.result = emu->last_result;
+            n = sizeof(u.verify);
+            break;
+
+        case EIZO_EMULATOR_RID_SN_PROD:
+            snprintf((char *)u.buf + 1, 9, "%08lu", emu->config.serial % 100000000);
+            memcpy(u.buf + 9, emu->product, 16);
+            n = 25;
+            break;
+
+        case EIZO_EMULATOR_RID_KEY_VALUE:
+            u.buf[1] = EIZO_FF300009_KEY_END;
+            n = 2;
+            break;
+
+        case EIZO_EMULATOR_RID_GET:
+        case EIZO_EMULATOR_RID_GET_V2:
+            u.value.usage = eizo_swap_usage(emu->last_usage);
+            u.value.counter = htole16(emu->counter);
+            n = p[0] == EIZO_EMULATOR_RID_GET ? 39 : 519;
+            memcpy(u.value.value, emu->response, n - offsetof(struct eizo_value_report, value));
+            break;
+
+        default:
+            break;
+    }
+
+    pthread_mutex_unlock(&emu->lock);
+
+    if (n == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (n > len) {
+        n = len;
+    }
+    memcpy(buf, u.buf, n);
+    return (int)n;
+}
+
+static int
+eizo_emulator_set_feature(struct eizo_transport *t, const void *buf, size_t len)
+{
+    struct eizo_emulator_client *client = t->data;
+    struct eizo_emulator *emu = client->emulator;
+    const uint8_t *p = buf;
+
+    if (len == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct eizo_value_report r = {};
+    memcpy(&r, buf, len < sizeof(r) ? len : sizeof(r));
+
+    int res = (int)len;
+
+    pthread_mutex_lock(&emu->lock);
+    eizo_emulator_count_request(emu);
+    eizo_emulator_delay(emu);
+
+    switch (p[0]) {
+        case EIZO_EMULATOR_RID_DESC:
+            emu->desc_pos = 0;
+            break;
+
+        case EIZO_EMULATOR_RID_GET:
+        case EIZO_EMULATOR_RID_GET_V2:
+        case EIZO_EMULATOR_RID_SET:
+        case EIZO_EMULATOR_RID_SET_V2:
+            if (len < offsetof(struct eizo_value_report, value)) {
+                errno = EINVAL;
+                res = -1;
+                break;
+            }
+            eizo_emulator_request(
+                emu, &r, len,
+                p[0] == EIZO_EMULATOR_RID_SET || p[0] == EIZO_EMULATOR_RID_SET_V2);
+            break;
+
+        default:
+            errno = EINVAL;
+            res = -1;
+            break;
+    }
+
+    pthread_mutex_unlock(&emu->lock);
+    return res;
+}
+
+static ssize_t
+eizo_emulator_read(struct eizo_transport *t, void *buf, size_t len)
+{
+    return recv(t->fd, buf, len, MSG_DONTWAIT);
+}
+
+static int
+eizo_emulator_get_devinfo(struct eizo_transport *t, uint16_t *vendor, uint16_t *product)
+{
+    struct eizo_emulator_client *client = t->data;
+
+    *vendor = EIZO_VID;
+    *product = client->emulator->config.pid;
+    return 0;
+}
+
+static int
+eizo_emulator_get_report_descriptor(struct eizo_transport *t, uint8_t *buf, size_t *len)
+{
+    struct eizo_emulator_client *client = t->data;
+    struct eizo_emulator *emu = client->emulator;
+
+    if (emu->primary_len > *len) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memcpy(buf, emu->primary, emu->primary_len);
+    *len = emu->primary_len;
+    return 0;
+}
+
+static void
+eizo_emulator_close(struct eizo_transport *t)
+{
+    struct eizo_emulator_client *client = t->data;
+    struct eizo_emulator *emu = client->emulator;
+
+    pthread_mutex_lock(&emu->lock);
+    for (struct eizo_emulator_client **pp = &emu->clients; *pp; pp = &(*pp)->next) {
+        if (*pp == client) {
+            *pp = client->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&emu->lock);
+
+    close(client->peer);
+    close(t->fd);
+    free(client);
+}
+
+static const struct eizo_transport_ops eizo_emulator_ops = {
+    .get_feature = eizo_emulator_get_feature,
+    .set_feature = eizo_emulator_set_feature,
+    .read = eizo_emulator_read,
+    .get_devinfo = eizo_emulator_get_devinfo,
+    .get_report_descriptor = eizo_emulator_get_report_descriptor,
+    .close = eizo_emulator_close,
+};
+
+enum eizo_result
+eizo_emulator_new(const struct eizo_emulator_config *config, struct eizo_emulator **emulator)
+{
+    if (config->extra_controls > EIZO_EMULATOR_MAX_EXTRA_CONTROLS) {
+        return EIZO_ERROR_INVALID_ARGUMENT;
+    }
+
+    struct eizo_emulator *emu = calloc(1, sizeof(*emu));
+    if (!emu) {
+        return EIZO_ERROR_NO_MEMORY;
+    }
+
+    size_t total = 0;
+    for (size_t i = 0; i < EIZO_EMULATOR_N_CONTROLS; ++i) {
+        emu->offsets[i] = total;
+        total += eizo_emulator_controls[i].size;
+    }
+
+    emu->values = calloc(total, 1);
+    if (!emu->values) {
+        free(emu);
+        return EIZO_ERROR_NO_MEMORY;
+    }
+
+    emu->config = *config;
+    emu->config.product = nullptr;
+    if (config->product) {
+        strncpy(emu->product, config->product, 16);
+    }
+    pthread_mutex_init(&emu->lock, nullptr);
+
+    eizo_emulator_build_descriptors(emu);
+    eizo_emulator_init_values(emu);
+
+    *emulator = emu;
+    return EIZO_SUCCESS;
+}
+
+void
+eizo_emulator_free(struct eizo_emulator *emulator)
+{
+    if (emulator->clients) {
+        eizo_log_warning("emulator still has open handles.");
+    }
+
+    pthread_mutex_destroy(&emulator->lock);
+    free(emulator->values);
+    free(emulator);
+}
+
+enum eizo_result
+eizo_emulator_open(struct eizo_emulator *emulator, enum eizo_open_flags flags, struct eizo_handle **handle)
+{
+    struct eizo_emulator_client *client = calloc(1, sizeof(*client));
+    if (!client) {
+        return EIZO_ERROR_NO_MEMORY;
+    }
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0) {
+        free(client);
+        return EIZO_ERROR_IO;
+    }
+
+    client->emulator = emulator;
+    client->peer = fds[1];
+
+    pthread_mutex_lock(&emulator->lock);
+    client->next = emulator->clients;
+    emulator->clients = client;
+    pthread_mutex_unlock(&emulator->lock);
+
+    struct eizo_transport t = {
+        .ops = &eizo_emulator_ops,
+        .data = client,
+        .fd = fds[0],
+    };
+    return eizo_new_transport(&t, flags, handle);
+}
+
+enum eizo_result
+eizo_emulator_set_value(struct eizo_emulator *emulator, uint32_t usage, const uint8_t *value, size_t len)
+{
+    ssize_t idx = eizo_emulator_find(usage);
+    if (idx < 0) {
+        return EIZO_ERROR_INVALID_USAGE;
+    }
+
+    const struct eizo_emulator_control *c = &eizo_emulator_controls[idx];
+    if (len > c->size) {
+        return EIZO_ERROR_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&emulator->lock);
+
+    uint8_t *v = emulator->values + emulator->offsets[idx];
+    memcpy(v, value, len);
+    if (usage == EIZO_USAGE_PROFILE) {
+        eizo_emulator_load_luts(emulator, v[0]);
+    }
+
+    struct eizo_value_report r = {};
+    r.report_id = EIZO_EMULATOR_RID_INPUT;
+    r.usage = eizo_swap_usage(usage);
+    r.counter = htole16(emulator->counter);
+    memcpy(r.value, v, c->size);
+
+    size_t n = offsetof(struct eizo_value_report, value) + c->size;
+    for (struct eizo_emulator_client *client = emulator->clients; client; client = client->next) {
+        // A client that does not keep up with its input reports loses them,
+        // just like with a full hidraw queue.
+        send(client->peer, &r, n, MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+
+    pthread_mutex_unlock(&emulator->lock);
+    return EIZO_SUCCESS;
+}
+
+void
+eizo_emulator_bump_counter(struct eizo_emulator *emulator)
+{
+    pthread_mutex_lock(&emulator->lock);
+    ++emulator->counter;
+    pthread_mutex_unlock(&emulator->lock);
+}
+
+void
+eizo_emulator_bump_counter_after(struct eizo_emulator *emulator, uint64_t requests)
+{
+    pthread_mutex_lock(&emulator->lock);
+    emulator->race_at = requests ? emulator->requests + requests : 0;
+    pthread_mutex_unlock(&emulator->lock);
+}
+
+uint64_t
+eizo_emulator_get_request_count(struct eizo_emulator *emulator)
+{
+    pthread_mutex_lock(&emulator->lock);
+    uint64_t n = emulator->requests;
+    pthread_mutex_unlock(&emulator->lock);
+    return n;
+}
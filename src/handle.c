@@ -3,26 +3,133 @@
 #include <memory.h>
 #include <errno.h>
 
-#include <sys/ioctl.h>
 #include <sys/param.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <locale.h>
 #include <ctype.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include <linux/hidraw.h>
 
 #include "eizo/handle.h"
+#include "eizo/log.h"
 #include "internal.h"
 
+// A cached short report value. Only values that fit the 39 byte report
+// are cached, which covers every setting worth polling.
+struct eizo_cached_value {
+    uint64_t expires;
+    uint32_t ttl;
+    // value_generation of the handle when the value was requested.
+    unsigned generation;
+    bool valid;
+    uint8_t value[32];
+};
+
+constexpr size_t EIZO_MAX_PENDING_SETS = 16;
+
+// A value requested for a usage that has not been written yet.
+struct eizo_pending_set {
+    enum eizo_usage usage;
+    size_t len;
+    uint8_t value[32];
+};
+
+// A request waiting for the I/O thread, it lives on the stack of the
+// thread that issued it until done is set.
+struct eizo_io_job {
+    struct eizo_io_job *next;
+    eizo_io_fn fn;
+    void *arg;
+    enum eizo_result res;
+    bool done;
+};
+
+// struct eizo_op_stats, updated from any thread.
+struct eizo_op_counters {
+    _Atomic uint64_t count;
+    _Atomic uint64_t total_ns;
+    _Atomic uint64_t latency[EIZO_STATS_LATENCY_BUCKETS];
+    _Atomic uint64_t results[EIZO_STATS_RESULTS];
+};
+
+struct eizo_value_listener {
+    enum eizo_usage usage;
+    eizo_value_callback cb;
+    void *userdata;
+};
+
 struct eizo_handle {
-    int fd;
+    struct eizo_transport transport;
+    enum eizo_open_flags flags;
     uint16_t counter;
     enum eizo_pid pid;
     unsigned long serial;
     char product[17];
-    struct eizo_control *ctrl;
-    size_t n_ctrl;
+    struct eizo_controls *ctrl;
+    struct eizo_cache_map cache;
+    // Set once product and ctrl are loaded, which happens on the I/O
+    // thread or under the io lock, so others may check them without it.
+    atomic_bool have_product;
+    atomic_bool have_controls;
+    struct eizo_cached_value *values;
+    // Bumped for every input report, which makes the cached values from
+    // before stale without waiting for the io lock.
+    atomic_uint value_generation;
+    pthread_mutex_t io_lock;
+    struct {
+        pthread_t thread;
+        pthread_mutex_t lock;
+        pthread_cond_t cond;
+        // Signalled whenever a write is done.
+        pthread_cond_t idle;
+        bool running;
+        bool stop;
+        // The thread is writing a value it took off the queue.
+        bool busy;
+        // In the order they go out.
+        size_t n;
+        struct eizo_pending_set pending[EIZO_MAX_PENDING_SETS];
+        eizo_set_callback cb;
+        void *userdata;
+    } coalesce;
+    struct {
+        pthread_t thread;
+        pthread_mutex_t lock;
+        pthread_cond_t cond;
+        pthread_cond_t done;
+        bool running;
+        bool stop;
+        // One queue per enum eizo_io_kind, each in order of arrival.
+        struct eizo_io_job *head[2];
+        struct eizo_io_job **tail[2];
+    } worker;
+    struct {
+        pthread_mutex_t lock;
+        struct eizo_value_listener *list;
+        size_t n;
+        // While dispatching, removed entries only lose their cb so the
+        // indices of the others stay put. They are dropped afterwards.
+        unsigned dispatching;
+        bool dead;
+    } listeners;
+    struct eizo_lut_shadow *lut[2];
+    struct {
+        enum eizo_retry_flags flags;
+        unsigned max;
+    } retry;
+    struct {
+        struct eizo_op_counters op[EIZO_STATS_OPS];
+        _Atomic uint64_t get_feature;
+        _Atomic uint64_t set_feature;
+        _Atomic uint64_t read;
+        _Atomic uint64_t bytes_short;
+        _Atomic uint64_t bytes_long;
+        _Atomic uint64_t bytes_other;
+    } stats;
     struct {
         uint8_t desc;
         uint8_t set[2];
@@ -34,40 +141,168 @@ struct eizo_handle {
     } rid;
 };
 
-static int
-eizo_control_compare_by_usage(const void *a, const void *b)
+static enum eizo_result
+eizo_ensure_controls(struct eizo_handle *handle);
+
+static inline void
+eizo_stats_add(_Atomic uint64_t *counter, uint64_t n)
+{
+    atomic_fetch_add_explicit(counter, n, memory_order_relaxed);
+}
+
+static uint64_t
+eizo_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+// Account for a call of op that started at start and returned res.
+static void
+eizo_stats_record(struct eizo_handle *handle, enum eizo_stats_op op, uint64_t start, enum eizo_result res)
 {
-    const struct eizo_control *c1 = a, *c2 = b;
-    if (c1->usage > c2->usage) {
-        return 1;
+    struct eizo_op_counters *c = &handle->stats.op[op];
+    uint64_t ns = eizo_now_ns() - start;
+    uint64_t us = ns / 1000;
+
+    size_t bucket = us ? (size_t)(64 - __builtin_clzll(us)) : 0;
+    if (bucket >= EIZO_STATS_LATENCY_BUCKETS) {
+        bucket = EIZO_STATS_LATENCY_BUCKETS - 1;
+    }
+
+    int result = res - EIZO_STATS_RESULT_MIN;
+    if (result < 0 || result >= (int)EIZO_STATS_RESULTS) {
+        result = EIZO_ERROR_UNKNOWN - EIZO_STATS_RESULT_MIN;
     }
-    if (c1->usage < c2->usage) {
-        return -1;
+
+    eizo_stats_add(&c->count, 1);
+    eizo_stats_add(&c->total_ns, ns);
+    eizo_stats_add(&c->latency[bucket], 1);
+    eizo_stats_add(&c->results[result], 1);
+}
+
+static void
+eizo_stats_add_bytes(struct eizo_handle *handle, size_t len)
+{
+    switch (len) {
+        case 39:
+            eizo_stats_add(&handle->stats.bytes_short, len);
+            break;
+        case 519:
+            eizo_stats_add(&handle->stats.bytes_long, len);
+            break;
+        default:
+            eizo_stats_add(&handle->stats.bytes_other, len);
+            break;
     }
-    return 0;
+}
+
+static inline int
+eizo_get_feature(struct eizo_handle *handle, void *buf, size_t len)
+{
+    eizo_stats_add(&handle->stats.get_feature, 1);
+    eizo_stats_add_bytes(handle, len);
+    return handle->transport.ops->get_feature(&handle->transport, buf, len);
+}
+
+static inline int
+eizo_set_feature(struct eizo_handle *handle, const void *buf, size_t len)
+{
+    eizo_stats_add(&handle->stats.set_feature, 1);
+    eizo_stats_add_bytes(handle, len);
+    return handle->transport.ops->set_feature(&handle->transport, buf, len);
 }
 
 size_t
-eizo_get_controls(const struct eizo_handle *handle, const struct eizo_control **ctrl)
+eizo_get_controls(struct eizo_handle *handle, const struct eizo_control_table **table)
+{
+    if (eizo_ensure_controls(handle) < EIZO_SUCCESS) {
+        if (table) {
+            *table = nullptr;
+        }
+        return 0;
+    }
+
+    if (table) {
+        *table = &handle->ctrl->table;
+    }
+    return handle->ctrl->table.n;
+}
+
+static size_t
+eizo_control_search(const enum eizo_usage *usages, size_t n, enum eizo_usage usage)
+{
+    size_t lo = 0;
+    size_t hi = n;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (usages[mid] < usage) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < n && usages[lo] == usage ? lo : SIZE_MAX;
+}
+
+// Position of usage in the table of ctrl, or SIZE_MAX.
+static size_t
+eizo_control_index_lookup(const struct eizo_controls *ctrl, enum eizo_usage usage)
+{
+    const struct eizo_control_index *index = &ctrl->index;
+    if (!index->slots) {
+        return eizo_control_search(ctrl->table.usage, ctrl->table.n, usage);
+    }
+
+    // Pages outside of the map share keys with the ones inside.
+    uint32_t page = usage >> 16;
+    uint8_t k = index->page_map[eizo_control_page_key(page)];
+    if (k == 0 || index->pages[k - 1].page != page) {
+        return SIZE_MAX;
+    }
+
+    const struct eizo_control_page *p = &index->pages[k - 1];
+    uint32_t off = (usage & 0xffff) - p->first;
+    if (off >= p->span || p->slot[off] == 0) {
+        return SIZE_MAX;
+    }
+    return p->slot[off] - 1;
+}
+
+// Position of usage in the control table, or SIZE_MAX. Loads the controls
+// of a lazy handle.
+static size_t
+eizo_control_lookup(struct eizo_handle *handle, enum eizo_usage usage)
+{
+    if (eizo_ensure_controls(handle) < EIZO_SUCCESS) {
+        return SIZE_MAX;
+    }
+    return eizo_control_index_lookup(handle->ctrl, usage);
+}
+
+bool
+eizo_control_find(struct eizo_handle *handle, enum eizo_usage usage, struct eizo_control *ctrl)
 {
+    size_t i = eizo_control_lookup(handle, usage);
+    if (i == SIZE_MAX) {
+        return false;
+    }
+
     if (ctrl) {
-        *ctrl = handle->ctrl;
+        *ctrl = eizo_control_get(&handle->ctrl->table, i);
     }
-    return handle->n_ctrl;
+    return true;
 }
 
-const struct eizo_control *
-eizo_control_find(const struct eizo_handle *handle, enum eizo_usage usage)
+size_t
+eizo_get_value_size(struct eizo_handle *handle, uint32_t usage)
 {
-    struct eizo_control key = {
-        .usage = usage,
-    };
-    return bsearch(
-        &key,
-        handle->ctrl,
-        handle->n_ctrl,
-        sizeof(struct eizo_control),
-        eizo_control_compare_by_usage);
+    struct eizo_control ctrl;
+    if (!eizo_control_find(handle, usage, &ctrl)) {
+        return 0;
+    }
+    return eizo_control_size(&ctrl);
 }
 
 static enum eizo_result
@@ -76,7 +311,7 @@ eizo_get_counter(struct eizo_handle *handle, uint16_t *counter)
     struct eizo_counter_report r = {};
     r.report_id = handle->rid.counter;
 
-    int res = ioctl(handle->fd, HIDIOCGFEATURE(3), &r);
+    int res = eizo_get_feature(handle, &r, 3);
     if (res < 0) {
         return EIZO_ERROR_IO;
     }
@@ -91,7 +326,7 @@ eizo_get_serial_product(struct eizo_handle *handle, unsigned long *serial, char
     char buf[25];
     buf[0] = (char)handle->rid.sn_prod;
 
-    int res = ioctl(handle->fd, HIDIOCGFEATURE(25), buf);
+    int res = eizo_get_feature(handle, buf, 25);
     if (res < 0) {
         return EIZO_ERROR_IO;
     }
@@ -114,26 +349,46 @@ eizo_get_serial_product(struct eizo_handle *handle, unsigned long *serial, char
     if (end == buf + 9) {
         *serial = sn;
     } else {
-        fprintf(stderr, "%s: failed to convert serial string to ulong.\n", __func__);
+        eizo_log_warning("failed to convert serial string to ulong.");
     }
 
+    atomic_store_explicit(&handle->have_product, true, memory_order_release);
     return EIZO_SUCCESS;
 }
 
-enum eizo_result
-eizo_get_secondary_descriptor(struct eizo_handle *handle, uint8_t *dst, size_t *size)
+static enum eizo_result
+eizo_load_product_job(struct eizo_handle *handle, void *)
+{
+    // Another request may have loaded it in the meantime.
+    if (atomic_load_explicit(&handle->have_product, memory_order_relaxed)) {
+        return EIZO_SUCCESS;
+    }
+    return eizo_get_serial_product(handle, &handle->serial, handle->product);
+}
+
+static enum eizo_result
+eizo_ensure_product(struct eizo_handle *handle)
+{
+    if (atomic_load_explicit(&handle->have_product, memory_order_acquire)) {
+        return EIZO_SUCCESS;
+    }
+    return eizo_io_run(handle, EIZO_IO_SHORT, eizo_load_product_job, nullptr);
+}
+
+static enum eizo_result
+eizo_read_secondary_descriptor(struct eizo_handle *handle, uint8_t *dst, size_t *size)
 {
     struct eizo_descriptor_report r = {};
     r.report_id = handle->rid.desc;
 
-    int rc = ioctl(handle->fd, HIDIOCSFEATURE(517), &r);
+    int rc = eizo_set_feature(handle, &r, 517);
     if (rc < 0) {
         return EIZO_ERROR_IO;
     }
 
     size_t desc_len = 0, pos = 0;
     do {
-        rc = ioctl(handle->fd, HIDIOCGFEATURE(517), &r);
+        rc = eizo_get_feature(handle, &r, 517);
         if (rc < 0) {
             return EIZO_ERROR_IO;
         }
@@ -142,18 +397,18 @@ eizo_get_secondary_descriptor(struct eizo_handle *handle, uint8_t *dst, size_t *
         size_t len    = le16toh(r.length);
 
         if (offset != pos) {
-            fprintf(stderr, "%s: Invalid offset %zu != %zu.\n", __func__, offset, pos);
+            eizo_log_error("Invalid offset %zu != %zu.", offset, pos);
             return EIZO_ERROR_BAD_DATA;
         }
 
         if (desc_len == 0) {
             if (len > HID_MAX_DESCRIPTOR_SIZE || len == 0) {
-                fprintf(stderr, "%s: Invalid descriptor size %zu.\n", __func__, len);
+                eizo_log_error("Invalid descriptor size %zu.", len);
                 return EIZO_ERROR_BAD_DATA;
             }
             desc_len = len;
         } else if (desc_len != len) {
-            fprintf(stderr, "%s: Invalid length %zu at position %zu.\n", __func__, len, pos);
+            eizo_log_error("Invalid length %zu at position %zu.", len, pos);
             return EIZO_ERROR_BAD_DATA;
         }
 
@@ -170,13 +425,24 @@ eizo_get_secondary_descriptor(struct eizo_handle *handle, uint8_t *dst, size_t *
     return EIZO_SUCCESS;
 }
 
+enum eizo_result
+eizo_get_secondary_descriptor(struct eizo_handle *handle, uint8_t *dst, size_t *size)
+{
+    EIZO_TRACE(get_secondary_descriptor_start, 0, handle->rid.desc, handle->counter, 0, 0);
+    enum eizo_result res = eizo_read_secondary_descriptor(handle, dst, size);
+    EIZO_TRACE(
+        get_secondary_descriptor_end, 0, handle->rid.desc, handle->counter,
+        res >= EIZO_SUCCESS ? *size : 0, res);
+    return res;
+}
+
 static enum eizo_result
-eizo_verify(struct eizo_handle *handle, enum eizo_usage usage)
+eizo_verify_report(struct eizo_handle *handle, enum eizo_usage usage)
 {
     struct eizo_verify_report r = {};
     r.report_id = handle->rid.verify;
 
-    int rc = ioctl(handle->fd, HIDIOCGFEATURE(8), &r);
+    int rc = eizo_get_feature(handle, &r, 8);
     if (rc < 0) {
         return EIZO_ERROR_IO;
     }
@@ -196,278 +462,1083 @@ eizo_verify(struct eizo_handle *handle, enum eizo_usage usage)
     return EIZO_SUCCESS;
 }
 
-enum eizo_result
-eizo_get_value(struct eizo_handle *handle, enum eizo_usage usage, uint8_t *value, size_t len)
+static enum eizo_result
+eizo_verify(struct eizo_handle *handle, enum eizo_usage usage)
 {
-    const struct eizo_control *ctrl = eizo_control_find(handle, usage);
-    if (!ctrl) {
-        fprintf(stderr, "%s: monitor does not support usage %08w32x\n", __func__, usage);
-        return EIZO_ERROR_INVALID_USAGE;
-    }
+    EIZO_TRACE(verify_start, usage, handle->rid.verify, handle->counter, 8, 0);
+    uint64_t start = eizo_now_ns();
+    enum eizo_result res = eizo_verify_report(handle, usage);
+    eizo_stats_record(handle, EIZO_STATS_VERIFY, start, res);
+    EIZO_TRACE(verify_end, usage, handle->rid.verify, handle->counter, 8, res);
+    return res;
+}
 
-    struct eizo_value_report r = {};
+// Issue a get request for usage through r and verify it. The first
+// arg_len bytes of r->value are sent along with the request, some usages
+// take e.g. an offset that way. On success the first len bytes of r->value
+// hold the value.
+enum eizo_result
+eizo_query_report(
+    struct eizo_handle *handle,
+    struct eizo_value_report *r,
+    enum eizo_usage usage,
+    size_t len,
+    size_t arg_len)
+{
     unsigned long cap;
 
     if (len <= 32) {
-        r.report_id = handle->rid.get[0];
+        r->report_id = handle->rid.get[0];
         cap = 39;
     } else if (len <= 512) {
-        r.report_id = handle->rid.get[1];
+        r->report_id = handle->rid.get[1];
         cap = 519;
     } else {
         return EIZO_ERROR_INVALID_ARGUMENT;
     }
 
-    r.usage = eizo_swap_usage(usage);
-    r.counter = htole16(handle->counter);
-
-    int rc = ioctl(handle->fd, HIDIOCSFEATURE(cap), &r);
-    if (rc < 0) {
-        return EIZO_ERROR_IO;
+    size_t value_len = cap - offsetof(struct eizo_value_report, value);
+    if (arg_len > value_len) {
+        return EIZO_ERROR_INVALID_ARGUMENT;
     }
 
-    rc = ioctl(handle->fd, HIDIOCGFEATURE(cap), &r);
-    if (rc < 0) {
-        return EIZO_ERROR_IO;
-    }
+    r->usage = eizo_swap_usage(usage);
+    r->counter = htole16(handle->counter);
+    memset(r->value + arg_len, 0, value_len - arg_len);
 
-    enum eizo_result res = eizo_verify(handle, usage);
-    if (res >= EIZO_SUCCESS) {
-        memcpy(value, r.value, len);
+    // Every get goes through here, single, batched, raw or as part of a
+    // transfer, so this is where it is traced.
+    EIZO_TRACE(get_value_start, usage, r->report_id, handle->counter, len, 0);
+
+    enum eizo_result res = EIZO_ERROR_IO;
+    if (eizo_set_feature(handle, r, cap) >= 0 && eizo_get_feature(handle, r, cap) >= 0) {
+        res = eizo_verify(handle, usage);
     }
+
+    EIZO_TRACE(get_value_end, usage, r->report_id, handle->counter, len, res);
     return res;
 }
 
+// Plain get request without arguments, r only needs to be valid memory
+// and holds the value afterwards.
 enum eizo_result
-eizo_set_value(struct eizo_handle *handle, enum eizo_usage usage, uint8_t *value, size_t len)
+eizo_get_report(struct eizo_handle *handle, struct eizo_value_report *r, enum eizo_usage usage, size_t len)
 {
-    const struct eizo_control *ctrl = eizo_control_find(handle, usage);
-    if (!ctrl) {
-        fprintf(stderr, "%s: monitor does not support usage %08w32x\n", __func__, usage);
-        return EIZO_ERROR_INVALID_USAGE;
-    }
-
-    struct eizo_value_report r = {};
-    unsigned long cap;
+    return eizo_query_report(handle, r, usage, len, 0);
+}
 
-    if (len <= 32) {
-        r.report_id = handle->rid.set[0];
-        cap = 39;
-    } else if (len <= 512) {
-        r.report_id = handle->rid.set[1];
-        cap = 519;
-    } else {
-        return EIZO_ERROR_INVALID_ARGUMENT;
+// Decide whether a request that failed with res is sent again. After a
+// race the counter is reacquired in any case, so that only this request
+// pays for it.
+static bool
+eizo_retry(struct eizo_handle *handle, enum eizo_result res, enum eizo_retry_flags kind, unsigned *attempt)
+{
+    if (res != EIZO_ERROR_RACE_CONDITION || eizo_refresh_counter(handle) < EIZO_SUCCESS) {
+        return false;
     }
 
-    r.usage = eizo_swap_usage(usage);
-    r.counter = htole16(handle->counter);
-    memcpy(r.value, value, len);
+    return (handle->retry.flags & kind) && (*attempt)++ < handle->retry.max;
+}
 
-    int rc = ioctl(handle->fd, HIDIOCSFEATURE(cap), &r);
-    if (rc < 0) {
-        return EIZO_ERROR_IO;
-    }
+static enum eizo_result
+eizo_get_value_unchecked(struct eizo_handle *handle, enum eizo_usage usage, uint8_t *value, size_t len)
+{
+    struct eizo_value_report r;
+    enum eizo_result res;
+    unsigned attempt = 0;
+    do {
+        res = eizo_get_report(handle, &r, usage, len);
+    } while (res < EIZO_SUCCESS && eizo_retry(handle, res, EIZO_RETRY_GETS, &attempt));
 
-    return eizo_verify(handle, usage);
+    if (res >= EIZO_SUCCESS) {
+        memcpy(value, r.value, len);
+    }
+    return res;
 }
 
-enum eizo_result
-eizo_get_ff300009(struct eizo_handle *handle, uint8_t *info, int *size)
+static uint64_t
+eizo_now_ms()
 {
-    uint8_t buf[EIZO_FF300009_MAX_SIZE + 1];
-    buf[0] = handle->rid.key_value;
+    return eizo_now_ns() / 1000000;
+}
 
-    int s = ioctl(handle->fd, HIDIOCGFEATURE(sizeof(buf)), buf);
-    if (s < 0) {
-        return EIZO_ERROR_IO;
+static void
+eizo_invalidate_values(struct eizo_handle *handle)
+{
+    if (!handle->values) {
+        return;
     }
-
-    if (s > 1) {
-        memcpy(info, buf + 1, --s);
+    for (size_t i = 0; i < handle->ctrl->table.n; ++i) {
+        handle->values[i].valid = false;
     }
-    *size = s;
-    return EIZO_SUCCESS;
 }
 
-
 static enum eizo_result
-eizo_parse_hidraw_descriptor(struct eizo_handle *handle)
+eizo_get_value_cached(
+    struct eizo_handle *handle,
+    size_t i,
+    uint8_t *value,
+    size_t len)
 {
-    int size = -1;
-
-    int res = ioctl(handle->fd, HIDIOCGRDESCSIZE, &size);
-    if (res < 0 || size < 0) {
-        return EIZO_ERROR_IO;
+    struct eizo_cached_value *cv = &handle->values[i];
+    if (cv->ttl == 0) {
+        return eizo_get_value_unchecked(handle, handle->ctrl->table.usage[i], value, len);
     }
 
-    struct hidraw_report_descriptor desc;
-    desc.size = (uint32_t)size;
+    // An input report that comes in while the value is requested may
+    // already be older than the answer, the value is stale either way.
+    unsigned generation = atomic_load_explicit(&handle->value_generation, memory_order_acquire);
+    uint64_t now = eizo_now_ms();
+    if (cv->valid && cv->generation == generation && now < cv->expires) {
+        memcpy(value, cv->value, len);
+        return EIZO_SUCCESS;
+    }
 
-    res = ioctl(handle->fd, HIDIOCGRDESC, &desc);
-    if (res < 0) {
-        return EIZO_ERROR_IO;
+    // The short report always carries 32 bytes, keep all of them so a later
+    // read of a different length can be served as well.
+    enum eizo_result res = eizo_get_value_unchecked(handle, handle->ctrl->table.usage[i], cv->value, sizeof(cv->value));
+    if (res < EIZO_SUCCESS) {
+        cv->valid = false;
+        return res;
     }
 
-    struct eizo_control control[16];
-    size_t clen = 16;
+    cv->valid = true;
+    cv->generation = generation;
+    cv->expires = now + cv->ttl;
+    memcpy(value, cv->value, len);
+    return res;
+}
 
-    res = eizo_parse_descriptor(desc.value, desc.size, control, &clen);
+static enum eizo_result
+eizo_get_value_locked(struct eizo_handle *handle, enum eizo_usage usage, uint8_t *value, size_t len)
+{
+    enum eizo_result res = eizo_ensure_controls(handle);
     if (res < EIZO_SUCCESS) {
-        fprintf(stderr, "%s: failed to parse descriptor. %i\n", __func__, res);
         return res;
     }
 
-    unsigned mask = 0;
-    for (size_t i = 0; i < clen; ++i) {
-        switch (control[i].usage) {
-            case EIZO_USAGE_SECONDARY_DESCRIPTOR:
-                handle->rid.desc = control[i].report_id;
-                mask |= 1;
-                break;
-            case EIZO_USAGE_SET_VALUE:
-                handle->rid.set[0] = control[i].report_id;
-                mask |= 2;
-                break;
-            case EIZO_USAGE_GET_VALUE:
-                handle->rid.get[0] = control[i].report_id;
-                mask |= 4;
-                break;
-            case EIZO_USAGE_SET_VALUE_V2:
-                handle->rid.set[1] = control[i].report_id;
-                mask |= 8;
-                break;
-            case EIZO_USAGE_GET_VALUE_V2:
-                handle->rid.get[1] = control[i].report_id;
-                mask |= 16;
-                break;
-            case EIZO_USAGE_HANDLE_COUNTER:
-                handle->rid.counter = control[i].report_id;
-                mask |= 32;
-                break;
-            case EIZO_USAGE_VERIFY_LAST_REQUEST:
-                handle->rid.verify = control[i].report_id;
-                mask |= 64;
-                break;
-            case EIZO_USAGE_SERIAL_PRODUCT_STRING_2:
-                handle->rid.sn_prod = control[i].report_id;
-                mask |= 128;
-                break;
-            case EIZO_USAGE_UNKNOWN_KEY_VALUE_PAIRS_2:
-                handle->rid.key_value = control[i].report_id;
-                mask |= 256;
-                break;
-            default:
-                break;
-        }
+    size_t i = eizo_control_lookup(handle, usage);
+    if (i == SIZE_MAX) {
+        eizo_log_debug("monitor does not support usage %08w32x", usage);
+        return EIZO_ERROR_INVALID_USAGE;
     }
 
-    if (mask != 511) {
-        fprintf(stderr, "%s: failed to find all required usages. 0b%09b\n", __func__, mask);
-        return EIZO_ERROR_BAD_DATA;
+    if (handle->values && len <= sizeof(handle->values->value)) {
+        return eizo_get_value_cached(handle, i, value, len);
     }
 
-    return EIZO_SUCCESS;
+    return eizo_get_value_unchecked(handle, usage, value, len);
 }
 
+struct eizo_value_args {
+    enum eizo_usage usage;
+    uint8_t *value;
+    size_t len;
+};
+
 static enum eizo_result
-eizo_parse_hidraw_devinfo(struct eizo_handle *handle)
+eizo_get_value_job(struct eizo_handle *handle, void *arg)
 {
-    struct hidraw_devinfo devinfo = {};
-
-    int res = ioctl(handle->fd, HIDIOCGRAWINFO, &devinfo);
-    if (res < 0) {
-        return EIZO_ERROR_IO;
-    }
+    struct eizo_value_args *a = arg;
 
-    if (devinfo.vendor != EIZO_VID) {
-        return EIZO_ERROR_UNKNOWN;
-    }
+    return eizo_get_value_locked(handle, a->usage, a->value, a->len);
+}
 
-    handle->pid = devinfo.product;
-    return EIZO_SUCCESS;
+enum eizo_result
+eizo_get_value(struct eizo_handle *handle, uint32_t usage, uint8_t *value, size_t len)
+{
+    uint64_t start = eizo_now_ns();
+    struct eizo_value_args a = { usage, value, len };
+    enum eizo_result res = eizo_io_run(handle, EIZO_IO_SHORT, eizo_get_value_job, &a);
+    eizo_stats_record(handle, EIZO_STATS_GET_VALUE, start, res);
+    return res;
 }
 
 static enum eizo_result
-eizo_parse_secondary_descriptor(struct eizo_handle *handle)
+eizo_get_values_locked(
+    struct eizo_handle *handle,
+    const enum eizo_usage *usages,
+    size_t n,
+    uint8_t *const *values,
+    size_t *lens,
+    enum eizo_result *results)
 {
-    uint8_t desc[HID_MAX_DESCRIPTOR_SIZE];
-    size_t len = 0;
-    enum eizo_result res = eizo_get_secondary_descriptor(handle, desc, &len);
+    enum eizo_result res = eizo_ensure_controls(handle);
     if (res < EIZO_SUCCESS) {
         return res;
     }
 
-    size_t n_ctrl = 256;
-    struct eizo_control *ctrl_max = calloc(n_ctrl, sizeof(struct eizo_control));
-    if (!ctrl_max) {
-        return EIZO_ERROR_NO_MEMORY;
-    }
+    size_t failed = 0;
 
-    res = eizo_parse_descriptor(desc, len, ctrl_max, &n_ctrl);
-    if (res < EIZO_SUCCESS) {
-        free(ctrl_max);
-        return res;
-    }
+    // Each request is only issued once the previous one has been verified,
+    // which is all the pacing the monitor needs.
+    for (size_t i = 0; i < n; ++i) {
+        size_t k = eizo_control_lookup(handle, usages[i]);
+        struct eizo_control ctrl = {};
+        if (k != SIZE_MAX) {
+            ctrl = eizo_control_get(&handle->ctrl->table, k);
+        }
+        size_t len = eizo_control_size(&ctrl);
+
+        if (k == SIZE_MAX) {
+            res = EIZO_ERROR_INVALID_USAGE;
+        } else if (len == 0 || len > 512 || len > lens[i]) {
+            res = EIZO_ERROR_INVALID_ARGUMENT;
+        } else if (handle->values && len <= sizeof(handle->values->value)) {
+            res = eizo_get_value_cached(handle, k, values[i], len);
+        } else {
+            res = eizo_get_value_unchecked(handle, usages[i], values[i], len);
+        }
 
-    if (n_ctrl == 0) {
-        free(ctrl_max);
-        return EIZO_ERROR_BAD_DATA;
-    }
+        if (res < EIZO_SUCCESS) {
+            ++failed;
+            len = 0;
+        }
+        lens[i] = len;
+        results[i] = res;
 
-    struct eizo_control *ctrl = reallocarray(ctrl_max, n_ctrl, sizeof(struct eizo_control));
-    if (!ctrl) {
-        free(ctrl_max);
-        return EIZO_ERROR_NO_MEMORY;
+        eizo_io_yield(handle);
     }
 
-    qsort(ctrl, n_ctrl, sizeof(struct eizo_control), eizo_control_compare_by_usage);
+    return failed ? EIZO_INCOMPLETE : EIZO_SUCCESS;
+}
 
-    handle->n_ctrl = n_ctrl;
-    handle->ctrl = ctrl;
-    return EIZO_SUCCESS;
+struct eizo_values_args {
+    const enum eizo_usage *usages;
+    size_t n;
+    uint8_t *const *values;
+    size_t *lens;
+    enum eizo_result *results;
+};
+
+static enum eizo_result
+eizo_get_values_job(struct eizo_handle *handle, void *arg)
+{
+    struct eizo_values_args *a = arg;
+    return eizo_get_values_locked(handle, a->usages, a->n, a->values, a->lens, a->results);
 }
 
 enum eizo_result
-eizo_open(const char *hidraw, struct eizo_handle **handle)
+eizo_get_values(
+    struct eizo_handle *handle,
+    const enum eizo_usage *usages,
+    size_t n,
+    uint8_t *const *values,
+    size_t *lens,
+    enum eizo_result *results)
 {
-    int fd = open(hidraw, O_RDWR | O_CLOEXEC);
-    if (fd < 0)
-        return EIZO_ERROR_IO;
-
-    return eizo_new(fd, handle);
+    struct eizo_values_args a = { usages, n, values, lens, results };
+    return eizo_io_run(handle, EIZO_IO_LONG, eizo_get_values_job, &a);
 }
 
+// Issue a set request for usage with the first len bytes of r->value and
+// verify it.
 enum eizo_result
-eizo_new(const int fd, struct eizo_handle **handle)
+eizo_set_report(struct eizo_handle *handle, struct eizo_value_report *r, enum eizo_usage usage, size_t len)
 {
-    struct eizo_handle *h = calloc(1, sizeof *h);
-    if (!h) {
-        return EIZO_ERROR_NO_MEMORY;
+    unsigned long cap;
+
+    if (len <= 32) {
+        r->report_id = handle->rid.set[0];
+        cap = 39;
+    } else if (len <= 512) {
+        r->report_id = handle->rid.set[1];
+        cap = 519;
+    } else {
+        return EIZO_ERROR_INVALID_ARGUMENT;
     }
 
-    h->fd = fd;
+    r->usage = eizo_swap_usage(usage);
+    r->counter = htole16(handle->counter);
+    memset(r->value + len, 0, cap - offsetof(struct eizo_value_report, value) - len);
 
-#define err_check(res, msg) \
-    if ((res) < EIZO_SUCCESS) { \
-        fprintf(stderr, "%s: " msg " %i\n", __func__, res); \
-        goto err_hidraw; \
-    }
+    // A single setting can change others with it, e.g. switching the
+    // profile changes brightness and contrast. Drop every cached value
+    // rather than trying to track those relations.
+    eizo_invalidate_values(handle);
+    eizo_invalidate_luts_for(handle, usage);
 
-    enum eizo_result res = eizo_parse_hidraw_devinfo(h);
-    err_check(res, "Failed to read hidraw devinfo.");
+    EIZO_TRACE(set_value_start, usage, r->report_id, handle->counter, len, 0);
 
-    res = eizo_parse_hidraw_descriptor(h);
-    err_check(res, "Failed to read hidraw descriptor.");
+    enum eizo_result res = EIZO_ERROR_IO;
+    if (eizo_set_feature(handle, r, cap) >= 0) {
+        res = eizo_verify(handle, usage);
+    }
+
+    EIZO_TRACE(set_value_end, usage, r->report_id, handle->counter, len, res);
+    return res;
+}
+
+static enum eizo_result
+eizo_set_value_locked(struct eizo_handle *handle, enum eizo_usage usage, uint8_t *value, size_t len)
+{
+    enum eizo_result res = eizo_ensure_controls(handle);
+    if (res < EIZO_SUCCESS) {
+        return res;
+    }
+
+    if (!eizo_control_find(handle, usage, nullptr)) {
+        eizo_log_debug("monitor does not support usage %08w32x", usage);
+        return EIZO_ERROR_INVALID_USAGE;
+    }
+
+    if (len > 512) {
+        return EIZO_ERROR_INVALID_ARGUMENT;
+    }
+
+    struct eizo_value_report r;
+    memcpy(r.value, value, len);
+
+    unsigned attempt = 0;
+    do {
+        res = eizo_set_report(handle, &r, usage, len);
+    } while (res < EIZO_SUCCESS && eizo_retry(handle, res, EIZO_RETRY_SETS, &attempt));
+    return res;
+}
+
+// Writes that select what later writes apply to, or that trigger an
+// action, are never merged, and later writes aren't merged across them.
+static bool
+eizo_coalesce_is_barrier(enum eizo_usage usage)
+{
+    switch (usage) {
+        case EIZO_USAGE_SETTINGS:
+        case EIZO_USAGE_PROFILE:
+        case EIZO_USAGE_EEPROM_ADDRESS:
+        case EIZO_USAGE_EEPROM_DATA:
+        case EIZO_USAGE_POWER:
+        case EIZO_USAGE_MODE:
+        case EIZO_USAGE_INPUT_PORT:
+        case EIZO_USAGE_SYSTEM_CHROMATICITY_ROLLBACK:
+        case EIZO_USAGE_SAVE:
+        case EIZO_USAGE_FACTORY_RESET:
+        case EIZO_USAGE_COPY_CALIBRATION_DATA:
+        case EIZO_USAGE_EDID_DDC_WRITE:
+        case EIZO_USAGE_MAX_CANDELA_ROLLBACK:
+        case EIZO_USAGE_SELF_QC_CALIBRATION:
+        case EIZO_USAGE_MEASURE_AMBIENT_LIGHT:
+        case EIZO_USAGE_SELF_CORRECTION:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Queue value at the tail. A pending value of the same usage queued after
+// the last barrier is dropped, the others stay in order. Returns false if
+// the queue is full.
+static bool
+eizo_coalesce_push(struct eizo_handle *handle, enum eizo_usage usage, const uint8_t *value, size_t len)
+{
+    struct eizo_pending_set *pending = handle->coalesce.pending;
+    size_t n = handle->coalesce.n;
+
+    if (!eizo_coalesce_is_barrier(usage)) {
+        for (size_t i = n; i-- > 0;) {
+            if (eizo_coalesce_is_barrier(pending[i].usage)) {
+                break;
+            }
+            if (pending[i].usage == usage) {
+                memmove(&pending[i], &pending[i + 1], (n - i - 1) * sizeof(*pending));
+                --n;
+                break;
+            }
+        }
+    }
+
+    if (n == EIZO_MAX_PENDING_SETS) {
+        return false;
+    }
+
+    pending[n] = (struct eizo_pending_set) { .usage = usage, .len = len };
+    memcpy(pending[n].value, value, len);
+    handle->coalesce.n = n + 1;
+    return true;
+}
+
+static enum eizo_result
+eizo_set_value_job(struct eizo_handle *handle, void *arg)
+{
+    struct eizo_value_args *a = arg;
+
+    return eizo_set_value_locked(handle, a->usage, a->value, a->len);
+}
+
+// Write the oldest pending value. Called and returns with the lock held.
+static void
+eizo_coalesce_write_next(struct eizo_handle *handle)
+{
+    struct eizo_pending_set p = handle->coalesce.pending[0];
+    --handle->coalesce.n;
+    memmove(&handle->coalesce.pending[0], &handle->coalesce.pending[1], handle->coalesce.n * sizeof(p));
+    handle->coalesce.busy = true;
+    pthread_mutex_unlock(&handle->coalesce.lock);
+
+    // Writes are issued back to back, each one as soon as the previous
+    // one has been verified, which is the rate the monitor can take.
+    struct eizo_value_args a = { p.usage, p.value, p.len };
+    enum eizo_result res = eizo_io_run(handle, EIZO_IO_SHORT, eizo_set_value_job, &a);
+
+    if (handle->coalesce.cb) {
+        handle->coalesce.cb(handle, p.usage, p.value, p.len, res, handle->coalesce.userdata);
+    }
+
+    pthread_mutex_lock(&handle->coalesce.lock);
+    handle->coalesce.busy = false;
+    pthread_cond_broadcast(&handle->coalesce.idle);
+}
+
+static void *
+eizo_coalesce_thread(void *arg)
+{
+    struct eizo_handle *handle = arg;
+
+    pthread_mutex_lock(&handle->coalesce.lock);
+    while (true) {
+        while (handle->coalesce.n == 0 && !handle->coalesce.stop) {
+            pthread_cond_wait(&handle->coalesce.cond, &handle->coalesce.lock);
+        }
+        if (handle->coalesce.n == 0) {
+            break;
+        }
+        eizo_coalesce_write_next(handle);
+    }
+    pthread_mutex_unlock(&handle->coalesce.lock);
+
+    return nullptr;
+}
+
+// The set callback may write again from the thread, which then can't wait
+// for itself and writes what is queued in its place.
+static bool
+eizo_coalesce_is_self(struct eizo_handle *handle)
+{
+    return handle->coalesce.running && pthread_equal(pthread_self(), handle->coalesce.thread);
+}
+
+// Queue a write, waiting for room if the queue is full. Returns false if
+// coalescing is off or being turned off. Called with the lock held.
+static bool
+eizo_coalesce_queue(struct eizo_handle *handle, enum eizo_usage usage, const uint8_t *value, size_t len)
+{
+    while (handle->coalesce.running && !handle->coalesce.stop) {
+        if (eizo_coalesce_push(handle, usage, value, len)) {
+            pthread_cond_signal(&handle->coalesce.cond);
+            return true;
+        }
+        if (eizo_coalesce_is_self(handle)) {
+            eizo_coalesce_write_next(handle);
+        } else {
+            pthread_cond_wait(&handle->coalesce.idle, &handle->coalesce.lock);
+        }
+    }
+    return false;
+}
+
+// Wait until every queued write went out, so one that is issued directly
+// doesn't overtake them. Called with the lock held.
+static void
+eizo_coalesce_drain(struct eizo_handle *handle)
+{
+    bool self = eizo_coalesce_is_self(handle);
+    while (handle->coalesce.n > 0 || (handle->coalesce.busy && !self)) {
+        if (self) {
+            eizo_coalesce_write_next(handle);
+        } else {
+            pthread_cond_wait(&handle->coalesce.idle, &handle->coalesce.lock);
+        }
+    }
+}
+
+enum eizo_result
+eizo_set_value(struct eizo_handle *handle, uint32_t usage, uint8_t *value, size_t len)
+{
+    uint64_t start = eizo_now_ns();
+    enum eizo_result res = EIZO_INCOMPLETE;
+
+    pthread_mutex_lock(&handle->coalesce.lock);
+    bool queued = len <= sizeof(handle->coalesce.pending->value)
+        && eizo_coalesce_queue(handle, usage, value, len);
+    if (!queued) {
+        eizo_coalesce_drain(handle);
+    }
+    pthread_mutex_unlock(&handle->coalesce.lock);
+
+    if (!queued) {
+        struct eizo_value_args a = { usage, value, len };
+        res = eizo_io_run(handle, EIZO_IO_SHORT, eizo_set_value_job, &a);
+    }
+
+    eizo_stats_record(handle, EIZO_STATS_SET_VALUE, start, res);
+    return res;
+}
+
+static bool
+eizo_worker_is_self(struct eizo_handle *handle)
+{
+    return handle->worker.running && pthread_equal(pthread_self(), handle->worker.thread);
+}
+
+static struct eizo_io_job *
+eizo_worker_pop(struct eizo_handle *handle, enum eizo_io_kind kind)
+{
+    struct eizo_io_job *job = handle->worker.head[kind];
+    if (job) {
+        handle->worker.head[kind] = job->next;
+        if (!job->next) {
+            handle->worker.tail[kind] = &handle->worker.head[kind];
+        }
+    }
+    return job;
+}
+
+// Called with the worker lock held, which is released while fn runs.
+static void
+eizo_worker_run(struct eizo_handle *handle, struct eizo_io_job *job)
+{
+    pthread_mutex_unlock(&handle->worker.lock);
+    enum eizo_result res = job->fn(handle, job->arg);
+    pthread_mutex_lock(&handle->worker.lock);
+
+    job->res = res;
+    job->done = true;
+    pthread_cond_broadcast(&handle->worker.done);
+}
+
+static void *
+eizo_worker_thread(void *arg)
+{
+    struct eizo_handle *handle = arg;
+
+    pthread_mutex_lock(&handle->worker.lock);
+    while (true) {
+        struct eizo_io_job *job = eizo_worker_pop(handle, EIZO_IO_SHORT);
+        if (!job) {
+            job = eizo_worker_pop(handle, EIZO_IO_LONG);
+        }
+        if (!job) {
+            if (handle->worker.stop) {
+                break;
+            }
+            pthread_cond_wait(&handle->worker.cond, &handle->worker.lock);
+            continue;
+        }
+
+        // Every request goes through this thread, which takes the place
+        // of the io lock.
+        eizo_worker_run(handle, job);
+    }
+    pthread_mutex_unlock(&handle->worker.lock);
+
+    return nullptr;
+}
+
+enum eizo_result
+eizo_io_run(struct eizo_handle *handle, enum eizo_io_kind kind, eizo_io_fn fn, void *arg)
+{
+    // Requests issued from within another one run right away.
+    if (eizo_worker_is_self(handle)) {
+        return fn(handle, arg);
+    }
+
+    if (!handle->worker.running) {
+        pthread_mutex_lock(&handle->io_lock);
+        enum eizo_result res = fn(handle, arg);
+        pthread_mutex_unlock(&handle->io_lock);
+        return res;
+    }
+
+    struct eizo_io_job job = { .fn = fn, .arg = arg };
+
+    pthread_mutex_lock(&handle->worker.lock);
+    *handle->worker.tail[kind] = &job;
+    handle->worker.tail[kind] = &job.next;
+    pthread_cond_signal(&handle->worker.cond);
+    while (!job.done) {
+        pthread_cond_wait(&handle->worker.done, &handle->worker.lock);
+    }
+    pthread_mutex_unlock(&handle->worker.lock);
+
+    return job.res;
+}
+
+bool
+eizo_io_yield(struct eizo_handle *handle)
+{
+    if (!eizo_worker_is_self(handle)) {
+        return false;
+    }
+
+    bool ran = false;
+    pthread_mutex_lock(&handle->worker.lock);
+    struct eizo_io_job *job;
+    while ((job = eizo_worker_pop(handle, EIZO_IO_SHORT))) {
+        eizo_worker_run(handle, job);
+        ran = true;
+    }
+    pthread_mutex_unlock(&handle->worker.lock);
+    return ran;
+}
+
+static enum eizo_result
+eizo_worker_start(struct eizo_handle *handle)
+{
+    handle->worker.stop = false;
+    int rc = pthread_create(&handle->worker.thread, nullptr, eizo_worker_thread, handle);
+    if (rc != 0) {
+        return EIZO_ERROR_NO_MEMORY;
+    }
+
+    handle->worker.running = true;
+    return EIZO_SUCCESS;
+}
+
+static void
+eizo_worker_stop(struct eizo_handle *handle)
+{
+    if (!handle->worker.running) {
+        return;
+    }
+
+    // The thread serves every queued request before it exits.
+    pthread_mutex_lock(&handle->worker.lock);
+    handle->worker.stop = true;
+    pthread_cond_signal(&handle->worker.cond);
+    pthread_mutex_unlock(&handle->worker.lock);
+
+    pthread_join(handle->worker.thread, nullptr);
+    handle->worker.running = false;
+}
+
+enum eizo_result
+eizo_get_value_raw(struct eizo_handle *handle, enum eizo_usage usage, uint8_t *value, size_t len)
+{
+    enum eizo_result res = eizo_ensure_controls(handle);
+    if (res < EIZO_SUCCESS) {
+        return res;
+    }
+
+    if (!eizo_control_find(handle, usage, nullptr)) {
+        eizo_log_debug("monitor does not support usage %08w32x", usage);
+        return EIZO_ERROR_INVALID_USAGE;
+    }
+
+    return eizo_get_value_unchecked(handle, usage, value, len);
+}
+
+enum eizo_result
+eizo_refresh_counter(struct eizo_handle *handle)
+{
+    return eizo_get_counter(handle, &handle->counter);
+}
+
+struct eizo_retry_args {
+    enum eizo_retry_flags flags;
+    unsigned retries;
+};
+
+static enum eizo_result
+eizo_set_retry_policy_job(struct eizo_handle *handle, void *arg)
+{
+    struct eizo_retry_args *a = arg;
+    handle->retry.flags = a->flags;
+    handle->retry.max = a->retries;
+    return EIZO_SUCCESS;
+}
+
+void
+eizo_set_retry_policy(struct eizo_handle *handle, enum eizo_retry_flags flags, unsigned retries)
+{
+    struct eizo_retry_args a = { flags, retries };
+    eizo_io_run(handle, EIZO_IO_SHORT, eizo_set_retry_policy_job, &a);
+}
+
+static uint64_t
+eizo_stats_load(_Atomic uint64_t *counter)
+{
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+// Counters are read and cleared one by one, a concurrent request may end
+// up partly before and partly after.
+void
+eizo_get_stats(struct eizo_handle *handle, struct eizo_stats *stats)
+{
+    for (size_t i = 0; i < EIZO_STATS_OPS; ++i) {
+        struct eizo_op_counters *c = &handle->stats.op[i];
+        struct eizo_op_stats *o = &stats->op[i];
+
+        o->count = eizo_stats_load(&c->count);
+        o->total_ns = eizo_stats_load(&c->total_ns);
+        for (size_t k = 0; k < EIZO_STATS_LATENCY_BUCKETS; ++k) {
+            o->latency[k] = eizo_stats_load(&c->latency[k]);
+        }
+        for (size_t k = 0; k < EIZO_STATS_RESULTS; ++k) {
+            o->results[k] = eizo_stats_load(&c->results[k]);
+        }
+    }
+
+    stats->get_feature = eizo_stats_load(&handle->stats.get_feature);
+    stats->set_feature = eizo_stats_load(&handle->stats.set_feature);
+    stats->read = eizo_stats_load(&handle->stats.read);
+    stats->bytes_short = eizo_stats_load(&handle->stats.bytes_short);
+    stats->bytes_long = eizo_stats_load(&handle->stats.bytes_long);
+    stats->bytes_other = eizo_stats_load(&handle->stats.bytes_other);
+}
+
+void
+eizo_reset_stats(struct eizo_handle *handle)
+{
+    // The stats are nothing but counters.
+    _Atomic uint64_t *c = (_Atomic uint64_t *)&handle->stats;
+    for (size_t i = 0; i < sizeof(handle->stats) / sizeof(*c); ++i) {
+        atomic_store_explicit(&c[i], 0, memory_order_relaxed);
+    }
+}
+
+uint16_t
+eizo_current_counter(struct eizo_handle *handle)
+{
+    return handle->counter;
+}
+
+enum eizo_result
+eizo_set_value_raw(struct eizo_handle *handle, enum eizo_usage usage, uint8_t *value, size_t len)
+{
+    return eizo_set_value_locked(handle, usage, value, len);
+}
+
+struct eizo_lut_shadow **
+eizo_lut_shadow(struct eizo_handle *handle, unsigned lut)
+{
+    return &handle->lut[lut];
+}
+
+enum eizo_result
+eizo_enable_coalescing(struct eizo_handle *handle, eizo_set_callback cb, void *userdata)
+{
+    enum eizo_result res = EIZO_SUCCESS;
+
+    pthread_mutex_lock(&handle->coalesce.lock);
+    if (handle->coalesce.running) {
+        res = EIZO_ERROR_INVALID_ARGUMENT;
+    } else {
+        handle->coalesce.cb = cb;
+        handle->coalesce.userdata = userdata;
+        handle->coalesce.stop = false;
+
+        int rc = pthread_create(&handle->coalesce.thread, nullptr, eizo_coalesce_thread, handle);
+        if (rc != 0) {
+            res = EIZO_ERROR_NO_MEMORY;
+        } else {
+            handle->coalesce.running = true;
+        }
+    }
+    pthread_mutex_unlock(&handle->coalesce.lock);
+
+    return res;
+}
+
+void
+eizo_disable_coalescing(struct eizo_handle *handle)
+{
+    // Nothing is queued once stop is set, and the thread drains every
+    // pending value before it exits.
+    pthread_mutex_lock(&handle->coalesce.lock);
+    if (!handle->coalesce.running || handle->coalesce.stop) {
+        pthread_mutex_unlock(&handle->coalesce.lock);
+        return;
+    }
+    handle->coalesce.stop = true;
+    pthread_cond_signal(&handle->coalesce.cond);
+    pthread_mutex_unlock(&handle->coalesce.lock);
+
+    pthread_join(handle->coalesce.thread, nullptr);
+
+    pthread_mutex_lock(&handle->coalesce.lock);
+    handle->coalesce.running = false;
+    pthread_mutex_unlock(&handle->coalesce.lock);
+}
+
+enum eizo_result
+eizo_get_ff300009(struct eizo_handle *handle, uint8_t *info, int *size)
+{
+    uint8_t buf[EIZO_FF300009_MAX_SIZE + 1];
+    buf[0] = handle->rid.key_value;
+
+    int s = eizo_get_feature(handle, buf, sizeof(buf));
+    if (s < 0) {
+        return EIZO_ERROR_IO;
+    }
+
+    if (s > 1) {
+        memcpy(info, buf + 1, --s);
+    }
+    *size = s;
+    return EIZO_SUCCESS;
+}
+
+
+static enum eizo_result
+eizo_parse_hidraw_descriptor(struct eizo_handle *handle)
+{
+    uint8_t desc[HID_MAX_DESCRIPTOR_SIZE];
+    size_t size = sizeof(desc);
+
+    int res = handle->transport.ops->get_report_descriptor(&handle->transport, desc, &size);
+    if (res < 0) {
+        return EIZO_ERROR_IO;
+    }
+
+    alignas(enum eizo_usage) uint8_t block[16 * EIZO_CONTROL_ENTRY_SIZE];
+    struct eizo_control_table control;
+    eizo_control_table_init(&control, block, 16);
+
+    res = eizo_parse_descriptor(desc, size, &control);
+    if (res < EIZO_SUCCESS) {
+        eizo_log_error("failed to parse descriptor. %i", res);
+        return res;
+    }
+
+    unsigned mask = 0;
+    for (size_t i = 0; i < control.n; ++i) {
+        switch (control.usage[i]) {
+            case EIZO_USAGE_SECONDARY_DESCRIPTOR:
+                handle->rid.desc = control.report_id[i];
+                mask |= 1;
+                break;
+            case EIZO_USAGE_SET_VALUE:
+                handle->rid.set[0] = control.report_id[i];
+                mask |= 2;
+                break;
+            case EIZO_USAGE_GET_VALUE:
+                handle->rid.get[0] = control.report_id[i];
+                mask |= 4;
+                break;
+            case EIZO_USAGE_SET_VALUE_V2:
+                handle->rid.set[1] = control.report_id[i];
+                mask |= 8;
+                break;
+            case EIZO_USAGE_GET_VALUE_V2:
+                handle->rid.get[1] = control.report_id[i];
+                mask |= 16;
+                break;
+            case EIZO_USAGE_HANDLE_COUNTER:
+                handle->rid.counter = control.report_id[i];
+                mask |= 32;
+                break;
+            case EIZO_USAGE_VERIFY_LAST_REQUEST:
+                handle->rid.verify = control.report_id[i];
+                mask |= 64;
+                break;
+            case EIZO_USAGE_SERIAL_PRODUCT_STRING_2:
+                handle->rid.sn_prod = control.report_id[i];
+                mask |= 128;
+                break;
+            case EIZO_USAGE_UNKNOWN_KEY_VALUE_PAIRS_2:
+                handle->rid.key_value = control.report_id[i];
+                mask |= 256;
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (mask != 511) {
+        eizo_log_error("failed to find all required usages. 0b%09b", mask);
+        return EIZO_ERROR_BAD_DATA;
+    }
+
+    return EIZO_SUCCESS;
+}
+
+static enum eizo_result
+eizo_parse_hidraw_devinfo(struct eizo_handle *handle)
+{
+    uint16_t vendor = 0, product = 0;
+
+    int res = handle->transport.ops->get_devinfo(&handle->transport, &vendor, &product);
+    if (res < 0) {
+        return EIZO_ERROR_IO;
+    }
+
+    if (vendor != EIZO_VID) {
+        return EIZO_ERROR_UNKNOWN;
+    }
+
+    handle->pid = product;
+    return EIZO_SUCCESS;
+}
+
+static enum eizo_result
+eizo_parse_secondary_descriptor(struct eizo_handle *handle)
+{
+    uint8_t desc[HID_MAX_DESCRIPTOR_SIZE];
+    size_t len = 0;
+    enum eizo_result res = eizo_get_secondary_descriptor(handle, desc, &len);
+    if (res < EIZO_SUCCESS) {
+        return res;
+    }
+
+    return eizo_controls_acquire(handle->pid, desc, len, &handle->ctrl);
+}
+
+static enum eizo_result
+eizo_load_controls(struct eizo_handle *handle)
+{
+    if (!(handle->flags & EIZO_OPEN_CACHE_DESCRIPTOR)) {
+        return eizo_parse_secondary_descriptor(handle);
+    }
+
+    // The serial is part of the cache key, so a lazily opened handle has
+    // to fetch it now.
+    enum eizo_result res = eizo_ensure_product(handle);
+    if (res < EIZO_SUCCESS) {
+        return res;
+    }
+
+    // The control table is not loaded yet, so the firmware version has to
+    // be requested blindly. Monitors that do not know the usage fail the
+    // verify step, in which case the cache is skipped entirely.
+    uint8_t fw[EIZO_FIRMWARE_VERSION_SIZE] = {};
+    res = eizo_get_value_unchecked(
+        handle, EIZO_USAGE_FIRMWARE_VERSION, fw, sizeof(fw));
+    if (res < EIZO_SUCCESS || handle->serial == 0) {
+        return eizo_parse_secondary_descriptor(handle);
+    }
+
+    res = eizo_cache_load(handle->pid, handle->serial, fw, &handle->cache);
+    if (res >= EIZO_SUCCESS) {
+        res = eizo_controls_wrap(handle->cache.block, handle->cache.n_ctrl, &handle->ctrl);
+        if (res < EIZO_SUCCESS) {
+            eizo_cache_unmap(&handle->cache);
+        }
+        return res;
+    }
+
+    res = eizo_parse_secondary_descriptor(handle);
+    if (res < EIZO_SUCCESS) {
+        return res;
+    }
+
+    eizo_cache_store(handle->pid, handle->serial, fw, &handle->ctrl->table);
+    return EIZO_SUCCESS;
+}
+
+static enum eizo_result
+eizo_load_controls_job(struct eizo_handle *handle, void *)
+{
+    if (atomic_load_explicit(&handle->have_controls, memory_order_relaxed)) {
+        return EIZO_SUCCESS;
+    }
+
+    enum eizo_result res = eizo_load_controls(handle);
+    if (res >= EIZO_SUCCESS) {
+        atomic_store_explicit(&handle->have_controls, true, memory_order_release);
+    }
+    return res;
+}
+
+static enum eizo_result
+eizo_ensure_controls(struct eizo_handle *handle)
+{
+    if (atomic_load_explicit(&handle->have_controls, memory_order_acquire)) {
+        return EIZO_SUCCESS;
+    }
+
+    return eizo_io_run(handle, EIZO_IO_SHORT, eizo_load_controls_job, nullptr);
+}
+
+enum eizo_result
+eizo_open(const char *hidraw, struct eizo_handle **handle)
+{
+    return eizo_open_ex(hidraw, EIZO_OPEN_DEFAULT, handle);
+}
+
+enum eizo_result
+eizo_open_ex(const char *hidraw, enum eizo_open_flags flags, struct eizo_handle **handle)
+{
+    int fd = open(hidraw, O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+        return EIZO_ERROR_IO;
+
+    return eizo_new_ex(fd, flags, handle);
+}
+
+enum eizo_result
+eizo_new(const int fd, struct eizo_handle **handle)
+{
+    return eizo_new_ex(fd, EIZO_OPEN_DEFAULT, handle);
+}
+
+enum eizo_result
+eizo_new_ex(const int fd, enum eizo_open_flags flags, struct eizo_handle **handle)
+{
+    struct eizo_transport t;
+    eizo_hidraw_transport_init(&t, fd);
+    return eizo_new_transport(&t, flags, handle);
+}
+
+enum eizo_result
+eizo_new_transport(const struct eizo_transport *t, enum eizo_open_flags flags, struct eizo_handle **handle)
+{
+    struct eizo_handle *h = calloc(1, sizeof *h);
+    if (!h) {
+        struct eizo_transport tmp = *t;
+        tmp.ops->close(&tmp);
+        return EIZO_ERROR_NO_MEMORY;
+    }
+
+    h->transport = *t;
+    h->flags = flags;
+    h->retry.flags = EIZO_RETRY_GETS;
+    h->retry.max = 1;
+    // Requests may issue others, e.g. to load the controls first.
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&h->io_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    pthread_mutex_init(&h->listeners.lock, nullptr);
+    pthread_mutex_init(&h->coalesce.lock, nullptr);
+    pthread_cond_init(&h->coalesce.cond, nullptr);
+    pthread_cond_init(&h->coalesce.idle, nullptr);
+    pthread_mutex_init(&h->worker.lock, nullptr);
+    pthread_cond_init(&h->worker.cond, nullptr);
+    pthread_cond_init(&h->worker.done, nullptr);
+    for (size_t i = 0; i < 2; ++i) {
+        h->worker.tail[i] = &h->worker.head[i];
+    }
+
+#define err_check(res, msg) \
+    if ((res) < EIZO_SUCCESS) { \
+        eizo_log_error(msg " %i", res); \
+        goto err_hidraw; \
+    }
+
+    enum eizo_result res = eizo_parse_hidraw_devinfo(h);
+    err_check(res, "Failed to read hidraw devinfo.");
+
+    res = eizo_parse_hidraw_descriptor(h);
+    err_check(res, "Failed to read hidraw descriptor.");
 
     res = eizo_get_counter(h, &h->counter);
     err_check(res, "Failed to read eizo handle counter.");
 
-    res = eizo_get_serial_product(h, &h->serial, h->product);
-    err_check(res, "Failed to read eizo serial/product string.");
+    if (!(flags & EIZO_OPEN_LAZY_PRODUCT)) {
+        res = eizo_get_serial_product(h, &h->serial, h->product);
+        err_check(res, "Failed to read eizo serial/product string.");
+    }
 
-    res = eizo_parse_secondary_descriptor(h);
-    err_check(res, "Failed to parse eizo secondary report descriptor.");
+    if (!(flags & EIZO_OPEN_LAZY_CONTROLS)) {
+        res = eizo_load_controls_job(h, nullptr);
+        err_check(res, "Failed to parse eizo secondary report descriptor.");
+    }
+
+    if (flags & EIZO_OPEN_IO_WORKER) {
+        res = eizo_worker_start(h);
+        err_check(res, "Failed to start eizo I/O thread.");
+    }
 
 #undef err_check
 
@@ -475,18 +1546,272 @@ eizo_new(const int fd, struct eizo_handle **handle)
     return EIZO_SUCCESS;
 
 err_hidraw:
-    close(h->fd);
+    h->transport.ops->close(&h->transport);
+    pthread_cond_destroy(&h->worker.done);
+    pthread_cond_destroy(&h->worker.cond);
+    pthread_mutex_destroy(&h->worker.lock);
+    pthread_cond_destroy(&h->coalesce.idle);
+    pthread_cond_destroy(&h->coalesce.cond);
+    pthread_mutex_destroy(&h->coalesce.lock);
+    pthread_mutex_destroy(&h->listeners.lock);
+    pthread_mutex_destroy(&h->io_lock);
     free(h);
     return res;
 }
 
+static enum eizo_result
+eizo_enable_value_cache_job(struct eizo_handle *handle, void *arg)
+{
+    unsigned ttl_ms = *(unsigned *)arg;
+
+    enum eizo_result res = eizo_ensure_controls(handle);
+    if (res < EIZO_SUCCESS) {
+        return res;
+    }
+
+    if (!handle->values) {
+        handle->values = calloc(handle->ctrl->table.n, sizeof(struct eizo_cached_value));
+        if (!handle->values) {
+            return EIZO_ERROR_NO_MEMORY;
+        }
+    }
+
+    for (size_t i = 0; i < handle->ctrl->table.n; ++i) {
+        handle->values[i].ttl = ttl_ms;
+        handle->values[i].valid = false;
+    }
+    return EIZO_SUCCESS;
+}
+
+enum eizo_result
+eizo_enable_value_cache(struct eizo_handle *handle, unsigned ttl_ms)
+{
+    return eizo_io_run(handle, EIZO_IO_SHORT, eizo_enable_value_cache_job, &ttl_ms);
+}
+
+static enum eizo_result
+eizo_disable_value_cache_job(struct eizo_handle *handle, void *)
+{
+    free(handle->values);
+    handle->values = nullptr;
+    return EIZO_SUCCESS;
+}
+
 void
-eizo_close(struct eizo_handle *handle)
+eizo_disable_value_cache(struct eizo_handle *handle)
+{
+    eizo_io_run(handle, EIZO_IO_SHORT, eizo_disable_value_cache_job, nullptr);
+}
+
+struct eizo_cache_ttl_args {
+    uint32_t usage;
+    unsigned ttl_ms;
+};
+
+static enum eizo_result
+eizo_set_value_cache_ttl_job(struct eizo_handle *handle, void *arg)
+{
+    struct eizo_cache_ttl_args *a = arg;
+
+    if (!handle->values) {
+        return EIZO_ERROR_INVALID_ARGUMENT;
+    }
+
+    size_t i = eizo_control_lookup(handle, a->usage);
+    if (i == SIZE_MAX) {
+        return EIZO_ERROR_INVALID_USAGE;
+    }
+
+    struct eizo_cached_value *cv = &handle->values[i];
+    cv->ttl = a->ttl_ms;
+    cv->valid = false;
+    return EIZO_SUCCESS;
+}
+
+enum eizo_result
+eizo_set_value_cache_ttl(struct eizo_handle *handle, uint32_t usage, unsigned ttl_ms)
+{
+    struct eizo_cache_ttl_args a = { usage, ttl_ms };
+    return eizo_io_run(handle, EIZO_IO_SHORT, eizo_set_value_cache_ttl_job, &a);
+}
+
+enum eizo_result
+eizo_add_value_callback(struct eizo_handle *handle, uint32_t usage, eizo_value_callback cb, void *userdata)
+{
+    pthread_mutex_lock(&handle->listeners.lock);
+    struct eizo_value_listener *l = reallocarray(
+        handle->listeners.list, handle->listeners.n + 1, sizeof(struct eizo_value_listener));
+    if (!l) {
+        pthread_mutex_unlock(&handle->listeners.lock);
+        return EIZO_ERROR_NO_MEMORY;
+    }
+
+    l[handle->listeners.n++] = (struct eizo_value_listener) {
+        .usage = usage,
+        .cb = cb,
+        .userdata = userdata,
+    };
+    handle->listeners.list = l;
+    pthread_mutex_unlock(&handle->listeners.lock);
+    return EIZO_SUCCESS;
+}
+
+void
+eizo_remove_value_callback(struct eizo_handle *handle, uint32_t usage, eizo_value_callback cb, void *userdata)
 {
-    if (handle->ctrl) {
-        free(handle->ctrl);
+    pthread_mutex_lock(&handle->listeners.lock);
+    for (size_t i = 0; i < handle->listeners.n; ++i) {
+        struct eizo_value_listener *l = &handle->listeners.list[i];
+        if (l->usage != usage || l->cb != cb || l->userdata != userdata) {
+            continue;
+        }
+
+        if (handle->listeners.dispatching > 0) {
+            l->cb = nullptr;
+            handle->listeners.dead = true;
+        } else {
+            memmove(l, l + 1, (handle->listeners.n - i - 1) * sizeof(*l));
+            --handle->listeners.n;
+        }
+        break;
     }
-    close(handle->fd);
+    pthread_mutex_unlock(&handle->listeners.lock);
+}
+
+// Called with the listener lock held once nothing dispatches anymore.
+static void
+eizo_compact_listeners(struct eizo_handle *handle)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < handle->listeners.n; ++i) {
+        if (handle->listeners.list[i].cb) {
+            handle->listeners.list[n++] = handle->listeners.list[i];
+        }
+    }
+    handle->listeners.n = n;
+    handle->listeners.dead = false;
+}
+
+static void
+eizo_handle_input_report(struct eizo_handle *handle, const struct eizo_value_report *r, size_t n)
+{
+    struct eizo_value_event ev = {
+        .report_id = r->report_id,
+        .usage = eizo_swap_usage(r->usage),
+        .counter = le16toh(r->counter),
+        .value = r->value,
+        .len = n - offsetof(struct eizo_value_report, value),
+    };
+
+    // The monitor reports every change made through the OSD or by other
+    // processes, drop the cached values so the next read fetches them again.
+    atomic_fetch_add_explicit(&handle->value_generation, 1, memory_order_release);
+
+    // Dispatching never waits for I/O. Without controls loaded yet the
+    // report is passed on as it came.
+    struct eizo_control ctrl = {};
+    size_t k = SIZE_MAX;
+    if (atomic_load_explicit(&handle->have_controls, memory_order_acquire)) {
+        k = eizo_control_index_lookup(handle->ctrl, ev.usage);
+    }
+    if (k != SIZE_MAX) {
+        ctrl = eizo_control_get(&handle->ctrl->table, k);
+        size_t q = eizo_control_size(&ctrl);
+        if (q > 0 && q < ev.len) {
+            ev.len = q;
+        }
+    }
+
+    if (ev.len > 0 && ev.len <= 4) {
+        uint32_t v = 0;
+        for (size_t i = 0; i < ev.len; ++i) {
+            v |= (uint32_t)r->value[i] << (8 * i);
+        }
+        ev.integer = v;
+
+        unsigned bits = (unsigned)ev.len * 8;
+        if (ctrl.logical_minimum < 0 && (v >> (bits - 1)) & 1) {
+            ev.integer -= (int64_t)1 << bits;
+        }
+    }
+
+    // Callbacks run without the lock, so they may add or remove listeners.
+    pthread_mutex_lock(&handle->listeners.lock);
+    ++handle->listeners.dispatching;
+    for (size_t i = 0; i < handle->listeners.n; ++i) {
+        struct eizo_value_listener l = handle->listeners.list[i];
+        if (l.cb && (l.usage == 0 || l.usage == ev.usage)) {
+            pthread_mutex_unlock(&handle->listeners.lock);
+            l.cb(handle, &ev, l.userdata);
+            pthread_mutex_lock(&handle->listeners.lock);
+        }
+    }
+    if (--handle->listeners.dispatching == 0 && handle->listeners.dead) {
+        eizo_compact_listeners(handle);
+    }
+    pthread_mutex_unlock(&handle->listeners.lock);
+}
+
+int
+eizo_dispatch(struct eizo_handle *handle)
+{
+    struct eizo_value_report r;
+    int count = 0;
+
+    while (true) {
+        ssize_t n = handle->transport.ops->read(&handle->transport, &r, sizeof(r));
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return EIZO_ERROR_IO;
+        }
+        if (n == 0) {
+            return EIZO_ERROR_IO;
+        }
+        eizo_stats_add(&handle->stats.read, 1);
+
+        if ((size_t)n < offsetof(struct eizo_value_report, value)) {
+            eizo_log_warning("short input report of %zd bytes", n);
+            EIZO_TRACE(input_report, 0, r.report_id, 0, n, EIZO_ERROR_BAD_DATA);
+            continue;
+        }
+
+        EIZO_TRACE(
+            input_report, eizo_swap_usage(r.usage), r.report_id, le16toh(r.counter),
+            (size_t)n - offsetof(struct eizo_value_report, value), EIZO_SUCCESS);
+
+        eizo_handle_input_report(handle, &r, (size_t)n);
+        ++count;
+    }
+
+    return count;
+}
+
+void
+eizo_close(struct eizo_handle *handle)
+{
+    eizo_disable_coalescing(handle);
+    eizo_worker_stop(handle);
+    pthread_cond_destroy(&handle->worker.done);
+    pthread_cond_destroy(&handle->worker.cond);
+    pthread_mutex_destroy(&handle->worker.lock);
+    pthread_cond_destroy(&handle->coalesce.idle);
+    pthread_cond_destroy(&handle->coalesce.cond);
+    pthread_mutex_destroy(&handle->coalesce.lock);
+    pthread_mutex_destroy(&handle->listeners.lock);
+    pthread_mutex_destroy(&handle->io_lock);
+
+    free(handle->lut[0]);
+    free(handle->lut[1]);
+    free(handle->listeners.list);
+    free(handle->values);
+    eizo_controls_release(handle->ctrl);
+    eizo_cache_unmap(&handle->cache);
+    handle->transport.ops->close(&handle->transport);
     free(handle);
 }
 
@@ -499,17 +1824,19 @@ eizo_get_pid(struct eizo_handle *handle)
 int
 eizo_get_fd(struct eizo_handle *handle)
 {
-    return handle->fd;
+    return handle->transport.fd;
 }
 
 unsigned long
 eizo_get_serial(struct eizo_handle *handle)
 {
+    eizo_ensure_product(handle);
     return handle->serial;
 }
 
 const char *
 eizo_get_product(struct eizo_handle *handle)
 {
+    eizo_ensure_product(handle);
     return handle->product;
 }
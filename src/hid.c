@@ -2,6 +2,7 @@
 #include <memory.h>
 
 #include "eizo/handle.h"
+#include "eizo/log.h"
 #include "internal.h"
 
 #define HID_GLOBAL_STACK_LEN 4
@@ -237,7 +238,7 @@ hid_parse_local(struct hid_parser *parser, const struct hid_item *item)
             break;
 
         case HID_TAG_LOCAL_DELIMITER:
-            fprintf(stderr, "%s: HID delimiter item found, aborting\n", __func__);
+            eizo_log_error("HID delimiter item found, aborting");
             [[fallthrough]];
 
         default:
@@ -265,7 +266,7 @@ hid_fetch_item(const uint8_t **_ptr, const uint8_t *end, struct hid_item *item)
     tmp.tag = b >> 4;
 
     if (tmp.tag == HID_TAG_LONG) {
-        fprintf(stderr, "%s: HID long item found, aborting.\n", __func__);
+        eizo_log_error("HID long item found, aborting.");
         return -1;
     }
 
@@ -278,6 +279,8 @@ hid_fetch_item(const uint8_t **_ptr, const uint8_t *end, struct hid_item *item)
     }
 
     switch (tmp.size) {
+        case 0:
+            break;
         case 1:
             tmp.data.u8 = ptr[0];
             break;
@@ -302,21 +305,21 @@ enum eizo_result
 eizo_parse_descriptor(
     const uint8_t *desc,
     size_t desc_len,
-    struct eizo_control *control,
-    size_t *control_len)
+    struct eizo_control_table *table)
 {
     struct hid_item item;
     const uint8_t *ptr = desc;
     const uint8_t *end = desc + desc_len;
 
-    struct hid_parser parser;
+    struct hid_parser parser = {};
     struct hid_local *local = &parser.local;
     struct hid_global *global = &parser.global;
 
-    if (*control_len > 256) {
+    if (table->n > EIZO_MAX_CONTROLS) {
         return EIZO_ERROR_INVALID_ARGUMENT;
     }
 
+    bool fill = table->usage != nullptr;
     size_t i = 0;
     while (true) {
         int item_len = hid_fetch_item(&ptr, end, &item);
@@ -324,21 +327,33 @@ eizo_parse_descriptor(
             break;
         }
 
-        if (i >= *control_len) {
-            return EIZO_INCOMPLETE;
-        }
-
         switch (item.type) {
             case HID_TYPE_MAIN:
-                if (item.tag == HID_TAG_MAIN_FEATURE) {
-                    control[i].usage = global->usage_page << 16 | local->usage;
-                    control[i].logical_minimum = global->logical_minimum;
-                    control[i].logical_maximum = global->logical_maximum;
-                    control[i].report_id = global->report_id;
-                    control[i].report_count = global->report_count;
-                    control[i].report_size = global->report_size;
-                    ++i;
+                if (item.tag != HID_TAG_MAIN_FEATURE) {
+                    memset(local, 0, sizeof(*local));
+                    break;
+                }
+
+                if (global->report_id > UINT8_MAX
+                    || global->report_size > UINT8_MAX
+                    || global->report_count > UINT16_MAX)
+                {
+                    return EIZO_ERROR_BAD_DATA;
+                }
+
+                if (i >= EIZO_MAX_CONTROLS || (fill && i >= table->n)) {
+                    return EIZO_INCOMPLETE;
+                }
+
+                if (fill) {
+                    table->usage[i] = global->usage_page << 16 | local->usage;
+                    table->logical_minimum[i] = global->logical_minimum;
+                    table->logical_maximum[i] = global->logical_maximum;
+                    table->report_id[i] = (uint8_t)global->report_id;
+                    table->report_count[i] = (uint16_t)global->report_count;
+                    table->report_size[i] = (uint8_t)global->report_size;
                 }
+                ++i;
                 memset(local, 0, sizeof(*local));
                 break;
 
@@ -356,6 +371,6 @@ eizo_parse_descriptor(
         }
     }
 
-    *control_len = i;
+    table->n = i;
     return EIZO_SUCCESS;
 }
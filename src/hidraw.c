@@ -0,0 +1,101 @@
+#include <memory.h>
+#include <errno.h>
+
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <linux/hidraw.h>
+
+#include "eizo/handle.h"
+#include "internal.h"
+
+static int
+eizo_hidraw_get_feature(struct eizo_transport *t, void *buf, size_t len)
+{
+    return ioctl(t->fd, HIDIOCGFEATURE(len), buf);
+}
+
+static int
+eizo_hidraw_set_feature(struct eizo_transport *t, const void *buf, size_t len)
+{
+    return ioctl(t->fd, HIDIOCSFEATURE(len), buf);
+}
+
+static ssize_t
+eizo_hidraw_read(struct eizo_transport *t, void *buf, size_t len)
+{
+    // Input reports are only ever read when the fd reported POLLIN, but
+    // a spurious wakeup must not block the caller's event loop.
+    if (!t->nonblock) {
+        int fl = fcntl(t->fd, F_GETFL);
+        if (fl < 0 || fcntl(t->fd, F_SETFL, fl | O_NONBLOCK) < 0) {
+            return -1;
+        }
+        t->nonblock = true;
+    }
+
+    return read(t->fd, buf, len);
+}
+
+static int
+eizo_hidraw_get_devinfo(struct eizo_transport *t, uint16_t *vendor, uint16_t *product)
+{
+    struct hidraw_devinfo devinfo = {};
+
+    int res = ioctl(t->fd, HIDIOCGRAWINFO, &devinfo);
+    if (res < 0) {
+        return res;
+    }
+
+    *vendor = (uint16_t)devinfo.vendor;
+    *product = (uint16_t)devinfo.product;
+    return 0;
+}
+
+static int
+eizo_hidraw_get_report_descriptor(struct eizo_transport *t, uint8_t *buf, size_t *len)
+{
+    int size = -1;
+
+    int res = ioctl(t->fd, HIDIOCGRDESCSIZE, &size);
+    if (res < 0 || size < 0 || (size_t)size > *len) {
+        return -1;
+    }
+
+    struct hidraw_report_descriptor desc;
+    desc.size = (uint32_t)size;
+
+    res = ioctl(t->fd, HIDIOCGRDESC, &desc);
+    if (res < 0) {
+        return res;
+    }
+
+    memcpy(buf, desc.value, desc.size);
+    *len = desc.size;
+    return 0;
+}
+
+static void
+eizo_hidraw_close(struct eizo_transport *t)
+{
+    close(t->fd);
+}
+
+static const struct eizo_transport_ops eizo_hidraw_ops = {
+    .get_feature = eizo_hidraw_get_feature,
+    .set_feature = eizo_hidraw_set_feature,
+    .read = eizo_hidraw_read,
+    .get_devinfo = eizo_hidraw_get_devinfo,
+    .get_report_descriptor = eizo_hidraw_get_report_descriptor,
+    .close = eizo_hidraw_close,
+};
+
+void
+eizo_hidraw_transport_init(struct eizo_transport *t, int fd)
+{
+    *t = (struct eizo_transport) {
+        .ops = &eizo_hidraw_ops,
+        .fd = fd,
+    };
+}
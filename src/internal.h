@@ -3,45 +3,89 @@
 #include <stdint.h>
 #include <endian.h>
 #include <stddef.h>
+#include <sys/types.h>
 
 struct eizo_handle;
+typedef struct sd_device sd_device;
 enum eizo_result : int;
+enum eizo_pid : uint16_t;
+enum eizo_open_flags : unsigned;
+enum eizo_log_level : unsigned;
+
+// Static tracepoints of the libeizo provider for bpftrace or perf, a nop
+// until one is attached. Every probe on a report passes the usage, report
+// id, counter, length and result, the latter is 0 on start probes.
+#ifdef EIZO_HAVE_SDT
+#include <sys/sdt.h>
+#define EIZO_TRACE(name, usage, report_id, counter, len, res) \
+    STAP_PROBE5(libeizo, name, (uint32_t)(usage), (uint8_t)(report_id), (uint16_t)(counter), (size_t)(len), (int)(res))
+#else
+#define EIZO_TRACE(name, usage, report_id, counter, len, res) do {} while (0)
+#endif
+
+// Messages above this level are compiled out, see the log_level build
+// option. Callers of the macros include eizo/log.h.
+#ifndef EIZO_LOG_BUILD_LEVEL
+#define EIZO_LOG_BUILD_LEVEL 3
+#endif
+
+[[gnu::format(printf, 3, 4)]]
+void
+eizo_log(enum eizo_log_level level, const char *func, const char *fmt, ...);
+
+#define eizo_log_at(level, ...) \
+    do { \
+        if ((level) <= EIZO_LOG_BUILD_LEVEL) { \
+            eizo_log((level), __func__, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define eizo_log_error(...) eizo_log_at(EIZO_LOG_ERROR, __VA_ARGS__)
+#define eizo_log_warning(...) eizo_log_at(EIZO_LOG_WARNING, __VA_ARGS__)
+#define eizo_log_info(...) eizo_log_at(EIZO_LOG_INFO, __VA_ARGS__)
+#define eizo_log_debug(...) eizo_log_at(EIZO_LOG_DEBUG, __VA_ARGS__)
 
 // Assume 256 bytes for now, which seems to be the limit for this report.
 constexpr size_t EIZO_FF300009_MAX_SIZE = 256;
 
+// The firmware version is read through the short get report, which
+// carries at most 32 bytes of value.
+constexpr size_t EIZO_FIRMWARE_VERSION_SIZE = 32;
+
 enum eizo_ff300009_key : uint8_t {
     EIZO_FF300009_KEY_RESOLUTION = 0x4c,
     EIZO_FF300009_KEY_END = 0xff,
 };
 
+// The trailing comments describe the value of a usage, usage_table.py
+// turns them into the usage metadata table.
 enum eizo_usage : uint32_t {
-    EIZO_USAGE_VOLUME                       = 0x000c00e0,
+    EIZO_USAGE_VOLUME                       = 0x000c00e0, // u8
 
-    EIZO_USAGE_BRIGHTNESS                   = 0x00820010,
-    EIZO_USAGE_CONTRAST                     = 0x00820012,
-    EIZO_USAGE_GAIN_RED                     = 0x00820016,
-    EIZO_USAGE_GAIN_GREEN                   = 0x00820018,
-    EIZO_USAGE_GAIN_BLUE                    = 0x0082001a,
+    EIZO_USAGE_BRIGHTNESS                   = 0x00820010, // u16
+    EIZO_USAGE_CONTRAST                     = 0x00820012, // u16
+    EIZO_USAGE_GAIN_RED                     = 0x00820016, // u16
+    EIZO_USAGE_GAIN_GREEN                   = 0x00820018, // u16
+    EIZO_USAGE_GAIN_BLUE                    = 0x0082001a, // u16
     EIZO_USAGE_HORIZONTAL_POSITION          = 0x00820020,
     EIZO_USAGE_VERTICAL_POSITION            = 0x00820030,
     EIZO_USAGE_HORIZONTAL_FREQUENCY         = 0x008200ac,
     EIZO_USAGE_VERTICAL_FREQUENCY           = 0x008200ae,
     EIZO_USAGE_SETTINGS                     = 0x008200B0,
 
-    EIZO_USAGE_COLOR_TEMPERATURE            = 0xff000007,
+    EIZO_USAGE_COLOR_TEMPERATURE            = 0xff000007, // u8 eizo_color_temperature
     EIZO_USAGE_FF000009_OPTIONS             = 0xff000009,
-    EIZO_USAGE_OSD_INDICATOR                = 0xff00000f,
-    EIZO_USAGE_PROFILE                      = 0xff000015,
-    EIZO_USAGE_VSYNC_MODE                   = 0xff00002f,
-    EIZO_USAGE_EEPROM_ADDRESS               = 0xff000030,
-    EIZO_USAGE_EEPROM_DATA                  = 0xff000031,
+    EIZO_USAGE_OSD_INDICATOR                = 0xff00000f, // u16
+    EIZO_USAGE_PROFILE                      = 0xff000015, // u8 eizo_profile
+    EIZO_USAGE_VSYNC_MODE                   = 0xff00002f, // u8 eizo_vsync_mode
+    EIZO_USAGE_EEPROM_ADDRESS               = 0xff000030, // u16
+    EIZO_USAGE_EEPROM_DATA                  = 0xff000031, // u16
     EIZO_USAGE_SERIAL_PRODUCT_STRING_1      = 0xff000035,
-    EIZO_USAGE_USAGE_TIME                   = 0xff000037,
+    EIZO_USAGE_USAGE_TIME                   = 0xff000037, // u24
     EIZO_USAGE_USAGE_TIME2                  = 0xff000047,
     EIZO_USAGE_RC_SELF_DIAGNOSIS            = 0xff00004e,
     EIZO_USAGE_RC_SELF_COMPENSATION_TARGET  = 0xff00004f,
-    EIZO_USAGE_GAMMA                        = 0xff000066,
+    EIZO_USAGE_GAMMA                        = 0xff000066, // u8 eizo_gamma
     EIZO_USAGE_6_COLORS_RED_HUE             = 0xff000067,
     EIZO_USAGE_6_COLORS_GREEN_HUE           = 0xff000068,
     EIZO_USAGE_6_COLORS_BLUE_HUE            = 0xff000069,
@@ -58,14 +102,14 @@ enum eizo_usage : uint32_t {
     EIZO_USAGE_RC_SELF_COMPENSATION_BRIGHTNESS_PARAM = 0xff000077,
     EIZO_USAGE_RC_SELF_COMPENSATION_COLOR_BALANCE = 0xff000078,
     EIZO_USAGE_MONO_MODEL_LUT_SELECT        = 0xff00007b,
-    EIZO_USAGE_DESTINATION                  = 0xff00007c,
+    EIZO_USAGE_DESTINATION                  = 0xff00007c, // u8 eizo_destination
     EIZO_USAGE_6_COLORS_LIGHTNESS           = 0xff00007f,
     EIZO_USAGE_PHOTO_GAIN                   = 0xff000081,
     EIZO_USAGE_TEST_RED                     = 0xff000089,
     EIZO_USAGE_TEST_GREEN                   = 0xff00008a,
     EIZO_USAGE_TEST_BLUE                    = 0xff00008b,
     EIZO_USAGE_TEST                         = 0xff00008c,
-    EIZO_USAGE_PICTURE_EXPANSION            = 0xff0000a5,
+    EIZO_USAGE_PICTURE_EXPANSION            = 0xff0000a5, // u8 eizo_picture_expansion
     EIZO_USAGE_BORDER_INTENSITY             = 0xff0000a7,
     EIZO_USAGE_OFF_TIMER_ENABLE             = 0xff0000a8,
     EIZO_USAGE_OFF_TIMER_TIME               = 0xff0000aa,
@@ -73,21 +117,21 @@ enum eizo_usage : uint32_t {
     EIZO_USAGE_CHROMATICITY_GREEN_X_Y       = 0xff0000ae,
     EIZO_USAGE_CHROMATICITY_BLUE_X_Y        = 0xff0000af,
     EIZO_USAGE_CHROMATICITY_WHITE_X_Y       = 0xff0000b0,
-    EIZO_USAGE_SATURATION                   = 0xff0000b3,
-    EIZO_USAGE_HUE                          = 0xff0000b4,
-    EIZO_USAGE_POWER                        = 0xff0000b8,
-    EIZO_USAGE_AUTO_ECOVIEW                 = 0xff0000b9,
-    EIZO_USAGE_OSD_LANGUAGE                 = 0xff0000bc,
-    EIZO_USAGE_PRODUCT_STRING               = 0xff0000c3,
+    EIZO_USAGE_SATURATION                   = 0xff0000b3, // s8
+    EIZO_USAGE_HUE                          = 0xff0000b4, // s8
+    EIZO_USAGE_POWER                        = 0xff0000b8, // u8 eizo_power
+    EIZO_USAGE_AUTO_ECOVIEW                 = 0xff0000b9, // u8 eizo_auto_ecoview
+    EIZO_USAGE_OSD_LANGUAGE                 = 0xff0000bc, // u8 eizo_osd_language
+    EIZO_USAGE_PRODUCT_STRING               = 0xff0000c3, // str
     EIZO_USAGE_SRGB_BRIGHT                  = 0xff0000c4,
     EIZO_USAGE_EMERGENCY_POWER              = 0xff0000c5,
-    EIZO_USAGE_INPUT_SIGNAL_MODE            = 0xff0000c9,
+    EIZO_USAGE_INPUT_SIGNAL_MODE            = 0xff0000c9, // u8 eizo_input_signal_mode
     EIZO_USAGE_HORIZONTAL_RESOLUTION        = 0xff0000ca,
     EIZO_USAGE_VERTICAL_RESOLUTION          = 0xff0000cb,
     EIZO_USAGE_UNKNOWN_KEY_VALUE_PAIRS_1    = 0xff0000ce,
-    EIZO_USAGE_POWER_LED                    = 0xff0000d3,
-    EIZO_USAGE_BOOT_LOGO                    = 0xff0000d4,
-    EIZO_USAGE_FIRMWARE_VERSION             = 0xff0000d8,
+    EIZO_USAGE_POWER_LED                    = 0xff0000d3, // u8 eizo_power_led
+    EIZO_USAGE_BOOT_LOGO                    = 0xff0000d4, // u8 eizo_boot_logo
+    EIZO_USAGE_FIRMWARE_VERSION             = 0xff0000d8, // str
     EIZO_USAGE_ENABLE_DC5V_OUTPUT           = 0xff0000d9,
     EIZO_USAGE_UDI                          = 0xff0000e5,
     EIZO_USAGE_FLAVOR                       = 0xff0000f2,
@@ -100,30 +144,30 @@ enum eizo_usage : uint32_t {
     EIZO_USAGE_MODE_OF_OUTPUT_SEGMENT       = 0xff0000fa,
 
     EIZO_USAGE_BRIGHT_REG_OP                = 0xff010007,
-    EIZO_USAGE_ECOVIEW_SENSOR               = 0xff01000c,
+    EIZO_USAGE_ECOVIEW_SENSOR               = 0xff01000c, // u8
     EIZO_USAGE_MONITOR_DIRECTION            = 0xff010031,
-    EIZO_USAGE_TEMPERATURE_1                = 0xff01003a,
+    EIZO_USAGE_TEMPERATURE_1                = 0xff01003a, // s8
     EIZO_USAGE_SIGNAL_TYPE_SELECTION        = 0xff01003b,
-    EIZO_USAGE_BUTTON                       = 0xff01003d,
-    EIZO_USAGE_SPLIT_DISPLAY_MODE           = 0xff010040,
-    EIZO_USAGE_OSD_KEY_LOCK                 = 0xff010044,
-    EIZO_USAGE_OSD_ALL_KEY_LOCK             = 0xff010045,
-    EIZO_USAGE_INPUT_PORT                   = 0xff010048,
+    EIZO_USAGE_BUTTON                       = 0xff01003d, // u8 eizo_button
+    EIZO_USAGE_SPLIT_DISPLAY_MODE           = 0xff010040, // u8 eizo_split_display_mode
+    EIZO_USAGE_OSD_KEY_LOCK                 = 0xff010044, // u8 eizo_osd_key_lock
+    EIZO_USAGE_OSD_ALL_KEY_LOCK             = 0xff010045, // u8 eizo_osd_all_key_lock
+    EIZO_USAGE_INPUT_PORT                   = 0xff010048, // u16 eizo_input_port
     EIZO_USAGE_FIX_COLOR_BANDING            = 0xff010049,
-    EIZO_USAGE_OVERDRIVE                    = 0xff01004a,
+    EIZO_USAGE_OVERDRIVE                    = 0xff01004a, // u8 eizo_overdrive
     EIZO_USAGE_GAMUT_INDEX                  = 0xff01004f,
     EIZO_USAGE_SYSTEM_CHROMATICITY          = 0xff010050,
     EIZO_USAGE_SYSTEM_CHROMATICITY_ROLLBACK = 0xff010051,
     EIZO_USAGE_COLOR_DISABLE                = 0xff010052,
-    EIZO_USAGE_AUTO_INPUT                   = 0xff010053,
-    EIZO_USAGE_POWER_SAVE                   = 0xff010054,
+    EIZO_USAGE_AUTO_INPUT                   = 0xff010053, // u8 eizo_auto_input
+    EIZO_USAGE_POWER_SAVE                   = 0xff010054, // u8 eizo_power_save
     EIZO_USAGE_TEMPERATURE_2                = 0xff010055,
     EIZO_USAGE_SUBPIXEL_DRIVE               = 0xff010056,
     EIZO_USAGE_AUTO_ECOVIEW_SETTINGS        = 0xff010057,
-    EIZO_USAGE_EV_AVAILABLE_CUSTOM_KEY_LOCK_OFFSET_SIZE = 0xff010058,
+    EIZO_USAGE_EV_AVAILABLE_CUSTOM_KEY_LOCK_OFFSET_SIZE = 0xff010058, // raw4
     EIZO_USAGE_EV_AVAILABLE_CUSTOM_KEY_LOCK_DATA = 0xff010059,
-    EIZO_USAGE_EV_CUSTOM_KEY_LOCK           = 0xff01005a,
-    EIZO_USAGE_SUPER_RESOLUTION             = 0xff01005b,
+    EIZO_USAGE_EV_CUSTOM_KEY_LOCK           = 0xff01005a, // raw6
+    EIZO_USAGE_SUPER_RESOLUTION             = 0xff01005b, // u8 eizo_super_resolution
     EIZO_USAGE_DUE_BRIGHT_IMPROVE_SETTING   = 0xff01005d,
     EIZO_USAGE_SIGNAL_INFORMATION           = 0xff010060,
     EIZO_USAGE_PIXEL_ERROR_ANALYZER         = 0xff010061,
@@ -131,7 +175,7 @@ enum eizo_usage : uint32_t {
     EIZO_USAGE_CANDELA_1                    = 0xff010065,
     EIZO_USAGE_CANDELA_PARAMETER            = 0xff010066,
     EIZO_USAGE_MAX_CANDELA                  = 0xff010067,
-    EIZO_USAGE_USB_POWER_SAVE               = 0xff010068,
+    EIZO_USAGE_USB_POWER_SAVE               = 0xff010068, // u8 eizo_usb_power_save
     EIZO_USAGE_DUE_PRIORITY                 = 0xff010069,
     EIZO_USAGE_REGISTERED_LICENSE           = 0xff01006a,
     EIZO_USAGE_RANGE_EXTENSION_SETTING      = 0xff01006b,
@@ -139,9 +183,9 @@ enum eizo_usage : uint32_t {
     EIZO_USAGE_2ND_POWER_OFF_TIME           = 0xff01006d,
     EIZO_USAGE_POWER_SAVE_TIME              = 0xff01006e,
     EIZO_USAGE_KEY_PUSH_COUNT               = 0xff01006f,
-    EIZO_USAGE_USB_POWER_DELIVERY           = 0xff010072,
-    EIZO_USAGE_USB_SELECTION                = 0xff010073,
-    EIZO_USAGE_KVM_SWITCH                   = 0xff010074,
+    EIZO_USAGE_USB_POWER_DELIVERY           = 0xff010072, // u8 eizo_usb_power_delivery
+    EIZO_USAGE_USB_SELECTION                = 0xff010073, // u8
+    EIZO_USAGE_KVM_SWITCH                   = 0xff010074, // u8
     EIZO_USAGE_PIP_SHORTCUT_KEY_VISIBLE     = 0xff010075,
     EIZO_USAGE_RC_SIGNAL_SELECT_SUPPORT_MODE = 0xff010076,
     EIZO_USAGE_HYBRID_GAMMA_PIXEL           = 0xff010077,
@@ -161,15 +205,15 @@ enum eizo_usage : uint32_t {
     EIZO_USAGE_BLACK_LEVEL                  = 0xff0100cd,
     EIZO_USAGE_SAFE_AREA_MARKER             = 0xff0100ce,
     EIZO_USAGE_3D_LUT_SELECTION             = 0xff0100cf,
-    EIZO_USAGE_COLOR_MATRIX_32              = 0xff0100d8,
-    EIZO_USAGE_ECOVIEW_OPTIMIZER_V2         = 0xff0100eb,
-    EIZO_USAGE_EV_ACTIVE_WINDOW             = 0xff0100f9,
-    EIZO_USAGE_EV_PICTURE_BY_PICTURE_LAYOUT = 0xff0100fa,
+    EIZO_USAGE_COLOR_MATRIX_32              = 0xff0100d8, // raw36
+    EIZO_USAGE_ECOVIEW_OPTIMIZER_V2         = 0xff0100eb, // u8 eizo_ecoview_optimizer_v2
+    EIZO_USAGE_EV_ACTIVE_WINDOW             = 0xff0100f9, // u8 eizo_window
+    EIZO_USAGE_EV_PICTURE_BY_PICTURE_LAYOUT = 0xff0100fa, // u8 eizo_pbp_layout
     EIZO_USAGE_WHOLE_WINDOW_COLOR_SETTING   = 0xff0100fb,
-    EIZO_USAGE_WINDOW_HIGHLIGHT             = 0xff0100fc,
+    EIZO_USAGE_WINDOW_HIGHLIGHT             = 0xff0100fc, // u8 eizo_window_highlight
     EIZO_USAGE_MONOCHROME_CONVERSION        = 0xff0100fd,
-    EIZO_USAGE_COMPATABILITY_MODE           = 0xff0100fe,
-    EIZO_USAGE_OSD_ROTATION                 = 0xff0100ff,
+    EIZO_USAGE_COMPATABILITY_MODE           = 0xff0100fe, // u8 eizo_compatibility_mode
+    EIZO_USAGE_OSD_ROTATION                 = 0xff0100ff, // u8 eizo_osd_rotation
     EIZO_USAGE_TARGET_SELECTION             = 0xff010100,
     EIZO_USAGE_LAYOUT                       = 0xff010101,
     EIZO_USAGE_OUTPUT_SEGMENT               = 0xff010103,
@@ -178,7 +222,7 @@ enum eizo_usage : uint32_t {
     EIZO_USAGE_SIGNAL_INFO_FRAME            = 0xff01010a,
     EIZO_USAGE_CANDELA_OSD_RANGE_HDR        = 0xff01010b,
     EIZO_USAGE_CANDELA_2                    = 0xff01010c,
-    EIZO_USAGE_FRONT_LUT                    = 0xff01010f,
+    EIZO_USAGE_FRONT_LUT                    = 0xff01010f, // raw512
     EIZO_USAGE_DIAGONAL_FREQUENCY           = 0xff010111,
     EIZO_USAGE_FRONT_KEY_SHORTCUT           = 0xff010112,
     EIZO_USAGE_HLG_SYSTEM_GAMMA             = 0xff010114,
@@ -191,22 +235,22 @@ enum eizo_usage : uint32_t {
     EIZO_USAGE_SYNC_SIGNAL_ENABLE           = 0xff01011e,
     EIZO_USAGE_INSTANT_BRIGHTNESS_BOOSTER   = 0xff010121,
 
-    EIZO_USAGE_DEBUG_MODE                   = 0xff020006,
-    EIZO_USAGE_FRONT_LUT_ENABLED            = 0xff02000d,
+    EIZO_USAGE_DEBUG_MODE                   = 0xff020006, // u8 eizo_debug_mode
+    EIZO_USAGE_FRONT_LUT_ENABLED            = 0xff02000d, // u8
     EIZO_USAGE_DUE_ENABLED                  = 0xff02000e,
     EIZO_USAGE_MAX_CANDELA_ROLLBACK         = 0xff02001f,
     EIZO_USAGE_COLOR_MATRIX_ENABLE          = 0xff02002b,
     EIZO_USAGE_BACKLIGHT_REPLACE_INFO_1     = 0xff02002e,
-    EIZO_USAGE_EDID                         = 0xff020034,
-    EIZO_USAGE_SERIAL_STRING                = 0xff020036,
+    EIZO_USAGE_EDID                         = 0xff020034, // raw256
+    EIZO_USAGE_SERIAL_STRING                = 0xff020036, // str8
     EIZO_USAGE_EDID_DDC_WRITE               = 0xff020037,
     EIZO_USAGE_BACKLIGHT_REPLACE_INFO_2     = 0xff02003f,
-    EIZO_USAGE_AGING_MODE                   = 0xff020044,
+    EIZO_USAGE_AGING_MODE                   = 0xff020044, // u8 eizo_aging_mode
     EIZO_USAGE_GAMMA_TC_STATUS              = 0xff020047,
     EIZO_USAGE_GAMMA_TC_PARAMETER           = 0xff020048,
     EIZO_USAGE_DUE_TC_STATUS                = 0xff020049,
     EIZO_USAGE_FACTORY_PANEL_LUMINANCE      = 0xff020055,
-    EIZO_USAGE_REAR_LUT                     = 0xff020082,
+    EIZO_USAGE_REAR_LUT                     = 0xff020082, // raw512
     EIZO_USAGE_GAIN_DEFINITION_UNKNOWN      = 0xff0200dc,
     EIZO_USAGE_GAIN_DEFINITION_DATA         = 0xff0200dd,
     EIZO_USAGE_ADJUSTMENT_ID                = 0xff020100,
@@ -235,8 +279,8 @@ enum eizo_usage : uint32_t {
     EIZO_USAGE_SELF_SCHEDULE_MENU_LOCK      = 0xff0300a0,
 
     EIZO_USAGE_ACC_SENSOR_DATA              = 0xff100030,
-    EIZO_USAGE_ECOVIEW_SENSE_TIME           = 0xff100044,
-    EIZO_USAGE_ECOVIEW_SENSE_POWER_STATE    = 0xff100045,
+    EIZO_USAGE_ECOVIEW_SENSE_TIME           = 0xff100044, // u8 eizo_ecoview_sense_time
+    EIZO_USAGE_ECOVIEW_SENSE_POWER_STATE    = 0xff100045, // u8 eizo_ecoview_sense_power_state
     EIZO_USAGE_TEMPERATURE_3                = 0xff100070,
     EIZO_USAGE_TEMPERATURE_4                = 0xff100072,
     EIZO_USAGE_HAS_SENSOR                   = 0xff1000f0,
@@ -246,13 +290,13 @@ enum eizo_usage : uint32_t {
     EIZO_USAGE_SELF_TARGET_PAIRING          = 0xff230027,
     EIZO_USAGE_SELF_TARGET_ENABLE           = 0xff23002a,
 
-    EIZO_USAGE_SECONDARY_DESCRIPTOR         = 0xff300001,
+    EIZO_USAGE_SECONDARY_DESCRIPTOR         = 0xff300001, // raw516
     EIZO_USAGE_SET_VALUE                    = 0xff300002,
     EIZO_USAGE_GET_VALUE                    = 0xff300003,
     EIZO_USAGE_SET_VALUE_V2                 = 0xff300004,
     EIZO_USAGE_GET_VALUE_V2                 = 0xff300005,
-    EIZO_USAGE_HANDLE_COUNTER               = 0xff300006,
-    EIZO_USAGE_VERIFY_LAST_REQUEST          = 0xff300007,
+    EIZO_USAGE_HANDLE_COUNTER               = 0xff300006, // u16
+    EIZO_USAGE_VERIFY_LAST_REQUEST          = 0xff300007, // raw7
     EIZO_USAGE_SERIAL_PRODUCT_STRING_2      = 0xff300008,
     EIZO_USAGE_UNKNOWN_KEY_VALUE_PAIRS_2    = 0xff300009,
 
@@ -351,11 +395,146 @@ struct eizo_control {
     enum eizo_usage usage;
     int32_t logical_minimum;
     int32_t logical_maximum;
-    uint32_t report_id;
-    uint32_t report_size;
-    uint32_t report_count;
+    uint16_t report_count;
+    uint8_t report_id;
+    uint8_t report_size;
+};
+
+// The controls of a descriptor, one array per field, all of them carved
+// out of a single block of n * EIZO_CONTROL_ENTRY_SIZE bytes. Lookups
+// only ever touch usage.
+struct eizo_control_table {
+    size_t n;
+    enum eizo_usage *usage;
+    int32_t *logical_minimum;
+    int32_t *logical_maximum;
+    uint16_t *report_count;
+    uint8_t *report_id;
+    uint8_t *report_size;
+};
+
+constexpr size_t EIZO_CONTROL_ENTRY_SIZE = sizeof(enum eizo_usage) + 2 * sizeof(int32_t) + sizeof(uint16_t) + 2 * sizeof(uint8_t);
+
+// Usages cluster in a handful of pages, so every page gets a dense table
+// from usage id to control. The standard pages are below 0x100 and the
+// vendor pages above 0xff00, which gives a direct map from page to table.
+// Lookups are three dependent loads.
+constexpr size_t EIZO_CONTROL_INDEX_MAX_PAGES = 16;
+constexpr size_t EIZO_CONTROL_INDEX_PAGE_KEYS = 512;
+
+// Pages whose usages are spread wider than this leave the table on binary
+// search instead.
+constexpr size_t EIZO_CONTROL_INDEX_MAX_SPAN = 1024;
+
+struct eizo_control_page {
+    uint32_t page;
+    uint32_t first;
+    uint32_t span;
+    // Index into the control table plus one, 0 for usages not present.
+    uint16_t *slot;
+};
+
+struct eizo_control_index {
+    size_t n_pages;
+    struct eizo_control_page pages[EIZO_CONTROL_INDEX_MAX_PAGES];
+    // Index into pages plus one, 0 for pages without controls.
+    uint8_t page_map[EIZO_CONTROL_INDEX_PAGE_KEYS];
+    uint16_t *slots;
 };
 
+static inline uint32_t
+eizo_control_page_key(uint32_t page)
+{
+    return (page & 0xff) | (uint32_t)(page >= 0xff00) << 8;
+}
+
+// A control table together with its index. Tables parsed from a
+// descriptor are shared by every handle of a monitor with the same pid
+// and descriptor, see controls.c.
+struct eizo_controls {
+    struct eizo_control_table table;
+    struct eizo_control_index index;
+    struct eizo_controls *next;
+    unsigned refs;
+    bool pooled;
+    uint16_t pid;
+    uint32_t hash;
+    size_t desc_len;
+    uint8_t *desc;
+};
+
+struct eizo_transport;
+
+// Everything a handle needs from the device. get_feature and set_feature
+// behave like HIDIOCGFEATURE and HIDIOCSFEATURE, read must not block and
+// fails with EAGAIN if no input report is queued.
+struct eizo_transport_ops {
+    int (*get_feature)(struct eizo_transport *t, void *buf, size_t len);
+    int (*set_feature)(struct eizo_transport *t, const void *buf, size_t len);
+    ssize_t (*read)(struct eizo_transport *t, void *buf, size_t len);
+    int (*get_devinfo)(struct eizo_transport *t, uint16_t *vendor, uint16_t *product);
+    int (*get_report_descriptor)(struct eizo_transport *t, uint8_t *buf, size_t *len);
+    void (*close)(struct eizo_transport *t);
+};
+
+struct eizo_transport {
+    const struct eizo_transport_ops *ops;
+    void *data;
+    // Becomes readable when an input report is queued.
+    int fd;
+    bool nonblock;
+};
+
+struct eizo_cache_map {
+    void *addr;
+    size_t size;
+    const void *block;
+    size_t n_ctrl;
+};
+
+// Point the arrays of t into block. The widest fields come first, so
+// every array is naturally aligned if block is.
+static inline void
+eizo_control_table_init(struct eizo_control_table *t, void *block, size_t n)
+{
+    uint8_t *p = block;
+    t->n = n;
+    t->usage = (enum eizo_usage *)p;
+    p += n * sizeof(enum eizo_usage);
+    t->logical_minimum = (int32_t *)p;
+    p += n * sizeof(int32_t);
+    t->logical_maximum = (int32_t *)p;
+    p += n * sizeof(int32_t);
+    t->report_count = (uint16_t *)p;
+    p += n * sizeof(uint16_t);
+    t->report_id = p;
+    p += n;
+    t->report_size = p;
+}
+
+static inline struct eizo_control
+eizo_control_get(const struct eizo_control_table *t, size_t i)
+{
+    return (struct eizo_control) {
+        .usage = t->usage[i],
+        .logical_minimum = t->logical_minimum[i],
+        .logical_maximum = t->logical_maximum[i],
+        .report_count = t->report_count[i],
+        .report_id = t->report_id[i],
+        .report_size = t->report_size[i],
+    };
+}
+
+// Size in bytes of the value behind a control, or 0 if it is not byte aligned.
+static inline size_t
+eizo_control_size(const struct eizo_control *ctrl)
+{
+    if (ctrl->report_size % 8 != 0) {
+        return 0;
+    }
+    return (ctrl->report_size / 8) * ctrl->report_count;
+}
+
 static inline uint32_t
 eizo_swap_usage(uint32_t value)
 {
@@ -368,23 +547,162 @@ eizo_swap_usage(uint32_t value)
 #endif
 }
 
-const struct eizo_control *
-eizo_control_find(const struct eizo_handle *handle, enum eizo_usage usage);
+// Copy the control of usage into ctrl, which may be null. Returns false if
+// the monitor has no such control.
+bool
+eizo_control_find(struct eizo_handle *handle, enum eizo_usage usage, struct eizo_control *ctrl);
 
 size_t
-eizo_get_controls(const struct eizo_handle *handle, const struct eizo_control **ctrl);
+eizo_get_controls(struct eizo_handle *handle, const struct eizo_control_table **table);
+
+enum eizo_value_format : uint8_t {
+    EIZO_VALUE_FORMAT_RAW,
+    EIZO_VALUE_FORMAT_UNSIGNED,
+    EIZO_VALUE_FORMAT_SIGNED,
+    EIZO_VALUE_FORMAT_STRING,
+};
+
+struct eizo_enum_value {
+    uint32_t value;
+    const char *name;
+};
+
+// What is known about a usage, generated from the annotations of enum
+// eizo_usage by usage_table.py.
+struct eizo_usage_info {
+    enum eizo_usage usage;
+    const char *name;
+    // Expected size of the value in bytes, 0 if unknown or variable.
+    uint16_t size;
+    enum eizo_value_format format;
+    // The enum the value maps to, e.g. "enum eizo_gamma", and its values
+    // sorted by value.
+    const char *type;
+    const struct eizo_enum_value *values;
+    size_t n_values;
+};
+
+struct eizo_perfect_hash {
+    const int32_t *seed;
+    const uint16_t *slot;
+};
+
+struct eizo_usage_table {
+    // Sorted by usage.
+    const struct eizo_usage_info *info;
+    size_t n;
+    struct eizo_perfect_hash by_usage;
+    struct eizo_perfect_hash by_name;
+};
+
+extern const struct eizo_usage_table eizo_usage_table;
+
+const struct eizo_usage_info *
+eizo_usage_get_info(enum eizo_usage usage);
+
+// Look up a usage by its name without the EIZO_USAGE_ prefix, ignoring
+// case.
+const struct eizo_usage_info *
+eizo_usage_from_string(const char *name);
 
 const char *
 eizo_usage_to_string(enum eizo_usage usage);
 
+// Format value the way info describes it, like snprintf. Without info the
+// value is printed as hex.
+int
+eizo_usage_format_value(
+    const struct eizo_usage_info *info,
+    const uint8_t *value,
+    size_t len,
+    char *buf,
+    size_t size);
+
 enum eizo_result
 eizo_get_secondary_descriptor(struct eizo_handle *handle, uint8_t *dst, size_t *size);
 
+// Read several usages in one call. The value size of every usage is taken
+// from the control table, lens holds the capacity of each buffer on input
+// and the number of bytes read on output. Returns EIZO_INCOMPLETE if any
+// of the reads failed, see results for the individual outcome.
+enum eizo_result
+eizo_get_values(
+    struct eizo_handle *handle,
+    const enum eizo_usage *usages,
+    size_t n,
+    uint8_t *const *values,
+    size_t *lens,
+    enum eizo_result *results);
+
+// How long a request keeps the monitor busy. Short ones may go in between
+// the steps of a long one, see eizo_io_yield().
+enum eizo_io_kind : uint8_t {
+    EIZO_IO_SHORT,
+    EIZO_IO_LONG,
+};
+
+typedef enum eizo_result (*eizo_io_fn)(struct eizo_handle *handle, void *arg);
+
+// Run fn as one request, for a sequence of reports that must not be
+// interleaved with others, e.g. an EEPROM address followed by its data.
+// With EIZO_OPEN_IO_WORKER fn is queued for the I/O thread of the handle,
+// otherwise it runs on the calling thread under the io lock. Either way
+// fn is said to hold the io lock.
+enum eizo_result
+eizo_io_run(struct eizo_handle *handle, enum eizo_io_kind kind, eizo_io_fn fn, void *arg);
+
+// Called by long requests between steps that others may go in between.
+// Runs the short requests queued by now, and returns true if there were
+// any. Only the I/O thread ever has some.
+bool
+eizo_io_yield(struct eizo_handle *handle);
+
+// Like eizo_get_value and eizo_set_value, but bypass the value cache and
+// write coalescing. The caller must hold the io lock.
+enum eizo_result
+eizo_get_value_raw(struct eizo_handle *handle, enum eizo_usage usage, uint8_t *value, size_t len);
+
 enum eizo_result
-eizo_get_value(struct eizo_handle *handle, enum eizo_usage usage, uint8_t *value, size_t len);
+eizo_set_value_raw(struct eizo_handle *handle, enum eizo_usage usage, uint8_t *value, size_t len);
 
+// Single verified get or set through a caller provided report, see
+// eizo_get_value_raw. Only the first len bytes of r->value are used.
 enum eizo_result
-eizo_set_value(struct eizo_handle *handle, enum eizo_usage usage, uint8_t *value, size_t len);
+eizo_get_report(struct eizo_handle *handle, struct eizo_value_report *r, enum eizo_usage usage, size_t len);
+
+enum eizo_result
+eizo_set_report(struct eizo_handle *handle, struct eizo_value_report *r, enum eizo_usage usage, size_t len);
+
+// Get request that sends the first arg_len bytes of r->value as argument.
+enum eizo_result
+eizo_query_report(
+    struct eizo_handle *handle,
+    struct eizo_value_report *r,
+    enum eizo_usage usage,
+    size_t len,
+    size_t arg_len);
+
+// Acquire a new handle counter after another client took over the monitor.
+// The caller must hold the io lock.
+enum eizo_result
+eizo_refresh_counter(struct eizo_handle *handle);
+
+// The counter requests are currently sent with. It changes every time
+// another client took over the monitor in between.
+uint16_t
+eizo_current_counter(struct eizo_handle *handle);
+
+// Last known contents of a LUT, a single allocation that is freed together
+// with the handle.
+struct eizo_lut_shadow;
+
+struct eizo_lut_shadow **
+eizo_lut_shadow(struct eizo_handle *handle, unsigned lut);
+
+// Forget the LUT shadows if setting usage makes the monitor load other
+// LUTs, like switching the profile. The caller holds the io lock.
+void
+eizo_invalidate_luts_for(struct eizo_handle *handle, enum eizo_usage usage);
 
 enum eizo_result
 eizo_get_ff300009(struct eizo_handle *handle, uint8_t *info, int *size);
@@ -392,9 +710,116 @@ eizo_get_ff300009(struct eizo_handle *handle, uint8_t *info, int *size);
 enum eizo_result
 eizo_get_available_custom_key_lock_raw(struct eizo_handle *handle, uint8_t **ptr, size_t *len);
 
+void
+eizo_hidraw_transport_init(struct eizo_transport *t, int fd);
+
+// Create a handle on top of t. The handle takes ownership of the
+// transport, which is closed on failure as well.
+enum eizo_result
+eizo_new_transport(const struct eizo_transport *t, enum eizo_open_flags flags, struct eizo_handle **handle);
+
+// Transfer of an object larger than a single report, through a usage that
+// holds a 16 bit offset and size, and a data usage whose value is a 16 bit
+// offset followed by the payload at that offset. Requests that fail are
+// retried from the last good offset, after eizo_transfer_read or
+// eizo_transfer_write failed they can be called again to continue at pos.
+//
+// Without an offset/size usage the data usage is self addressed: every
+// get request carries the offset it wants, every set the offset it
+// writes. The size of the object is then up to the caller.
+//
+// The caller must hold the io lock, the position on the monitor is shared
+// with everyone else talking to it. Short requests queued for the I/O
+// thread are still served between two pages.
+struct eizo_transfer {
+    // 0 for a self addressed data usage.
+    enum eizo_usage offset_size;
+    enum eizo_usage data;
+    size_t size;
+    size_t pos;
+    // Payload bytes per data report.
+    size_t page;
+    // Offset the monitor continues at, SIZE_MAX if unknown.
+    size_t device_pos;
+};
+
+// Prepare t and query the size of the object.
+enum eizo_result
+eizo_transfer_begin(
+    struct eizo_handle *handle,
+    struct eizo_transfer *t,
+    enum eizo_usage offset_size,
+    enum eizo_usage data);
+
+// Read the object into buf, which must hold t->size bytes.
+enum eizo_result
+eizo_transfer_read(struct eizo_handle *handle, struct eizo_transfer *t, uint8_t *buf);
+
+// Write the len bytes of buf as the whole object. Continues at pos if
+// the previous write of the same length failed, starts over otherwise.
+enum eizo_result
+eizo_transfer_write(struct eizo_handle *handle, struct eizo_transfer *t, const uint8_t *buf, size_t len);
+
+// Write only len bytes at offset of the object in buf, which holds all
+// t->size bytes of it.
+enum eizo_result
+eizo_transfer_write_range(
+    struct eizo_handle *handle,
+    struct eizo_transfer *t,
+    const uint8_t *buf,
+    size_t offset,
+    size_t len);
+
+// Check if device sits on an Eizo usb device, and return its pid.
+bool
+eizo_device_get_pid(sd_device *device, enum eizo_pid *pid);
+
+enum eizo_result
+eizo_cache_load(
+    enum eizo_pid pid,
+    unsigned long serial,
+    const uint8_t firmware[EIZO_FIRMWARE_VERSION_SIZE],
+    struct eizo_cache_map *map);
+
+enum eizo_result
+eizo_cache_store(
+    enum eizo_pid pid,
+    unsigned long serial,
+    const uint8_t firmware[EIZO_FIRMWARE_VERSION_SIZE],
+    const struct eizo_control_table *table);
+
+void
+eizo_cache_unmap(struct eizo_cache_map *map);
+
+uint32_t
+eizo_crc32(const uint8_t *data, size_t len);
+
+// Take a reference on the controls of desc, parsing it only if no other
+// handle of a monitor with the same pid and descriptor holds them.
+enum eizo_result
+eizo_controls_acquire(
+    enum eizo_pid pid,
+    const uint8_t *desc,
+    size_t len,
+    struct eizo_controls **ctrl);
+
+// Wrap a sorted table that lives in block, which the caller keeps alive.
+// These are never shared.
+enum eizo_result
+eizo_controls_wrap(const void *block, size_t n, struct eizo_controls **ctrl);
+
+void
+eizo_controls_release(struct eizo_controls *ctrl);
+
+// Most feature controls a descriptor may have.
+constexpr size_t EIZO_MAX_CONTROLS = 256;
+
+// Parse the feature controls of desc into table. table->n is the capacity
+// on entry and the number of controls on return, if table->usage is null
+// they are only counted. Returns EIZO_INCOMPLETE if there are more than
+// the capacity, or more than EIZO_MAX_CONTROLS.
 enum eizo_result
 eizo_parse_descriptor(
     const uint8_t *desc,
     size_t desc_len,
-    struct eizo_control *control,
-    size_t *control_len);
+    struct eizo_control_table *table);
@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include <pthread.h>
+
+#include "eizo/handle.h"
+#include "eizo/log.h"
+#include "internal.h"
+
+// A message as it is kept in the ring.
+struct eizo_log_record {
+    alignas(uint64_t) uint32_t level;
+    uint32_t reserved;
+    const char *func;
+    char msg[240];
+};
+
+constexpr size_t EIZO_LOG_WORDS = sizeof(struct eizo_log_record) / sizeof(uint64_t);
+static_assert(sizeof(struct eizo_log_record) % sizeof(uint64_t) == 0);
+
+// Writers claim message n by bumping eizo_log_head and write it to slot
+// n % EIZO_LOG_RING_SIZE as relaxed atomic words. seq is 2n + 1 while
+// they do, and 2n + 2 once the message is complete, so a reader can tell
+// both a torn and an overwritten slot apart from message n.
+struct eizo_log_slot {
+    _Atomic uint64_t seq;
+    _Atomic uint64_t data[EIZO_LOG_WORDS];
+};
+
+static struct eizo_log_slot eizo_log_ring[EIZO_LOG_RING_SIZE];
+static _Atomic uint64_t eizo_log_head;
+static atomic_bool eizo_log_ring_enabled;
+
+static _Atomic unsigned eizo_log_max_level = EIZO_LOG_INFO;
+
+static pthread_mutex_t eizo_log_lock = PTHREAD_MUTEX_INITIALIZER;
+static eizo_log_callback eizo_log_cb;
+static void *eizo_log_userdata;
+
+void
+eizo_set_log_callback(eizo_log_callback cb, void *userdata)
+{
+    pthread_mutex_lock(&eizo_log_lock);
+    eizo_log_cb = cb;
+    eizo_log_userdata = userdata;
+    pthread_mutex_unlock(&eizo_log_lock);
+}
+
+void
+eizo_set_log_level(enum eizo_log_level level)
+{
+    atomic_store_explicit(&eizo_log_max_level, level, memory_order_relaxed);
+}
+
+void
+eizo_set_log_ring(bool enabled)
+{
+    atomic_store_explicit(&eizo_log_ring_enabled, enabled, memory_order_relaxed);
+}
+
+static void
+eizo_log_ring_push(const struct eizo_log_record *rec)
+{
+    uint64_t data[EIZO_LOG_WORDS];
+    memcpy(data, rec, sizeof(data));
+
+    uint64_t n = atomic_fetch_add_explicit(&eizo_log_head, 1, memory_order_relaxed);
+    struct eizo_log_slot *slot = &eizo_log_ring[n % EIZO_LOG_RING_SIZE];
+
+    atomic_store_explicit(&slot->seq, 2 * n + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    for (size_t i = 0; i < EIZO_LOG_WORDS; ++i) {
+        atomic_store_explicit(&slot->data[i], data[i], memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&slot->seq, 2 * n + 2, memory_order_release);
+}
+
+void
+eizo_dump_log_ring(eizo_log_callback cb, void *userdata)
+{
+    uint64_t head = atomic_load_explicit(&eizo_log_head, memory_order_acquire);
+    uint64_t n = head > EIZO_LOG_RING_SIZE ? head - EIZO_LOG_RING_SIZE : 0;
+
+    for (; n < head; ++n) {
+        struct eizo_log_slot *slot = &eizo_log_ring[n % EIZO_LOG_RING_SIZE];
+
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != 2 * n + 2) {
+            continue;
+        }
+
+        uint64_t data[EIZO_LOG_WORDS];
+        for (size_t i = 0; i < EIZO_LOG_WORDS; ++i) {
+            data[i] = atomic_load_explicit(&slot->data[i], memory_order_relaxed);
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != 2 * n + 2) {
+            continue;
+        }
+
+        struct eizo_log_record rec;
+        memcpy(&rec, data, sizeof(rec));
+        cb(rec.level, rec.func, rec.msg, userdata);
+    }
+}
+
+void
+eizo_log(enum eizo_log_level level, const char *func, const char *fmt, ...)
+{
+    if (level > atomic_load_explicit(&eizo_log_max_level, memory_order_relaxed)) {
+        return;
+    }
+
+    struct eizo_log_record rec = { .level = level, .func = func };
+
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(rec.msg, sizeof(rec.msg), fmt, ap);
+    va_end(ap);
+
+    if (atomic_load_explicit(&eizo_log_ring_enabled, memory_order_relaxed)) {
+        eizo_log_ring_push(&rec);
+        return;
+    }
+
+    // The callback runs without the lock, so it may log itself or replace
+    // the callback.
+    pthread_mutex_lock(&eizo_log_lock);
+    eizo_log_callback cb = eizo_log_cb;
+    void *userdata = eizo_log_userdata;
+    pthread_mutex_unlock(&eizo_log_lock);
+
+    if (cb) {
+        cb(level, func, rec.msg, userdata);
+    } else {
+        fprintf(stderr, "%s: %s\n", func, rec.msg);
+    }
+}
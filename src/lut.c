@@ -0,0 +1,375 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory.h>
+
+#include "eizo/handle.h"
+#include "eizo/log.h"
+#include "eizo/lut.h"
+#include "internal.h"
+
+// A LUT is read and written as one object of planar red, green and blue
+// channels, every entry a little endian 16 bit value where 0xffff is full
+// scale. The data usage is self addressed, see struct eizo_transfer.
+constexpr size_t EIZO_LUT_CHANNELS = 3;
+constexpr size_t EIZO_LUT_SIZE = EIZO_LUT_CHANNELS * EIZO_LUT_ENTRIES * sizeof(uint16_t);
+
+// Matrix entries are signed 16.16 fixed point.
+constexpr size_t EIZO_COLOR_MATRIX_SIZE = 9 * sizeof(int32_t);
+constexpr int32_t EIZO_COLOR_MATRIX_ONE = 1 << 16;
+
+struct eizo_lut_shadow {
+    bool valid;
+    // Counter of the handle when data was last known to match the monitor.
+    uint16_t counter;
+    uint16_t data[EIZO_LUT_CHANNELS * EIZO_LUT_ENTRIES];
+};
+
+static const enum eizo_usage eizo_lut_usage[] = {
+    [EIZO_LUT_FRONT] = EIZO_USAGE_FRONT_LUT,
+    [EIZO_LUT_REAR] = EIZO_USAGE_REAR_LUT,
+};
+
+// Kept free of branches and calls, so the compiler turns it into vector
+// code. NaN ends up as 0.
+static void
+eizo_lut_quantize(const float *in, uint16_t *out)
+{
+    for (size_t i = 0; i < EIZO_LUT_ENTRIES; ++i) {
+        float x = in[i];
+        x = x >= 0.0f ? x : 0.0f;
+        x = x <= 1.0f ? x : 1.0f;
+        out[i] = htole16((uint16_t)(x * 65535.0f + 0.5f));
+    }
+}
+
+static void
+eizo_lut_dequantize(const uint16_t *in, float *out)
+{
+    for (size_t i = 0; i < EIZO_LUT_ENTRIES; ++i) {
+        out[i] = (float)le16toh(in[i]) * (1.0f / 65535.0f);
+    }
+}
+
+static struct eizo_lut_shadow *
+eizo_lut_get_shadow(struct eizo_handle *handle, enum eizo_lut lut)
+{
+    struct eizo_lut_shadow **shadow = eizo_lut_shadow(handle, lut);
+    if (!*shadow) {
+        *shadow = calloc(1, sizeof(**shadow));
+    }
+    return *shadow;
+}
+
+struct eizo_lut_args {
+    enum eizo_lut lut;
+    uint16_t *data;
+    size_t pages;
+};
+
+static enum eizo_result
+eizo_read_lut_locked(struct eizo_handle *handle, void *arg)
+{
+    struct eizo_lut_args *a = arg;
+    enum eizo_lut lut = a->lut;
+    uint16_t *data = a->data;
+
+    struct eizo_transfer t;
+    uint16_t counter = eizo_current_counter(handle);
+    enum eizo_result res = eizo_transfer_begin(handle, &t, 0, eizo_lut_usage[lut]);
+    if (res >= EIZO_SUCCESS) {
+        t.size = EIZO_LUT_SIZE;
+        res = eizo_transfer_read(handle, &t, (uint8_t *)data);
+    }
+
+    // Only a read without anyone else in between is a consistent picture.
+    struct eizo_lut_shadow *shadow = eizo_lut_get_shadow(handle, lut);
+    if (res >= EIZO_SUCCESS && shadow && counter == eizo_current_counter(handle)) {
+        memcpy(shadow->data, data, EIZO_LUT_SIZE);
+        shadow->counter = counter;
+        shadow->valid = true;
+    }
+
+    return res;
+}
+
+enum eizo_result
+eizo_read_lut(struct eizo_handle *handle, enum eizo_lut lut, float *red, float *green, float *blue)
+{
+    if (lut > EIZO_LUT_REAR) {
+        return EIZO_ERROR_INVALID_ARGUMENT;
+    }
+
+    uint16_t data[EIZO_LUT_CHANNELS * EIZO_LUT_ENTRIES];
+    struct eizo_lut_args a = { .lut = lut, .data = data };
+    enum eizo_result res = eizo_io_run(handle, EIZO_IO_LONG, eizo_read_lut_locked, &a);
+    if (res < EIZO_SUCCESS) {
+        return res;
+    }
+
+    eizo_lut_dequantize(data, red);
+    eizo_lut_dequantize(data + EIZO_LUT_ENTRIES, green);
+    eizo_lut_dequantize(data + 2 * EIZO_LUT_ENTRIES, blue);
+    return EIZO_SUCCESS;
+}
+
+// Read back one page the upload would skip and compare it with the shadow.
+// Another client or the OSD may have changed the LUT without the handle
+// noticing, known is cleared then. Nothing is read if no page is skipped.
+static enum eizo_result
+eizo_lut_confirm(
+    struct eizo_handle *handle,
+    const struct eizo_transfer *t,
+    const uint8_t *data,
+    const uint8_t *shadow,
+    bool *known)
+{
+    size_t offset = 0;
+    size_t len = 0;
+    for (; offset < EIZO_LUT_SIZE; offset += t->page) {
+        len = EIZO_LUT_SIZE - offset;
+        if (len > t->page) {
+            len = t->page;
+        }
+        if (memcmp(data + offset, shadow + offset, len) == 0) {
+            break;
+        }
+    }
+    if (offset >= EIZO_LUT_SIZE) {
+        return EIZO_SUCCESS;
+    }
+
+    uint8_t buf[EIZO_LUT_SIZE];
+    struct eizo_transfer c = *t;
+    c.pos = offset;
+    c.size = offset + len;
+
+    uint16_t counter = eizo_current_counter(handle);
+    enum eizo_result res = eizo_transfer_read(handle, &c, buf);
+    if (res < EIZO_SUCCESS) {
+        return res;
+    }
+
+    *known = counter == eizo_current_counter(handle) && memcmp(buf + offset, shadow + offset, len) == 0;
+    if (!*known) {
+        eizo_log_debug("LUT changed behind the handle's back, uploading all of it.");
+    }
+    return EIZO_SUCCESS;
+}
+
+// Upload every page of data that differs from known, or all of them if
+// known is null. Adjacent pages go out as one range.
+static enum eizo_result
+eizo_lut_upload(
+    struct eizo_handle *handle,
+    struct eizo_transfer *t,
+    const uint8_t *data,
+    const uint8_t *known,
+    size_t *pages)
+{
+    size_t n = (EIZO_LUT_SIZE + t->page - 1) / t->page;
+    size_t start = SIZE_MAX;
+
+    for (size_t k = 0; k <= n; ++k) {
+        size_t offset = k * t->page;
+        if (offset > EIZO_LUT_SIZE) {
+            offset = EIZO_LUT_SIZE;
+        }
+
+        if (k < n) {
+            size_t len = EIZO_LUT_SIZE - offset;
+            if (len > t->page) {
+                len = t->page;
+            }
+            if (!known || memcmp(data + offset, known + offset, len) != 0) {
+                if (start == SIZE_MAX) {
+                    start = offset;
+                }
+                continue;
+            }
+        }
+
+        if (start == SIZE_MAX) {
+            continue;
+        }
+
+        enum eizo_result res = eizo_transfer_write_range(handle, t, data, start, offset - start);
+        *pages += (t->pos - start + t->page - 1) / t->page;
+        if (res < EIZO_SUCCESS) {
+            return res;
+        }
+        start = SIZE_MAX;
+    }
+
+    return EIZO_SUCCESS;
+}
+
+static enum eizo_result
+eizo_write_lut_locked(struct eizo_handle *handle, void *arg)
+{
+    struct eizo_lut_args *a = arg;
+    enum eizo_lut lut = a->lut;
+    const uint16_t *data = a->data;
+    size_t *pages = &a->pages;
+
+    struct eizo_lut_shadow *shadow = eizo_lut_get_shadow(handle, lut);
+    if (!shadow) {
+        return EIZO_ERROR_NO_MEMORY;
+    }
+
+    struct eizo_transfer t;
+    enum eizo_result res = eizo_transfer_begin(handle, &t, 0, eizo_lut_usage[lut]);
+    if (res < EIZO_SUCCESS) {
+        return res;
+    }
+    t.size = EIZO_LUT_SIZE;
+
+    // Another client may have written the LUT since the shadow was taken,
+    // it is only trusted as long as the handle kept its counter and the
+    // monitor still agrees with it.
+    uint16_t counter = eizo_current_counter(handle);
+    bool known = shadow->valid && shadow->counter == counter;
+    shadow->valid = false;
+
+    if (known) {
+        res = eizo_lut_confirm(handle, &t, (const uint8_t *)data, (const uint8_t *)shadow->data, &known);
+        if (res < EIZO_SUCCESS) {
+            return res;
+        }
+    }
+
+    res = eizo_lut_upload(
+        handle, &t, (const uint8_t *)data, known ? (const uint8_t *)shadow->data : nullptr, pages);
+
+    // Someone took over the monitor during the upload, so the pages that
+    // were skipped can't be trusted either.
+    if (res >= EIZO_SUCCESS && known && counter != eizo_current_counter(handle)) {
+        res = eizo_lut_upload(handle, &t, (const uint8_t *)data, nullptr, pages);
+    }
+
+    if (res < EIZO_SUCCESS) {
+        return res;
+    }
+
+    memcpy(shadow->data, data, EIZO_LUT_SIZE);
+    shadow->counter = eizo_current_counter(handle);
+    shadow->valid = true;
+    return EIZO_SUCCESS;
+}
+
+enum eizo_result
+eizo_write_lut(
+    struct eizo_handle *handle,
+    enum eizo_lut lut,
+    const float *red,
+    const float *green,
+    const float *blue,
+    size_t *pages)
+{
+    if (lut > EIZO_LUT_REAR) {
+        return EIZO_ERROR_INVALID_ARGUMENT;
+    }
+
+    uint16_t data[EIZO_LUT_CHANNELS * EIZO_LUT_ENTRIES];
+    eizo_lut_quantize(red, data);
+    eizo_lut_quantize(green, data + EIZO_LUT_ENTRIES);
+    eizo_lut_quantize(blue, data + 2 * EIZO_LUT_ENTRIES);
+
+    struct eizo_lut_args a = { .lut = lut, .data = data };
+    enum eizo_result res = eizo_io_run(handle, EIZO_IO_LONG, eizo_write_lut_locked, &a);
+
+    if (pages) {
+        *pages = a.pages;
+    }
+    return res;
+}
+
+static enum eizo_result
+eizo_invalidate_lut_locked(struct eizo_handle *handle, void *arg)
+{
+    struct eizo_lut_shadow *shadow = *eizo_lut_shadow(handle, *(enum eizo_lut *)arg);
+    if (shadow) {
+        shadow->valid = false;
+    }
+    return EIZO_SUCCESS;
+}
+
+void
+eizo_invalidate_luts_for(struct eizo_handle *handle, enum eizo_usage usage)
+{
+    switch (usage) {
+        case EIZO_USAGE_SETTINGS:
+        case EIZO_USAGE_PROFILE:
+        case EIZO_USAGE_SYSTEM_CHROMATICITY_ROLLBACK:
+        case EIZO_USAGE_FACTORY_RESET:
+        case EIZO_USAGE_COPY_CALIBRATION_DATA:
+        case EIZO_USAGE_SELF_QC_CALIBRATION:
+        case EIZO_USAGE_SELF_CORRECTION:
+            break;
+        default:
+            return;
+    }
+
+    for (enum eizo_lut lut = EIZO_LUT_FRONT; lut <= EIZO_LUT_REAR; ++lut) {
+        eizo_invalidate_lut_locked(handle, &lut);
+    }
+}
+
+void
+eizo_invalidate_lut(struct eizo_handle *handle, enum eizo_lut lut)
+{
+    if (lut > EIZO_LUT_REAR) {
+        return;
+    }
+
+    eizo_io_run(handle, EIZO_IO_SHORT, eizo_invalidate_lut_locked, &lut);
+}
+
+enum eizo_result
+eizo_get_front_lut_enabled(struct eizo_handle *handle, bool *enabled)
+{
+    uint8_t value = 0;
+    enum eizo_result res = eizo_get_value(handle, EIZO_USAGE_FRONT_LUT_ENABLED, &value, 1);
+    if (res >= EIZO_SUCCESS) {
+        *enabled = value != 0;
+    }
+    return res;
+}
+
+enum eizo_result
+eizo_set_front_lut_enabled(struct eizo_handle *handle, bool enabled)
+{
+    uint8_t value = enabled;
+    return eizo_set_value(handle, EIZO_USAGE_FRONT_LUT_ENABLED, &value, 1);
+}
+
+enum eizo_result
+eizo_get_color_matrix(struct eizo_handle *handle, float matrix[9])
+{
+    int32_t value[9];
+    enum eizo_result res = eizo_get_value(
+        handle, EIZO_USAGE_COLOR_MATRIX_32, (uint8_t *)value, EIZO_COLOR_MATRIX_SIZE);
+    if (res < EIZO_SUCCESS) {
+        return res;
+    }
+
+    for (size_t i = 0; i < 9; ++i) {
+        matrix[i] = (float)(int32_t)le32toh((uint32_t)value[i]) / EIZO_COLOR_MATRIX_ONE;
+    }
+    return EIZO_SUCCESS;
+}
+
+enum eizo_result
+eizo_set_color_matrix(struct eizo_handle *handle, const float matrix[9])
+{
+    int32_t value[9];
+    for (size_t i = 0; i < 9; ++i) {
+        float x = matrix[i];
+        if (!(x >= -32768.0f && x <= 32767.0f)) {
+            return EIZO_ERROR_OUT_OF_RANGE;
+        }
+        x *= EIZO_COLOR_MATRIX_ONE;
+        value[i] = (int32_t)htole32((uint32_t)(int32_t)(x + (x < 0.0f ? -0.5f : 0.5f)));
+    }
+
+    return eizo_set_value(handle, EIZO_USAGE_COLOR_MATRIX_32, (uint8_t *)value, EIZO_COLOR_MATRIX_SIZE);
+}
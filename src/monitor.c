@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+
+#include <systemd/sd-device.h>
+#include <systemd/sd-event.h>
+
+#include "eizo/handle.h"
+#include "eizo/monitor.h"
+#include "eizo/log.h"
+#include "internal.h"
+
+enum eizo_monitor_state {
+    EIZO_MONITOR_STATE_OPENING,
+    EIZO_MONITOR_STATE_READY,
+    EIZO_MONITOR_STATE_REMOVED,
+};
+
+struct eizo_monitor_device {
+    struct eizo_monitor_device *next;
+    struct eizo_monitor *monitor;
+    char *syspath;
+    char *devname;
+    enum eizo_monitor_state state;
+    bool done;
+    bool joined;
+    pthread_t thread;
+    eizo_handle_t handle;
+};
+
+struct eizo_monitor {
+    sd_event *event;
+    sd_device_monitor *device_monitor;
+    sd_event_source *done_source;
+    int done_fd;
+    enum eizo_open_flags flags;
+    eizo_monitor_callback add_cb;
+    eizo_monitor_callback remove_cb;
+    void *userdata;
+    pthread_mutex_t lock;
+    struct eizo_monitor_device *devices;
+};
+
+static void
+eizo_monitor_device_free(struct eizo_monitor_device *dev)
+{
+    free(dev->syspath);
+    free(dev->devname);
+    free(dev);
+}
+
+static void *
+eizo_monitor_open_thread(void *arg)
+{
+    struct eizo_monitor_device *dev = arg;
+    struct eizo_monitor *m = dev->monitor;
+
+    eizo_handle_t handle = nullptr;
+    enum eizo_result res = eizo_open_ex(dev->devname, m->flags, &handle);
+    if (res < EIZO_SUCCESS) {
+        eizo_log_warning("failed to open %s. %i", dev->devname, res);
+    }
+
+    pthread_mutex_lock(&m->lock);
+    dev->handle = handle;
+    dev->done = true;
+    pthread_mutex_unlock(&m->lock);
+
+    // Wake the event loop, the add callback is delivered from there.
+    uint64_t one = 1;
+    if (write(m->done_fd, &one, sizeof(one)) < 0) {
+        eizo_log_error("failed to signal completion. %s", strerror(errno));
+    }
+    return nullptr;
+}
+
+static void
+eizo_monitor_add(struct eizo_monitor *m, sd_device *device)
+{
+    const char *syspath = nullptr, *devname = nullptr;
+    if (sd_device_get_syspath(device, &syspath) < 0 ||
+        sd_device_get_devname(device, &devname) < 0) {
+        return;
+    }
+
+    for (struct eizo_monitor_device *dev = m->devices; dev; dev = dev->next) {
+        if (dev->state != EIZO_MONITOR_STATE_REMOVED && strcmp(dev->syspath, syspath) == 0) {
+            return;
+        }
+    }
+
+    if (!eizo_device_get_pid(device, nullptr)) {
+        return;
+    }
+
+    struct eizo_monitor_device *dev = calloc(1, sizeof(*dev));
+    if (!dev) {
+        return;
+    }
+
+    dev->monitor = m;
+    dev->syspath = strdup(syspath);
+    dev->devname = strdup(devname);
+    dev->state = EIZO_MONITOR_STATE_OPENING;
+    if (!dev->syspath || !dev->devname) {
+        eizo_monitor_device_free(dev);
+        return;
+    }
+
+    if (pthread_create(&dev->thread, nullptr, eizo_monitor_open_thread, dev) != 0) {
+        eizo_log_error("failed to start open of %s.", devname);
+        eizo_monitor_device_free(dev);
+        return;
+    }
+
+    pthread_mutex_lock(&m->lock);
+    dev->next = m->devices;
+    m->devices = dev;
+    pthread_mutex_unlock(&m->lock);
+}
+
+static void
+eizo_monitor_remove(struct eizo_monitor *m, sd_device *device)
+{
+    const char *syspath = nullptr;
+    if (sd_device_get_syspath(device, &syspath) < 0) {
+        return;
+    }
+
+    for (struct eizo_monitor_device *dev = m->devices; dev; dev = dev->next) {
+        if (dev->state == EIZO_MONITOR_STATE_REMOVED || strcmp(dev->syspath, syspath) != 0) {
+            continue;
+        }
+
+        // A device that is still being opened is reaped once the open
+        // thread is done, without ever being announced.
+        if (dev->state == EIZO_MONITOR_STATE_READY && m->remove_cb) {
+            m->remove_cb(m, dev->handle, dev->devname, m->userdata);
+        }
+        dev->state = EIZO_MONITOR_STATE_REMOVED;
+    }
+
+    // Kick the reaper for devices that were ready.
+    uint64_t one = 1;
+    if (write(m->done_fd, &one, sizeof(one)) < 0) {
+        eizo_log_error("failed to signal removal. %s", strerror(errno));
+    }
+}
+
+static int
+eizo_monitor_on_done(sd_event_source *, int fd, uint32_t, void *userdata)
+{
+    struct eizo_monitor *m = userdata;
+
+    uint64_t count;
+    if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        return -errno;
+    }
+
+    pthread_mutex_lock(&m->lock);
+    struct eizo_monitor_device **pp = &m->devices;
+    while (*pp) {
+        struct eizo_monitor_device *dev = *pp;
+
+        if (!dev->done) {
+            pp = &dev->next;
+            continue;
+        }
+
+        if (!dev->joined) {
+            pthread_join(dev->thread, nullptr);
+            dev->joined = true;
+        }
+
+        if (dev->state == EIZO_MONITOR_STATE_OPENING) {
+            if (dev->handle) {
+                dev->state = EIZO_MONITOR_STATE_READY;
+                pthread_mutex_unlock(&m->lock);
+                if (m->add_cb) {
+                    m->add_cb(m, dev->handle, dev->devname, m->userdata);
+                }
+                pthread_mutex_lock(&m->lock);
+                // The callback may have changed the list, start over.
+                pp = &m->devices;
+                continue;
+            }
+            dev->state = EIZO_MONITOR_STATE_REMOVED;
+        }
+
+        if (dev->state != EIZO_MONITOR_STATE_REMOVED) {
+            pp = &dev->next;
+            continue;
+        }
+
+        *pp = dev->next;
+        if (dev->handle) {
+            eizo_close(dev->handle);
+        }
+        eizo_monitor_device_free(dev);
+    }
+    pthread_mutex_unlock(&m->lock);
+
+    return 0;
+}
+
+static int
+eizo_monitor_on_uevent(sd_device_monitor *, sd_device *device, void *userdata)
+{
+    struct eizo_monitor *m = userdata;
+
+    sd_device_action_t action;
+    if (sd_device_get_action(device, &action) < 0) {
+        return 0;
+    }
+
+    switch (action) {
+        case SD_DEVICE_ADD:
+            eizo_monitor_add(m, device);
+            break;
+        case SD_DEVICE_REMOVE:
+            eizo_monitor_remove(m, device);
+            break;
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+static enum eizo_result
+eizo_monitor_enumerate(struct eizo_monitor *m)
+{
+    [[gnu::cleanup(sd_device_enumerator_unrefp)]]
+    sd_device_enumerator *enumerator = nullptr;
+
+    int ret = sd_device_enumerator_new(&enumerator);
+    if (ret < 0) {
+        return EIZO_ERROR_NO_MEMORY;
+    }
+
+    ret = sd_device_enumerator_add_match_subsystem(enumerator, "hidraw", true);
+    if (ret < 0) {
+        return EIZO_ERROR_UNKNOWN;
+    }
+
+    for (sd_device *device = sd_device_enumerator_get_device_first(enumerator);
+         device;
+         device = sd_device_enumerator_get_device_next(enumerator))
+    {
+        eizo_monitor_add(m, device);
+    }
+
+    return EIZO_SUCCESS;
+}
+
+enum eizo_result
+eizo_monitor_new(
+    sd_event *event,
+    enum eizo_open_flags flags,
+    eizo_monitor_callback add_cb,
+    eizo_monitor_callback remove_cb,
+    void *userdata,
+    struct eizo_monitor **monitor)
+{
+    struct eizo_monitor *m = calloc(1, sizeof(*m));
+    if (!m) {
+        return EIZO_ERROR_NO_MEMORY;
+    }
+
+    m->event = sd_event_ref(event);
+    m->done_fd = -1;
+    m->flags = flags;
+    m->add_cb = add_cb;
+    m->remove_cb = remove_cb;
+    m->userdata = userdata;
+    pthread_mutex_init(&m->lock, nullptr);
+
+    enum eizo_result res = EIZO_ERROR_UNKNOWN;
+
+    m->done_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m->done_fd < 0) {
+        res = EIZO_ERROR_IO;
+        goto err;
+    }
+
+    if (sd_event_add_io(event, &m->done_source, m->done_fd, EPOLLIN, eizo_monitor_on_done, m) < 0) {
+        goto err;
+    }
+
+    // Start listening before enumerating, so no device that shows up in
+    // between is missed. Duplicates are filtered by syspath.
+    if (sd_device_monitor_new(&m->device_monitor) < 0 ||
+        sd_device_monitor_filter_add_match_subsystem_devtype(m->device_monitor, "hidraw", nullptr) < 0 ||
+        sd_device_monitor_attach_event(m->device_monitor, event) < 0 ||
+        sd_device_monitor_start(m->device_monitor, eizo_monitor_on_uevent, m) < 0)
+    {
+        goto err;
+    }
+
+    res = eizo_monitor_enumerate(m);
+    if (res < EIZO_SUCCESS) {
+        goto err;
+    }
+
+    *monitor = m;
+    return EIZO_SUCCESS;
+
+err:
+    eizo_monitor_free(m);
+    return res;
+}
+
+void
+eizo_monitor_free(struct eizo_monitor *monitor)
+{
+    if (monitor->device_monitor) {
+        sd_device_monitor_stop(monitor->device_monitor);
+        sd_device_monitor_unref(monitor->device_monitor);
+    }
+
+    // Handles are closed without calling the remove callback.
+    struct eizo_monitor_device *dev = monitor->devices;
+    while (dev) {
+        struct eizo_monitor_device *next = dev->next;
+        if (!dev->joined) {
+            pthread_join(dev->thread, nullptr);
+        }
+        if (dev->handle) {
+            eizo_close(dev->handle);
+        }
+        eizo_monitor_device_free(dev);
+        dev = next;
+    }
+
+    sd_event_source_disable_unref(monitor->done_source);
+    if (monitor->done_fd >= 0) {
+        close(monitor->done_fd);
+    }
+    sd_event_unref(monitor->event);
+    pthread_mutex_destroy(&monitor->lock);
+    free(monitor);
+}
+
+size_t
+eizo_monitor_get_handles(struct eizo_monitor *monitor, eizo_handle_t *handles, size_t n)
+{
+    size_t count = 0;
+    for (struct eizo_monitor_device *dev = monitor->devices; dev; dev = dev->next) {
+        if (dev->state != EIZO_MONITOR_STATE_READY) {
+            continue;
+        }
+        if (count < n) {
+            handles[count] = dev->handle;
+        }
+        ++count;
+    }
+    return count;
+}
@@ -0,0 +1,388 @@
+// memfd_create and file seals.
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdatomic.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include "eizo/handle.h"
+#include "eizo/snapshot.h"
+#include "eizo/log.h"
+#include "internal.h"
+
+// Layout of the shared memory. A slot is written as words of relaxed
+// atomics between two increments of seq, which is odd in between. A
+// reader that sees the same even seq before and after its copy got a
+// consistent one. generation is bumped after every update and is the
+// futex readers sleep on, so it works across processes.
+constexpr size_t EIZO_SNAPSHOT_WORDS = sizeof(struct eizo_snapshot_monitor) / sizeof(uint64_t);
+static_assert(sizeof(struct eizo_snapshot_monitor) % sizeof(uint64_t) == 0);
+
+struct eizo_snapshot_slot {
+    _Atomic uint32_t seq;
+    uint32_t reserved;
+    _Atomic uint64_t data[EIZO_SNAPSHOT_WORDS];
+};
+
+struct eizo_snapshot_shm {
+    char     magic[8];
+    uint32_t version;
+    uint32_t slot_size;
+    uint32_t n_slots;
+    _Atomic uint32_t generation;
+    struct eizo_snapshot_slot slots[EIZO_SNAPSHOT_SLOTS];
+};
+
+static const char EIZO_SNAPSHOT_MAGIC[8] = "EIZOSNP";
+constexpr uint32_t EIZO_SNAPSHOT_VERSION = 1;
+
+// Older headers lack it, the seal itself is there since Linux 5.1.
+#ifndef F_SEAL_FUTURE_WRITE
+#define F_SEAL_FUTURE_WRITE 0x0010
+#endif
+
+// Give up on a slot that is still being written after this many tries,
+// the writer may have died halfway.
+constexpr unsigned EIZO_SNAPSHOT_MAX_TRIES = 1000;
+
+struct eizo_snapshot {
+    struct eizo_snapshot_shm *shm;
+    // Only set for the writer.
+    int fd;
+};
+
+// Where the fields of struct eizo_snapshot_monitor come from.
+static const struct {
+    enum eizo_usage usage;
+    enum eizo_snapshot_fields field;
+} eizo_snapshot_usages[] = {
+    { EIZO_USAGE_BRIGHTNESS,    EIZO_SNAPSHOT_BRIGHTNESS },
+    { EIZO_USAGE_CONTRAST,      EIZO_SNAPSHOT_CONTRAST },
+    { EIZO_USAGE_PROFILE,       EIZO_SNAPSHOT_PROFILE },
+    { EIZO_USAGE_INPUT_PORT,    EIZO_SNAPSHOT_INPUT_PORT },
+    { EIZO_USAGE_POWER,         EIZO_SNAPSHOT_POWER },
+    { EIZO_USAGE_TEMPERATURE_1, EIZO_SNAPSHOT_TEMPERATURE_1 },
+    { EIZO_USAGE_TEMPERATURE_2, EIZO_SNAPSHOT_TEMPERATURE_2 },
+    { EIZO_USAGE_TEMPERATURE_3, EIZO_SNAPSHOT_TEMPERATURE_3 },
+    { EIZO_USAGE_TEMPERATURE_4, EIZO_SNAPSHOT_TEMPERATURE_4 },
+    { EIZO_USAGE_USAGE_TIME,    EIZO_SNAPSHOT_USAGE_TIME },
+};
+
+constexpr size_t EIZO_SNAPSHOT_USAGES = sizeof(eizo_snapshot_usages) / sizeof(eizo_snapshot_usages[0]);
+
+// The value as a little endian integer, sign extended if the control has a
+// negative logical minimum.
+static int64_t
+eizo_snapshot_integer(struct eizo_handle *handle, enum eizo_usage usage, const uint8_t *value, size_t len)
+{
+    size_t n = len < sizeof(uint64_t) ? len : sizeof(uint64_t);
+    uint64_t x = 0;
+    for (size_t i = 0; i < n; ++i) {
+        x |= (uint64_t)value[i] << (8 * i);
+    }
+
+    struct eizo_control ctrl;
+    if (n > 0 && n < sizeof(uint64_t) && (value[n - 1] & 0x80)
+        && eizo_control_find(handle, usage, &ctrl) && ctrl.logical_minimum < 0)
+    {
+        x |= ~(uint64_t)0 << (8 * n);
+    }
+    return (int64_t)x;
+}
+
+bool
+eizo_snapshot_monitor_apply(
+    struct eizo_handle *handle,
+    struct eizo_snapshot_monitor *monitor,
+    uint32_t usage,
+    const uint8_t *value,
+    size_t len)
+{
+    enum eizo_snapshot_fields field = 0;
+    for (size_t i = 0; i < EIZO_SNAPSHOT_USAGES; ++i) {
+        if (eizo_snapshot_usages[i].usage == usage) {
+            field = eizo_snapshot_usages[i].field;
+        }
+    }
+    if (!field || len == 0) {
+        return false;
+    }
+
+    int64_t x = eizo_snapshot_integer(handle, usage, value, len);
+
+    switch (field) {
+        case EIZO_SNAPSHOT_BRIGHTNESS:
+            monitor->brightness = (uint16_t)x;
+            break;
+        case EIZO_SNAPSHOT_CONTRAST:
+            monitor->contrast = (uint16_t)x;
+            break;
+        case EIZO_SNAPSHOT_PROFILE:
+            monitor->profile = (uint8_t)x;
+            break;
+        case EIZO_SNAPSHOT_INPUT_PORT:
+            monitor->input_port = (uint16_t)x;
+            break;
+        case EIZO_SNAPSHOT_POWER:
+            monitor->power = (uint8_t)x;
+            break;
+        case EIZO_SNAPSHOT_TEMPERATURE_1:
+            monitor->temperature[0] = (int32_t)x;
+            break;
+        case EIZO_SNAPSHOT_TEMPERATURE_2:
+            monitor->temperature[1] = (int32_t)x;
+            break;
+        case EIZO_SNAPSHOT_TEMPERATURE_3:
+            monitor->temperature[2] = (int32_t)x;
+            break;
+        case EIZO_SNAPSHOT_TEMPERATURE_4:
+            monitor->temperature[3] = (int32_t)x;
+            break;
+        case EIZO_SNAPSHOT_USAGE_TIME:
+            // Hours followed by minutes.
+            if (len < 3) {
+                return false;
+            }
+            monitor->usage_time = (int64_t)(value[0] | value[1] << 8) * 60 + value[2];
+            break;
+        default:
+            return false;
+    }
+
+    monitor->fields |= field;
+    return true;
+}
+
+void
+eizo_snapshot_monitor_refresh(struct eizo_handle *handle, struct eizo_snapshot_monitor *monitor)
+{
+    for (size_t i = 0; i < EIZO_SNAPSHOT_USAGES; ++i) {
+        enum eizo_usage usage = eizo_snapshot_usages[i].usage;
+
+        uint8_t value[32];
+        size_t len = eizo_get_value_size(handle, usage);
+        if (len == 0 || len > sizeof(value)) {
+            continue;
+        }
+
+        if (eizo_get_value(handle, usage, value, len) >= EIZO_SUCCESS) {
+            eizo_snapshot_monitor_apply(handle, monitor, usage, value, len);
+        }
+    }
+}
+
+enum eizo_result
+eizo_snapshot_new(struct eizo_snapshot **snapshot)
+{
+    struct eizo_snapshot *s = calloc(1, sizeof(*s));
+    if (!s) {
+        return EIZO_ERROR_NO_MEMORY;
+    }
+
+    s->fd = memfd_create("eizo-snapshot", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (s->fd < 0) {
+        eizo_log_error("memfd_create failed. %s", strerror(errno));
+        free(s);
+        return EIZO_ERROR_IO;
+    }
+
+    // Readers can rely on the size once it is sealed.
+    if (ftruncate(s->fd, sizeof(*s->shm)) < 0 ||
+        fcntl(s->fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW) < 0)
+    {
+        eizo_log_error("failed to size the memfd. %s", strerror(errno));
+        close(s->fd);
+        free(s);
+        return EIZO_ERROR_IO;
+    }
+
+    void *addr = mmap(nullptr, sizeof(*s->shm), PROT_READ | PROT_WRITE, MAP_SHARED, s->fd, 0);
+    if (addr == MAP_FAILED) {
+        close(s->fd);
+        free(s);
+        return EIZO_ERROR_IO;
+    }
+
+    // The fd is handed to readers as is. From now on only this mapping
+    // can write, nobody can map the fd writable or write to it anymore.
+    if (fcntl(s->fd, F_ADD_SEALS, F_SEAL_FUTURE_WRITE | F_SEAL_SEAL) < 0) {
+        eizo_log_error("failed to seal the memfd. %s", strerror(errno));
+        munmap(addr, sizeof(*s->shm));
+        close(s->fd);
+        free(s);
+        return EIZO_ERROR_IO;
+    }
+
+    s->shm = addr;
+    memcpy(s->shm->magic, EIZO_SNAPSHOT_MAGIC, sizeof(s->shm->magic));
+    s->shm->version = EIZO_SNAPSHOT_VERSION;
+    s->shm->slot_size = sizeof(struct eizo_snapshot_slot);
+    s->shm->n_slots = EIZO_SNAPSHOT_SLOTS;
+
+    *snapshot = s;
+    return EIZO_SUCCESS;
+}
+
+enum eizo_result
+eizo_snapshot_map(int fd, struct eizo_snapshot **snapshot)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        return EIZO_ERROR_IO;
+    }
+    if ((size_t)st.st_size != sizeof(struct eizo_snapshot_shm)) {
+        return EIZO_ERROR_BAD_DATA;
+    }
+
+    struct eizo_snapshot *s = calloc(1, sizeof(*s));
+    if (!s) {
+        return EIZO_ERROR_NO_MEMORY;
+    }
+
+    void *addr = mmap(nullptr, sizeof(*s->shm), PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        free(s);
+        return EIZO_ERROR_IO;
+    }
+
+    s->shm = addr;
+    s->fd = -1;
+
+    if (memcmp(s->shm->magic, EIZO_SNAPSHOT_MAGIC, sizeof(s->shm->magic)) != 0
+        || s->shm->version != EIZO_SNAPSHOT_VERSION
+        || s->shm->slot_size != sizeof(struct eizo_snapshot_slot)
+        || s->shm->n_slots != EIZO_SNAPSHOT_SLOTS)
+    {
+        eizo_snapshot_free(s);
+        return EIZO_ERROR_BAD_DATA;
+    }
+
+    *snapshot = s;
+    return EIZO_SUCCESS;
+}
+
+void
+eizo_snapshot_free(struct eizo_snapshot *snapshot)
+{
+    munmap(snapshot->shm, sizeof(*snapshot->shm));
+    if (snapshot->fd >= 0) {
+        close(snapshot->fd);
+    }
+    free(snapshot);
+}
+
+int
+eizo_snapshot_get_fd(struct eizo_snapshot *snapshot)
+{
+    return snapshot->fd;
+}
+
+enum eizo_result
+eizo_snapshot_update(struct eizo_snapshot *snapshot, size_t slot, const struct eizo_snapshot_monitor *monitor)
+{
+    if (snapshot->fd < 0 || slot >= EIZO_SNAPSHOT_SLOTS) {
+        return EIZO_ERROR_INVALID_ARGUMENT;
+    }
+
+    uint64_t data[EIZO_SNAPSHOT_WORDS] = {};
+    if (monitor) {
+        memcpy(data, monitor, sizeof(*monitor));
+    }
+
+    struct eizo_snapshot_slot *s = &snapshot->shm->slots[slot];
+    uint32_t seq = atomic_load_explicit(&s->seq, memory_order_relaxed);
+    atomic_store_explicit(&s->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    for (size_t i = 0; i < EIZO_SNAPSHOT_WORDS; ++i) {
+        atomic_store_explicit(&s->data[i], data[i], memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&s->seq, seq + 2, memory_order_release);
+
+    atomic_fetch_add_explicit(&snapshot->shm->generation, 1, memory_order_release);
+    syscall(SYS_futex, &snapshot->shm->generation, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    return EIZO_SUCCESS;
+}
+
+enum eizo_result
+eizo_snapshot_read(struct eizo_snapshot *snapshot, size_t slot, struct eizo_snapshot_monitor *monitor)
+{
+    if (slot >= EIZO_SNAPSHOT_SLOTS) {
+        return EIZO_ERROR_INVALID_ARGUMENT;
+    }
+
+    struct eizo_snapshot_slot *s = &snapshot->shm->slots[slot];
+    uint64_t data[EIZO_SNAPSHOT_WORDS];
+
+    for (unsigned tries = 0; tries < EIZO_SNAPSHOT_MAX_TRIES; ++tries) {
+        uint32_t seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+        if (seq & 1) {
+            continue;
+        }
+
+        for (size_t i = 0; i < EIZO_SNAPSHOT_WORDS; ++i) {
+            data[i] = atomic_load_explicit(&s->data[i], memory_order_relaxed);
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&s->seq, memory_order_relaxed) != seq) {
+            continue;
+        }
+
+        memcpy(monitor, data, sizeof(*monitor));
+        return monitor->fields & EIZO_SNAPSHOT_PRESENT ? EIZO_SUCCESS : EIZO_INCOMPLETE;
+    }
+
+    return EIZO_ERROR_RACE_CONDITION;
+}
+
+uint32_t
+eizo_snapshot_get_generation(struct eizo_snapshot *snapshot)
+{
+    return atomic_load_explicit(&snapshot->shm->generation, memory_order_acquire);
+}
+
+enum eizo_result
+eizo_snapshot_wait(struct eizo_snapshot *snapshot, uint32_t generation, int timeout_ms)
+{
+    // FUTEX_WAIT_BITSET takes an absolute CLOCK_MONOTONIC deadline, so
+    // waking up early doesn't extend the wait.
+    struct timespec deadline;
+    if (timeout_ms >= 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    // The generation may have moved on already, the futex then returns
+    // right away with EAGAIN.
+    while (eizo_snapshot_get_generation(snapshot) == generation) {
+        long ret = syscall(
+            SYS_futex, &snapshot->shm->generation, FUTEX_WAIT_BITSET, generation,
+            timeout_ms < 0 ? nullptr : &deadline, nullptr, FUTEX_BITSET_MATCH_ANY);
+        if (ret < 0 && errno == ETIMEDOUT) {
+            return EIZO_INCOMPLETE;
+        }
+        if (ret < 0 && errno != EAGAIN && errno != EINTR) {
+            return EIZO_ERROR_IO;
+        }
+    }
+
+    return EIZO_SUCCESS;
+}
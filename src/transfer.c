@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <memory.h>
+
+#include "eizo/handle.h"
+#include "eizo/log.h"
+#include "internal.h"
+
+// Attempts per page before a transfer gives up. The counter is reacquired
+// after a race, other errors are simply retried.
+constexpr unsigned EIZO_TRANSFER_MAX_RETRIES = 3;
+
+// Every data report starts with the little endian offset of its payload.
+constexpr size_t EIZO_TRANSFER_HEADER_SIZE = 2;
+
+// Move the monitor to pos. Reads leave the size at 0, writes announce the
+// size of the whole object.
+static enum eizo_result
+eizo_transfer_seek(struct eizo_handle *handle, struct eizo_transfer *t, size_t size)
+{
+    struct eizo_value_report r;
+    r.value[0] = (uint8_t)t->pos;
+    r.value[1] = (uint8_t)(t->pos >> 8);
+    r.value[2] = (uint8_t)size;
+    r.value[3] = (uint8_t)(size >> 8);
+
+    enum eizo_result res = eizo_set_report(handle, &r, t->offset_size, 4);
+    if (res >= EIZO_SUCCESS) {
+        t->device_pos = t->pos;
+    }
+    return res;
+}
+
+// Decide whether a failed request is worth another attempt. The monitor's
+// position is unknown afterwards, so the next attempt seeks first.
+static bool
+eizo_transfer_retry(struct eizo_handle *handle, struct eizo_transfer *t, enum eizo_result res, unsigned *retries)
+{
+    if (++*retries > EIZO_TRANSFER_MAX_RETRIES) {
+        return false;
+    }
+
+    t->device_pos = SIZE_MAX;
+
+    switch (res) {
+        case EIZO_ERROR_RACE_CONDITION:
+            return eizo_refresh_counter(handle) >= EIZO_SUCCESS;
+        case EIZO_ERROR_IO:
+        case EIZO_ERROR_BAD_DATA:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Let queued short requests go in between two pages. The position on the
+// monitor is not trusted after that.
+static void
+eizo_transfer_yield(struct eizo_handle *handle, struct eizo_transfer *t)
+{
+    if (eizo_io_yield(handle)) {
+        t->device_pos = SIZE_MAX;
+    }
+}
+
+enum eizo_result
+eizo_transfer_begin(
+    struct eizo_handle *handle,
+    struct eizo_transfer *t,
+    enum eizo_usage offset_size,
+    enum eizo_usage data)
+{
+    memset(t, 0, sizeof(*t));
+    t->offset_size = offset_size;
+    t->data = data;
+    t->device_pos = SIZE_MAX;
+
+    struct eizo_control ctrl;
+    if (!eizo_control_find(handle, data, &ctrl)
+        || (offset_size && !eizo_control_find(handle, offset_size, nullptr)))
+    {
+        return EIZO_ERROR_INVALID_USAGE;
+    }
+
+    // Use all of what the descriptor allows for the data usage, the get and
+    // set reports carry up to 512 bytes.
+    size_t size = eizo_control_size(&ctrl);
+    if (size > 512) {
+        size = 512;
+    }
+    if (size <= EIZO_TRANSFER_HEADER_SIZE) {
+        return EIZO_ERROR_BAD_DATA;
+    }
+    t->page = size - EIZO_TRANSFER_HEADER_SIZE;
+
+    if (!offset_size) {
+        return EIZO_SUCCESS;
+    }
+
+    struct eizo_value_report r;
+    enum eizo_result res;
+    unsigned retries = 0;
+    while ((res = eizo_get_report(handle, &r, offset_size, 4)) < EIZO_SUCCESS) {
+        if (!eizo_transfer_retry(handle, t, res, &retries)) {
+            return res;
+        }
+    }
+
+    t->device_pos = r.value[0] | r.value[1] << 8;
+    t->size = r.value[2] | r.value[3] << 8;
+    return EIZO_SUCCESS;
+}
+
+enum eizo_result
+eizo_transfer_read(struct eizo_handle *handle, struct eizo_transfer *t, uint8_t *buf)
+{
+    struct eizo_value_report r;
+    unsigned retries = 0;
+
+    while (t->pos < t->size) {
+        enum eizo_result res = EIZO_SUCCESS;
+
+        size_t arg_len = 0;
+        if (!t->offset_size) {
+            r.value[0] = (uint8_t)t->pos;
+            r.value[1] = (uint8_t)(t->pos >> 8);
+            arg_len = EIZO_TRANSFER_HEADER_SIZE;
+        } else if (t->device_pos != t->pos) {
+            res = eizo_transfer_seek(handle, t, 0);
+        }
+
+        if (res >= EIZO_SUCCESS) {
+            res = eizo_query_report(handle, &r, t->data, t->page + EIZO_TRANSFER_HEADER_SIZE, arg_len);
+        }
+
+        if (res >= EIZO_SUCCESS) {
+            size_t offset = r.value[0] | r.value[1] << 8;
+            if (offset != t->pos) {
+                eizo_log_debug("Offset %zu != %zu.", offset, t->pos);
+                res = EIZO_ERROR_BAD_DATA;
+            }
+        }
+
+        if (res < EIZO_SUCCESS) {
+            if (!eizo_transfer_retry(handle, t, res, &retries)) {
+                return res;
+            }
+            continue;
+        }
+
+        size_t n = t->size - t->pos;
+        if (n > t->page) {
+            n = t->page;
+        }
+
+        memcpy(buf + t->pos, r.value + EIZO_TRANSFER_HEADER_SIZE, n);
+        t->pos += n;
+        t->device_pos = t->pos;
+        retries = 0;
+
+        eizo_transfer_yield(handle, t);
+    }
+
+    return EIZO_SUCCESS;
+}
+
+// Write the object in buf from pos up to end.
+static enum eizo_result
+eizo_transfer_write_to(struct eizo_handle *handle, struct eizo_transfer *t, const uint8_t *buf, size_t end)
+{
+    struct eizo_value_report r;
+    unsigned retries = 0;
+
+    while (t->pos < end) {
+        enum eizo_result res = EIZO_SUCCESS;
+
+        if (t->offset_size && t->device_pos != t->pos) {
+            res = eizo_transfer_seek(handle, t, t->size);
+        }
+
+        size_t n = end - t->pos;
+        if (n > t->page) {
+            n = t->page;
+        }
+
+        if (res >= EIZO_SUCCESS) {
+            r.value[0] = (uint8_t)t->pos;
+            r.value[1] = (uint8_t)(t->pos >> 8);
+            memcpy(r.value + EIZO_TRANSFER_HEADER_SIZE, buf + t->pos, n);
+            res = eizo_set_report(handle, &r, t->data, n + EIZO_TRANSFER_HEADER_SIZE);
+        }
+
+        if (res < EIZO_SUCCESS) {
+            if (!eizo_transfer_retry(handle, t, res, &retries)) {
+                return res;
+            }
+            continue;
+        }
+
+        t->pos += n;
+        t->device_pos = t->pos;
+        retries = 0;
+
+        eizo_transfer_yield(handle, t);
+    }
+
+    return EIZO_SUCCESS;
+}
+
+enum eizo_result
+eizo_transfer_write(struct eizo_handle *handle, struct eizo_transfer *t, const uint8_t *buf, size_t len)
+{
+    if (len > UINT16_MAX) {
+        return EIZO_ERROR_INVALID_ARGUMENT;
+    }
+
+    // A new write announces its size, a resumed one continues at pos. One
+    // that completed starts over.
+    if (t->pos == 0 || t->pos >= t->size || t->size != len) {
+        t->pos = 0;
+        t->size = len;
+        t->device_pos = SIZE_MAX;
+    }
+
+    return eizo_transfer_write_to(handle, t, buf, t->size);
+}
+
+enum eizo_result
+eizo_transfer_write_range(
+    struct eizo_handle *handle,
+    struct eizo_transfer *t,
+    const uint8_t *buf,
+    size_t offset,
+    size_t len)
+{
+    if (offset > t->size || len > t->size - offset) {
+        return EIZO_ERROR_OUT_OF_RANGE;
+    }
+
+    if (t->pos != offset) {
+        t->pos = offset;
+        t->device_pos = SIZE_MAX;
+    }
+
+    return eizo_transfer_write_to(handle, t, buf, offset + len);
+}
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <memory.h>
+#include <strings.h>
+#include <ctype.h>
+
+#include "internal.h"
+
+// FNV-1a, with the seed folded into the offset basis. usage_table.py
+// builds the tables with the same function.
+static uint32_t
+eizo_usage_hash(uint32_t seed, const uint8_t *data, size_t len, bool fold_case)
+{
+    uint32_t h = 0x811c9dc5 ^ seed;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= fold_case ? (uint8_t)tolower(data[i]) : data[i];
+        h *= 0x01000193;
+    }
+    return h;
+}
+
+// Index into the table of the only entry key can be, the caller still has
+// to compare it.
+static size_t
+eizo_usage_lookup(const struct eizo_perfect_hash *ph, const uint8_t *key, size_t len, bool fold_case)
+{
+    size_t n = eizo_usage_table.n;
+    int32_t seed = ph->seed[eizo_usage_hash(0, key, len, fold_case) % n];
+    size_t slot = seed < 0
+        ? (size_t)(-seed - 1)
+        : eizo_usage_hash((uint32_t)seed, key, len, fold_case) % n;
+    return ph->slot[slot];
+}
+
+const struct eizo_usage_info *
+eizo_usage_get_info(enum eizo_usage usage)
+{
+    uint8_t key[4] = {
+        (uint8_t)usage,
+        (uint8_t)(usage >> 8),
+        (uint8_t)(usage >> 16),
+        (uint8_t)(usage >> 24),
+    };
+
+    const struct eizo_usage_info *info =
+        &eizo_usage_table.info[eizo_usage_lookup(&eizo_usage_table.by_usage, key, 4, false)];
+    return info->usage == usage ? info : nullptr;
+}
+
+const struct eizo_usage_info *
+eizo_usage_from_string(const char *name)
+{
+    const struct eizo_usage_info *info = &eizo_usage_table.info[
+        eizo_usage_lookup(&eizo_usage_table.by_name, (const uint8_t *)name, strlen(name), true)];
+    return strcasecmp(info->name, name) == 0 ? info : nullptr;
+}
+
+const char *
+eizo_usage_to_string(enum eizo_usage usage)
+{
+    const struct eizo_usage_info *info = eizo_usage_get_info(usage);
+    return info ? info->name : nullptr;
+}
+
+static int
+eizo_enum_value_compare(const void *a, const void *b)
+{
+    uint32_t x = ((const struct eizo_enum_value *)a)->value;
+    uint32_t y = ((const struct eizo_enum_value *)b)->value;
+    return (x > y) - (x < y);
+}
+
+struct eizo_format_buffer {
+    char *buf;
+    size_t size;
+    size_t len;
+};
+
+[[gnu::format(printf, 2, 3)]]
+static void
+eizo_format_append(struct eizo_format_buffer *f, const char *fmt, ...)
+{
+    size_t off = f->len < f->size ? f->len : f->size;
+
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(f->buf + off, f->size - off, fmt, ap);
+    va_end(ap);
+
+    if (n > 0) {
+        f->len += (size_t)n;
+    }
+}
+
+int
+eizo_usage_format_value(
+    const struct eizo_usage_info *info,
+    const uint8_t *value,
+    size_t len,
+    char *buf,
+    size_t size)
+{
+    struct eizo_format_buffer f = { buf, size, 0 };
+    if (size > 0) {
+        buf[0] = '\0';
+    }
+
+    enum eizo_value_format format = info ? info->format : EIZO_VALUE_FORMAT_RAW;
+    size_t n = info && info->size && info->size < len ? info->size : len;
+
+    if ((format == EIZO_VALUE_FORMAT_UNSIGNED || format == EIZO_VALUE_FORMAT_SIGNED) && (n == 0 || n > 4)) {
+        format = EIZO_VALUE_FORMAT_RAW;
+    }
+
+    switch (format) {
+        case EIZO_VALUE_FORMAT_UNSIGNED:
+        case EIZO_VALUE_FORMAT_SIGNED: {
+            uint32_t x = 0;
+            for (size_t i = 0; i < n; ++i) {
+                x |= (uint32_t)value[i] << (8 * i);
+            }
+
+            const struct eizo_enum_value key = { .value = x };
+            const struct eizo_enum_value *named = info->values
+                ? bsearch(&key, info->values, info->n_values, sizeof(key), eizo_enum_value_compare)
+                : nullptr;
+            if (named) {
+                eizo_format_append(&f, "%s ", named->name);
+            }
+
+            if (format == EIZO_VALUE_FORMAT_SIGNED) {
+                unsigned shift = 32 - 8 * (unsigned)n;
+                eizo_format_append(&f, named ? "(%i)" : "%i", (int32_t)(x << shift) >> shift);
+            } else {
+                eizo_format_append(&f, named ? "(%u)" : "%u", x);
+            }
+            break;
+        }
+
+        case EIZO_VALUE_FORMAT_STRING:
+            for (size_t i = 0; i < n && value[i] != '\0'; ++i) {
+                eizo_format_append(&f, "%c", isprint(value[i]) ? value[i] : '.');
+            }
+            break;
+
+        case EIZO_VALUE_FORMAT_RAW:
+            for (size_t i = 0; i < n; ++i) {
+                eizo_format_append(&f, "%02w8x", value[i]);
+            }
+            break;
+    }
+
+    return (int)f.len;
+}
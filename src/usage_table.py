@@ -0,0 +1,197 @@
+# Generate the usage metadata table from enum eizo_usage in internal.h.
+#
+# Every usage may carry an annotation in a trailing comment that describes
+# its value, e.g.
+#
+#     EIZO_USAGE_GAMMA = 0xff000066, // u8 eizo_gamma
+#
+# The first word is the format: u8, u16, u24, u32 and s8, s16, s32 for
+# little endian integers, str<N> for strings and raw<N> for anything else.
+# N is the size in bytes and may be left out when it varies. The optional
+# second word names the enum in eizo/control.h that the value maps to.
+#
+# The output has the table sorted by usage, the named values of every enum
+# that is referenced and a perfect hash on the usage and on the name.
+
+import re
+import sys
+
+FNV_PRIME = 0x01000193
+FNV_BASIS = 0x811c9dc5
+
+
+# Must match eizo_usage_hash() in usage.c.
+def fnv(seed, data):
+    h = FNV_BASIS ^ seed
+    for b in data:
+        h ^= b
+        h = (h * FNV_PRIME) & 0xffffffff
+    return h
+
+
+# Hash and displace: keys land in a bucket by their plain hash, every
+# bucket gets a seed that moves its keys to free slots. Buckets with a
+# single key store the slot directly, as -slot - 1.
+def perfect_hash(keys):
+    n = len(keys)
+    buckets = [[] for _ in range(n)]
+    for i, key in enumerate(keys):
+        buckets[fnv(0, key) % n].append(i)
+
+    seeds = [0] * n
+    slots = [None] * n
+    order = sorted(range(n), key=lambda b: -len(buckets[b]))
+
+    for b in order:
+        items = buckets[b]
+        if len(items) <= 1:
+            break
+        seed = 1
+        while True:
+            pos = [fnv(seed, keys[i]) % n for i in items]
+            if len(set(pos)) == len(pos) and all(slots[p] is None for p in pos):
+                break
+            seed += 1
+        seeds[b] = seed
+        for i, p in zip(items, pos):
+            slots[p] = i
+
+    free = [p for p in range(n) if slots[p] is None]
+    for b in order:
+        if len(buckets[b]) == 1:
+            p = free.pop()
+            seeds[b] = -p - 1
+            slots[p] = buckets[b][0]
+
+    return seeds, [s if s is not None else 0 for s in slots]
+
+
+FORMATS = {
+    "u": ("EIZO_VALUE_FORMAT_UNSIGNED", True),
+    "s": ("EIZO_VALUE_FORMAT_SIGNED", True),
+    "str": ("EIZO_VALUE_FORMAT_STRING", False),
+    "raw": ("EIZO_VALUE_FORMAT_RAW", False),
+}
+
+
+def parse_annotation(name, text):
+    if not text:
+        return ("EIZO_VALUE_FORMAT_RAW", 0, None)
+
+    words = text.split()
+    m = re.fullmatch("(u|s|str|raw)([0-9]*)", words[0])
+    if not m or len(words) > 2:
+        sys.exit(f"usage_table.py: bad annotation for {name}: {text}")
+
+    fmt, bits = FORMATS[m.group(1)]
+    size = int(m.group(2)) if m.group(2) else 0
+    if bits:
+        if size not in (8, 16, 24, 32):
+            sys.exit(f"usage_table.py: bad integer size for {name}: {text}")
+        size //= 8
+
+    return (fmt, size, words[1] if len(words) > 1 else None)
+
+
+def parse_enums(text):
+    enums = {}
+    for m in re.finditer(r"enum (eizo_\w+) : \w+ \{(.*?)\};", text, re.S):
+        values = []
+        seen = set()
+        known = {}
+        nxt = 0
+        for line in m.group(2).splitlines():
+            line = line.split("//")[0].strip().rstrip(",")
+            if not line:
+                continue
+            if "=" in line:
+                ident, expr = [x.strip() for x in line.split("=", 1)]
+                if expr in known:
+                    # An alias, the first name wins.
+                    known[ident] = known[expr]
+                    continue
+                expr = {"false": "0", "true": "1"}.get(expr, expr)
+                value = int(expr, 0)
+            else:
+                ident, value = line, nxt
+            known[ident] = value
+            nxt = value + 1
+            if value in seen:
+                continue
+            seen.add(value)
+            prefix = m.group(1).upper() + "_"
+            short = ident[len(prefix):] if ident.startswith(prefix) else ident
+            values.append((value, short))
+        enums[m.group(1)] = sorted(values)
+    return enums
+
+
+usage_h = open(sys.argv[1], "r").read()
+control_h = open(sys.argv[2], "r").read()
+out_f = open(sys.argv[3], "w")
+
+usages = []
+for m in re.finditer(r"^\s*EIZO_USAGE_(\w+)\s*=\s*0x([0-9a-fA-F]+),[ \t]*(?://(.*))?$", usage_h, re.M):
+    name = m.group(1)
+    fmt, size, enum = parse_annotation(name, (m.group(3) or "").strip())
+    usages.append((int(m.group(2), 16), name, fmt, size, enum))
+
+usages.sort()
+enums = parse_enums(control_h)
+
+for usage in usages:
+    if usage[4] and usage[4] not in enums:
+        sys.exit(f"usage_table.py: unknown enum {usage[4]} for {usage[1]}")
+
+referenced = sorted({u[4] for u in usages if u[4]})
+
+by_usage = perfect_hash([u[0].to_bytes(4, "little") for u in usages])
+by_name = perfect_hash([u[1].lower().encode() for u in usages])
+
+w = out_f.write
+w("// Generated by usage_table.py, do not edit.\n")
+w("\n")
+w("#include \"internal.h\"\n")
+w("\n")
+
+for enum in referenced:
+    w(f"static const struct eizo_enum_value {enum}_values[] = {{\n")
+    for value, short in enums[enum]:
+        w(f"    {{ {value:#x}, \"{short}\" }},\n")
+    w("};\n")
+    w("\n")
+
+w("static const struct eizo_usage_info eizo_usage_info[] = {\n")
+for usage, name, fmt, size, enum in usages:
+    if enum:
+        values = f"{enum}_values, sizeof({enum}_values) / sizeof({enum}_values[0])"
+        w(f"    {{ {usage:#010x}, \"{name}\", {size}, {fmt}, \"enum {enum}\", {values} }},\n")
+    else:
+        w(f"    {{ {usage:#010x}, \"{name}\", {size}, {fmt}, nullptr, nullptr, 0 }},\n")
+w("};\n")
+w("\n")
+
+
+def write_hash(name, h):
+    seeds, slots = h
+    w(f"static const int32_t eizo_usage_{name}_seed[] = {{\n")
+    for i in range(0, len(seeds), 8):
+        w("    " + " ".join(f"{s}," for s in seeds[i:i + 8]) + "\n")
+    w("};\n")
+    w("\n")
+    w(f"static const uint16_t eizo_usage_{name}_slot[] = {{\n")
+    for i in range(0, len(slots), 8):
+        w("    " + " ".join(f"{s}," for s in slots[i:i + 8]) + "\n")
+    w("};\n")
+    w("\n")
+
+
+write_hash("by_usage", by_usage)
+write_hash("by_name", by_name)
+
+w("const struct eizo_usage_table eizo_usage_table = {\n")
+w("    .info = eizo_usage_info,\n")
+w(f"    .n = {len(usages)},\n")
+w("    .by_usage = { eizo_usage_by_usage_seed, eizo_usage_by_usage_slot },\n")
+w("    .by_name = { eizo_usage_by_name_seed, eizo_usage_by_name_slot },\n")
+w("};\n")
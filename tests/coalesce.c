@@ -0,0 +1,169 @@
+#include "test.h"
+
+struct test_write {
+    uint32_t usage;
+    uint16_t value;
+    enum eizo_result res;
+};
+
+struct test_writes {
+    size_t n;
+    struct test_write w[64];
+};
+
+static void
+test_coalesce_cb(eizo_handle_t, uint32_t usage, const uint8_t *value, size_t len, enum eizo_result res, void *userdata)
+{
+    struct test_writes *t = userdata;
+    if (t->n < 64) {
+        t->w[t->n++] = (struct test_write) {
+            .usage = usage,
+            .value = (uint16_t)(value[0] | (len > 1 ? value[1] << 8 : 0)),
+            .res = res,
+        };
+    }
+}
+
+static enum eizo_result
+test_set(eizo_handle_t handle, enum eizo_usage usage, uint16_t x)
+{
+    struct eizo_control ctrl;
+    if (!eizo_control_find(handle, usage, &ctrl)) {
+        return EIZO_ERROR_INVALID_USAGE;
+    }
+    uint8_t v[2] = { (uint8_t)x, (uint8_t)(x >> 8) };
+    return eizo_set_value(handle, usage, v, eizo_control_size(&ctrl));
+}
+
+// Every write takes a while, so the ones that follow queue up behind it.
+static bool
+test_open_slow(struct test_monitor *m)
+{
+    struct eizo_emulator_config config = test_config();
+    config.latency_us = 2000;
+    return test_open_config(m, &config, EIZO_OPEN_DEFAULT);
+}
+
+static void
+test_merge()
+{
+    struct test_monitor m;
+    require(test_open_slow(&m));
+
+    struct test_writes t = {};
+    require(eizo_enable_coalescing(m.handle, test_coalesce_cb, &t) == EIZO_SUCCESS);
+
+    for (uint16_t i = 1; i <= 100; ++i) {
+        check_eq(test_set(m.handle, EIZO_USAGE_BRIGHTNESS, i), EIZO_INCOMPLETE);
+    }
+    eizo_disable_coalescing(m.handle);
+
+    // Most of them were dropped, what was written is in order and ends
+    // with the last one.
+    require(t.n >= 1 && t.n < 10);
+    for (size_t i = 0; i < t.n; ++i) {
+        check_eq(t.w[i].usage, EIZO_USAGE_BRIGHTNESS);
+        check_eq(t.w[i].res, EIZO_SUCCESS);
+        check(i == 0 || t.w[i].value > t.w[i - 1].value);
+    }
+    check_eq(t.w[t.n - 1].value, 100);
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 100);
+
+    // Without coalescing writes are direct again.
+    size_t n = t.n;
+    check_eq(test_set(m.handle, EIZO_USAGE_BRIGHTNESS, 7), EIZO_SUCCESS);
+    check_eq(t.n, n);
+
+    test_close(&m);
+}
+
+static void
+test_order()
+{
+    struct test_monitor m;
+    require(test_open_slow(&m));
+
+    struct test_writes t = {};
+    require(eizo_enable_coalescing(m.handle, test_coalesce_cb, &t) == EIZO_SUCCESS);
+
+    // A merged value moves behind what was set in between.
+    check_eq(test_set(m.handle, EIZO_USAGE_VOLUME, 1), EIZO_INCOMPLETE);
+    check_eq(test_set(m.handle, EIZO_USAGE_BRIGHTNESS, 10), EIZO_INCOMPLETE);
+    check_eq(test_set(m.handle, EIZO_USAGE_CONTRAST, 20), EIZO_INCOMPLETE);
+    check_eq(test_set(m.handle, EIZO_USAGE_BRIGHTNESS, 11), EIZO_INCOMPLETE);
+
+    // Brightness belongs to the profile it was set in, so nothing merges
+    // across a profile change.
+    check_eq(test_set(m.handle, EIZO_USAGE_PROFILE, 1), EIZO_INCOMPLETE);
+    check_eq(test_set(m.handle, EIZO_USAGE_BRIGHTNESS, 30), EIZO_INCOMPLETE);
+    check_eq(test_set(m.handle, EIZO_USAGE_PROFILE, 2), EIZO_INCOMPLETE);
+    check_eq(test_set(m.handle, EIZO_USAGE_BRIGHTNESS, 40), EIZO_INCOMPLETE);
+    check_eq(test_set(m.handle, EIZO_USAGE_PROFILE, 2), EIZO_INCOMPLETE);
+    eizo_disable_coalescing(m.handle);
+
+    const struct test_write expected[] = {
+        { EIZO_USAGE_VOLUME, 1, EIZO_SUCCESS },
+        { EIZO_USAGE_CONTRAST, 20, EIZO_SUCCESS },
+        { EIZO_USAGE_BRIGHTNESS, 11, EIZO_SUCCESS },
+        { EIZO_USAGE_PROFILE, 1, EIZO_SUCCESS },
+        { EIZO_USAGE_BRIGHTNESS, 30, EIZO_SUCCESS },
+        { EIZO_USAGE_PROFILE, 2, EIZO_SUCCESS },
+        { EIZO_USAGE_BRIGHTNESS, 40, EIZO_SUCCESS },
+        { EIZO_USAGE_PROFILE, 2, EIZO_SUCCESS },
+    };
+    constexpr size_t n = sizeof(expected) / sizeof(expected[0]);
+    require(t.n == n);
+    for (size_t i = 0; i < n; ++i) {
+        check_eq(t.w[i].usage, expected[i].usage);
+        check_eq(t.w[i].value, expected[i].value);
+        check_eq(t.w[i].res, expected[i].res);
+    }
+
+    test_close(&m);
+}
+
+static void
+test_full()
+{
+    struct test_monitor m;
+    require(test_open_slow(&m));
+
+    static const enum eizo_usage usages[] = {
+        EIZO_USAGE_VOLUME, EIZO_USAGE_BRIGHTNESS, EIZO_USAGE_CONTRAST,
+        EIZO_USAGE_GAIN_RED, EIZO_USAGE_GAIN_GREEN, EIZO_USAGE_GAIN_BLUE,
+        EIZO_USAGE_COLOR_TEMPERATURE, EIZO_USAGE_OSD_INDICATOR, EIZO_USAGE_GAMMA,
+        EIZO_USAGE_SATURATION, EIZO_USAGE_HUE, EIZO_USAGE_AUTO_ECOVIEW,
+        EIZO_USAGE_OSD_LANGUAGE, EIZO_USAGE_POWER_LED, EIZO_USAGE_BOOT_LOGO,
+        EIZO_USAGE_ECOVIEW_SENSOR, EIZO_USAGE_OSD_KEY_LOCK, EIZO_USAGE_AUTO_INPUT,
+        EIZO_USAGE_POWER_SAVE, EIZO_USAGE_SUPER_RESOLUTION,
+    };
+    constexpr size_t n = sizeof(usages) / sizeof(usages[0]);
+
+    struct test_writes t = {};
+    require(eizo_enable_coalescing(m.handle, test_coalesce_cb, &t) == EIZO_SUCCESS);
+
+    // More usages than the queue holds, the caller waits for room instead
+    // of writing past the queue.
+    for (size_t i = 0; i < n; ++i) {
+        check_eq(test_set(m.handle, usages[i], 1), EIZO_INCOMPLETE);
+    }
+
+    eizo_disable_coalescing(m.handle);
+
+    require(t.n == n);
+    for (size_t i = 0; i < n; ++i) {
+        check_eq(t.w[i].usage, usages[i]);
+        check_eq(t.w[i].res, EIZO_SUCCESS);
+    }
+
+    test_close(&m);
+}
+
+int
+main()
+{
+    test_merge();
+    test_order();
+    test_full();
+    return test_result();
+}
@@ -0,0 +1,56 @@
+#include <stdint.h>
+
+#include "test.h"
+
+static bool
+test_table_has(const struct eizo_control_table *table, enum eizo_usage usage)
+{
+    for (size_t i = 0; i < table->n; ++i) {
+        if (table->usage[i] == usage) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void
+test_index(uint16_t extra_controls)
+{
+    struct eizo_emulator_config config = test_config();
+    config.extra_controls = extra_controls;
+
+    struct test_monitor m;
+    require(test_open_config(&m, &config, EIZO_OPEN_DEFAULT));
+
+    const struct eizo_control_table *table;
+    size_t n = eizo_get_controls(m.handle, &table);
+    check(n > extra_controls);
+
+    // Every control is found where the table has it, its neighbours only
+    // if they are controls of their own.
+    for (size_t i = 0; i < n; ++i) {
+        struct eizo_control ctrl;
+        enum eizo_usage usage = table->usage[i];
+        check(eizo_control_find(m.handle, usage, &ctrl));
+        check_eq(ctrl.usage, usage);
+        check_eq(ctrl.report_count, table->report_count[i]);
+        check_eq(ctrl.logical_maximum, table->logical_maximum[i]);
+
+        enum eizo_usage next = (enum eizo_usage)(usage + 1);
+        check_eq(eizo_control_find(m.handle, next, nullptr), test_table_has(table, next));
+    }
+
+    check(!eizo_control_find(m.handle, (enum eizo_usage)0, nullptr));
+    check(!eizo_control_find(m.handle, (enum eizo_usage)0x12340001, nullptr));
+    check(!eizo_control_find(m.handle, (enum eizo_usage)UINT32_MAX, nullptr));
+
+    test_close(&m);
+}
+
+int
+main()
+{
+    test_index(0);
+    test_index(160);
+    return test_result();
+}
@@ -0,0 +1,68 @@
+#include <string.h>
+#include <unistd.h>
+
+#include "test.h"
+
+static void
+test_descriptor_cache()
+{
+    char dir[] = "/tmp/libeizo-test-XXXXXX";
+    require(mkdtemp(dir));
+    setenv("XDG_CACHE_HOME", dir, 1);
+
+    // A bigger descriptor makes the difference plain.
+    struct eizo_emulator_config config = test_config();
+    config.extra_controls = 160;
+
+    uint64_t requests[3];
+    size_t n[3];
+    for (size_t i = 0; i < 3; ++i) {
+        // The first open fills the cache, the second one reads it, the
+        // last one goes without.
+        struct test_monitor m;
+        enum eizo_open_flags flags = i < 2 ? EIZO_OPEN_CACHE_DESCRIPTOR : EIZO_OPEN_DEFAULT;
+        require(test_open_config(&m, &config, flags));
+        requests[i] = eizo_emulator_get_request_count(m.emu);
+
+        const struct eizo_control_table *table;
+        n[i] = eizo_get_controls(m.handle, &table);
+        check(eizo_control_find(m.handle, EIZO_USAGE_BRIGHTNESS, nullptr));
+        check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 120);
+
+        test_close(&m);
+    }
+
+    check(requests[1] < requests[2]);
+    check(requests[0] >= requests[2]);
+    check_eq(n[1], n[0]);
+    check_eq(n[2], n[0]);
+
+    char path[128];
+    snprintf(path, sizeof(path), "%s/libeizo/%04x-%04x-%lu.ctl", dir, EIZO_VID, EIZO_PID_FLEXSCAN_EV2760, config.serial);
+    check(access(path, F_OK) == 0);
+
+    // A cache file that doesn't parse is read from the monitor again.
+    FILE *f = fopen(path, "r+b");
+    require(f);
+    fputs("garbage", f);
+    fclose(f);
+
+    struct test_monitor m;
+    require(test_open_config(&m, &config, EIZO_OPEN_CACHE_DESCRIPTOR));
+    const struct eizo_control_table *table;
+    check_eq(eizo_get_controls(m.handle, &table), n[0]);
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 120);
+    test_close(&m);
+
+    check(unlink(path) == 0);
+    snprintf(path, sizeof(path), "%s/libeizo", dir);
+    check(rmdir(path) == 0);
+    rmdir(dir);
+}
+
+int
+main()
+{
+    test_descriptor_cache();
+    return test_result();
+}
@@ -0,0 +1,133 @@
+#include <string.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "eizo/eeprom.h"
+
+static void
+test_read(bool autoincrement)
+{
+    struct eizo_emulator_config config = test_config();
+    config.eeprom_autoincrement = autoincrement;
+
+    struct test_monitor m;
+    require(test_open_config(&m, &config, EIZO_OPEN_DEFAULT));
+    eizo_handle_t handle = m.handle;
+
+    struct eizo_eeprom_image image;
+    check_eq(eizo_read_eeprom_image(handle, &image), EIZO_SUCCESS);
+    check_eq(image.pid, EIZO_PID_FLEXSCAN_EV2760);
+    check_eq(image.serial, 12345678);
+    check(strcmp((const char *)image.firmware, "1.0.0") == 0);
+    check(memcmp(image.data + EIZO_EEPROM_ADDRESS_SERIAL_STRING, "12345678", 8) == 0);
+    check(memcmp(image.data + EIZO_EEPROM_ADDRESS_PRODUCT_STRING_1, "EV2760", 6) == 0);
+
+    // A read in the middle gives the same bytes as the whole image.
+    uint8_t buf[40];
+    check_eq(eizo_read_eeprom(handle, 0x100, sizeof(buf), buf), EIZO_SUCCESS);
+    check(memcmp(buf, image.data + 0x100, sizeof(buf)) == 0);
+
+    test_close(&m);
+}
+
+static void
+test_restore()
+{
+    struct test_monitor m;
+    require(test_open(&m, EIZO_OPEN_DEFAULT));
+    eizo_handle_t handle = m.handle;
+
+    struct eizo_eeprom_image image;
+    require(eizo_read_eeprom_image(handle, &image) == EIZO_SUCCESS);
+
+    // Nothing differs, nothing is written.
+    size_t written = SIZE_MAX;
+    check_eq(eizo_restore_eeprom_image(handle, &image, &written), EIZO_SUCCESS);
+    check_eq(written, 0);
+
+    // Only the changed bytes are written, the identity strings of the
+    // monitor are kept.
+    struct eizo_eeprom_image edited = image;
+    edited.data[0x100] ^= 0xff;
+    edited.data[0x101] ^= 0x01;
+    edited.data[0x1ff] ^= 0x80;
+    memcpy(edited.data + EIZO_EEPROM_ADDRESS_SERIAL_STRING, "87654321", 8);
+    memcpy(edited.data + EIZO_EEPROM_ADDRESS_PRODUCT_STRING_1, "CS2740\0\0", 8);
+    check_eq(eizo_restore_eeprom_image(handle, &edited, &written), EIZO_SUCCESS);
+    check_eq(written, 3);
+
+    struct eizo_eeprom_image after;
+    require(eizo_read_eeprom_image(handle, &after) == EIZO_SUCCESS);
+    check_eq(after.data[0x100], edited.data[0x100]);
+    check_eq(after.data[0x101], edited.data[0x101]);
+    check_eq(after.data[0x1ff], edited.data[0x1ff]);
+    check(memcmp(after.data + EIZO_EEPROM_ADDRESS_SERIAL_STRING, "12345678", 8) == 0);
+    check(memcmp(after.data + EIZO_EEPROM_ADDRESS_PRODUCT_STRING_1, "EV2760", 6) == 0);
+
+    check_eq(eizo_restore_eeprom_image(handle, &edited, &written), EIZO_SUCCESS);
+    check_eq(written, 0);
+
+    // Images of another firmware need to be forced.
+    check_eq(eizo_restore_eeprom_image(handle, &image, &written), EIZO_SUCCESS);
+    check_eq(written, 3);
+    memcpy(edited.firmware, "1.0.1", 6);
+    check_eq(eizo_restore_eeprom_image(handle, &edited, &written), EIZO_ERROR_NOT_PERMITTED);
+    check_eq(written, 0);
+    check_eq(eizo_restore_eeprom_image_ex(handle, &edited, EIZO_RESTORE_ANY_FIRMWARE, &written), EIZO_SUCCESS);
+    check_eq(written, 3);
+
+    // Those of another model never go through.
+    edited.pid = EIZO_PID_COLOREDGE_CS2740;
+    check(eizo_restore_eeprom_image_ex(handle, &edited, EIZO_RESTORE_ANY_FIRMWARE, &written) < EIZO_SUCCESS);
+
+    test_close(&m);
+}
+
+static void
+test_save_load()
+{
+    char dir[] = "/tmp/libeizo-test-XXXXXX";
+    require(mkdtemp(dir));
+    char path[64];
+    snprintf(path, sizeof(path), "%s/ev2760.img", dir);
+
+    struct eizo_eeprom_image image = {
+        .pid = EIZO_PID_FLEXSCAN_EV2760,
+        .serial = 12345678,
+        .firmware = "1.0.0",
+    };
+    for (size_t i = 0; i < EIZO_EEPROM_SIZE; ++i) {
+        image.data[i] = (uint8_t)(i * 13);
+    }
+
+    struct eizo_eeprom_image loaded;
+    check_eq(eizo_save_eeprom_image(&image, path), EIZO_SUCCESS);
+    check_eq(eizo_load_eeprom_image(path, &loaded), EIZO_SUCCESS);
+    check_eq(loaded.pid, image.pid);
+    check_eq(loaded.serial, image.serial);
+    check(memcmp(loaded.firmware, image.firmware, sizeof(image.firmware)) == 0);
+    check(memcmp(loaded.data, image.data, sizeof(image.data)) == 0);
+
+    // A flipped bit anywhere fails the checksum.
+    FILE *f = fopen(path, "r+b");
+    require(f);
+    fseek(f, -100, SEEK_END);
+    int c = fgetc(f);
+    fseek(f, -100, SEEK_END);
+    fputc(c ^ 0x10, f);
+    fclose(f);
+    check_eq(eizo_load_eeprom_image(path, &loaded), EIZO_ERROR_BAD_DATA);
+
+    unlink(path);
+    rmdir(dir);
+}
+
+int
+main()
+{
+    test_read(false);
+    test_read(true);
+    test_restore();
+    test_save_load();
+    return test_result();
+}
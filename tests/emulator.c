@@ -0,0 +1,81 @@
+#include <poll.h>
+
+#include "test.h"
+
+static void
+test_requests()
+{
+    struct test_monitor m;
+    require(test_open(&m, EIZO_OPEN_DEFAULT));
+    eizo_set_retry_policy(m.handle, EIZO_RETRY_NONE, 0);
+
+    // Every get is at least one request.
+    uint64_t requests = eizo_emulator_get_request_count(m.emu);
+    check(requests > 0);
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 120);
+    check(eizo_emulator_get_request_count(m.emu) > requests);
+
+    uint8_t v[2];
+    eizo_emulator_bump_counter(m.emu);
+    check_eq(eizo_get_value(m.handle, EIZO_USAGE_BRIGHTNESS, v, sizeof(v)), EIZO_ERROR_RACE_CONDITION);
+
+    // The counter moves right before the next request is served.
+    eizo_emulator_bump_counter_after(m.emu, 1);
+    check_eq(eizo_get_value(m.handle, EIZO_USAGE_BRIGHTNESS, v, sizeof(v)), EIZO_ERROR_RACE_CONDITION);
+    check_eq(eizo_get_value(m.handle, EIZO_USAGE_BRIGHTNESS, v, sizeof(v)), EIZO_SUCCESS);
+
+    eizo_emulator_bump_counter_after(m.emu, 1000);
+    eizo_emulator_bump_counter_after(m.emu, 0);
+    for (int i = 0; i < 10; ++i) {
+        check_eq(eizo_get_value(m.handle, EIZO_USAGE_BRIGHTNESS, v, sizeof(v)), EIZO_SUCCESS);
+    }
+
+    test_close(&m);
+}
+
+static void
+test_input_reports()
+{
+    struct test_monitor m;
+    require(test_open(&m, EIZO_OPEN_DEFAULT));
+
+    struct pollfd pfd = { .fd = eizo_get_fd(m.handle), .events = POLLIN };
+    check_eq(poll(&pfd, 1, 0), 0);
+
+    uint8_t v[2] = { 33, 0 };
+    check_eq(eizo_emulator_set_value(m.emu, EIZO_USAGE_BRIGHTNESS, v, sizeof(v)), EIZO_SUCCESS);
+    check_eq(poll(&pfd, 1, 1000), 1);
+    check_eq(eizo_dispatch(m.handle), 1);
+    check_eq(poll(&pfd, 1, 0), 0);
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 33);
+
+    test_close(&m);
+}
+
+static void
+test_extra_controls()
+{
+    // The most extra controls a handle accepts.
+    struct eizo_emulator_config config = test_config();
+    config.extra_controls = EIZO_EMULATOR_MAX_EXTRA_CONTROLS;
+    struct test_monitor m;
+    require(test_open_config(&m, &config, EIZO_OPEN_DEFAULT));
+    const struct eizo_control_table *table;
+    size_t n = eizo_get_controls(m.handle, &table);
+    check_eq(n, EIZO_MAX_CONTROLS);
+    check(eizo_control_find(m.handle, table->usage[n - 1], nullptr));
+    test_close(&m);
+
+    eizo_emulator_t emu;
+    config.extra_controls = EIZO_EMULATOR_MAX_EXTRA_CONTROLS + 1;
+    check_eq(eizo_emulator_new(&config, &emu), EIZO_ERROR_INVALID_ARGUMENT);
+}
+
+int
+main()
+{
+    test_requests();
+    test_extra_controls();
+    test_input_reports();
+    return test_result();
+}
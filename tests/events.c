@@ -0,0 +1,72 @@
+#include "test.h"
+
+struct test_events {
+    int calls[3];
+    int64_t integer;
+    uint32_t usage;
+};
+
+static void
+test_event_cb(eizo_handle_t handle, const struct eizo_value_event *ev, void *userdata)
+{
+    struct test_events *t = userdata;
+    ++t->calls[0];
+    t->integer = ev->integer;
+    t->usage = ev->usage;
+
+    // Removing itself must not make the next listener miss the event.
+    eizo_remove_value_callback(handle, 0, test_event_cb, userdata);
+}
+
+static void
+test_event_cb2(eizo_handle_t, const struct eizo_value_event *, void *userdata)
+{
+    ++((struct test_events *)userdata)->calls[1];
+}
+
+static void
+test_event_cb3(eizo_handle_t, const struct eizo_value_event *, void *userdata)
+{
+    ++((struct test_events *)userdata)->calls[2];
+}
+
+static void
+test_events()
+{
+    struct test_monitor m;
+    require(test_open(&m, EIZO_OPEN_DEFAULT));
+
+    struct test_events t = {};
+    check_eq(eizo_add_value_callback(m.handle, 0, test_event_cb, &t), EIZO_SUCCESS);
+    check_eq(eizo_add_value_callback(m.handle, 0, test_event_cb2, &t), EIZO_SUCCESS);
+    check_eq(eizo_add_value_callback(m.handle, EIZO_USAGE_CONTRAST, test_event_cb3, &t), EIZO_SUCCESS);
+
+    // Nothing queued yet.
+    check_eq(eizo_dispatch(m.handle), 0);
+
+    // Saturation has a negative logical minimum, so it is sign extended.
+    uint8_t v[1] = { 0xfb };
+    check_eq(eizo_emulator_set_value(m.emu, EIZO_USAGE_SATURATION, v, sizeof(v)), EIZO_SUCCESS);
+    check_eq(eizo_dispatch(m.handle), 1);
+    check_eq(t.calls[0], 1);
+    check_eq(t.calls[1], 1);
+    check_eq(t.calls[2], 0);
+    check_eq(t.usage, EIZO_USAGE_SATURATION);
+    check_eq(t.integer, -5);
+
+    uint8_t c[2] = { 50, 0 };
+    check_eq(eizo_emulator_set_value(m.emu, EIZO_USAGE_CONTRAST, c, sizeof(c)), EIZO_SUCCESS);
+    check_eq(eizo_dispatch(m.handle), 1);
+    check_eq(t.calls[0], 1);
+    check_eq(t.calls[1], 2);
+    check_eq(t.calls[2], 1);
+
+    test_close(&m);
+}
+
+int
+main()
+{
+    test_events();
+    return test_result();
+}
@@ -0,0 +1,129 @@
+#include <pthread.h>
+#include <time.h>
+
+#include "test.h"
+#include "eizo/lut.h"
+
+static float red[EIZO_LUT_ENTRIES], green[EIZO_LUT_ENTRIES], blue[EIZO_LUT_ENTRIES];
+
+static void
+test_get_set()
+{
+    struct test_monitor m;
+    require(test_open(&m, EIZO_OPEN_IO_WORKER));
+
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 120);
+    check_eq(test_set_u16(m.handle, EIZO_USAGE_BRIGHTNESS, 80), EIZO_SUCCESS);
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 80);
+    check(test_set_u16(m.handle, EIZO_USAGE_BRIGHTNESS, 250) < EIZO_SUCCESS);
+
+    enum eizo_usage usages[] = { EIZO_USAGE_BRIGHTNESS, EIZO_USAGE_CONTRAST };
+    uint8_t a[2], c[2];
+    uint8_t *const values[] = { a, c };
+    size_t lens[] = { 2, 2 };
+    enum eizo_result results[2];
+    check_eq(eizo_get_values(m.handle, usages, 2, values, lens, results), EIZO_SUCCESS);
+    check_eq(a[0], 80);
+    check_eq(c[0], 100);
+
+    test_close(&m);
+}
+
+struct test_lut_writer {
+    pthread_t thread;
+    eizo_handle_t handle;
+    enum eizo_result res;
+};
+
+static void *
+test_write_lut(void *arg)
+{
+    struct test_lut_writer *w = arg;
+    w->res = eizo_write_lut(w->handle, EIZO_LUT_FRONT, red, green, blue, nullptr);
+    return nullptr;
+}
+
+// Start a full LUT upload in another thread and return once its first
+// pages went out.
+static void
+test_start_lut_write(struct test_monitor *m, struct test_lut_writer *w)
+{
+    for (size_t i = 0; i < EIZO_LUT_ENTRIES; ++i) {
+        red[i] = green[i] = blue[i] = (float)i / (EIZO_LUT_ENTRIES - 1);
+    }
+
+    w->handle = m->handle;
+    uint64_t requests = eizo_emulator_get_request_count(m->emu);
+    require(pthread_create(&w->thread, nullptr, test_write_lut, w) == 0);
+    while (eizo_emulator_get_request_count(m->emu) < requests + 6) {
+        nanosleep(&(struct timespec) { .tv_nsec = 100000 }, nullptr);
+    }
+}
+
+static void
+test_short_overtakes_long()
+{
+    struct eizo_emulator_config config = test_config();
+    config.latency_us = 2000;
+    struct test_monitor m;
+    require(test_open_config(&m, &config, EIZO_OPEN_IO_WORKER));
+
+    // A get in the middle of a LUT upload is served between two of its
+    // pages instead of after all of them.
+    struct test_lut_writer w;
+    test_start_lut_write(&m, &w);
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 120);
+    uint64_t get = eizo_emulator_get_request_count(m.emu);
+
+    pthread_join(w.thread, nullptr);
+    check_eq(w.res, EIZO_SUCCESS);
+    check(get < eizo_emulator_get_request_count(m.emu));
+
+    test_close(&m);
+}
+
+static void
+test_dispatch()
+{
+    struct eizo_emulator_config config = test_config();
+    config.latency_us = 2000;
+    struct test_monitor m;
+
+    // Input reports never load the controls of a lazy handle.
+    require(test_open_config(&m, &config, EIZO_OPEN_LAZY));
+    uint64_t requests = eizo_emulator_get_request_count(m.emu);
+    uint8_t v[2] = { 33, 0 };
+    check_eq(eizo_emulator_set_value(m.emu, EIZO_USAGE_BRIGHTNESS, v, sizeof(v)), EIZO_SUCCESS);
+    check_eq(eizo_dispatch(m.handle), 1);
+    check_eq(eizo_emulator_get_request_count(m.emu), requests);
+    test_close(&m);
+
+    // Nor do they wait for a running transfer, even without the worker
+    // thread. The cached value is dropped right away.
+    require(test_open_config(&m, &config, EIZO_OPEN_DEFAULT));
+    require(eizo_enable_value_cache(m.handle, 60000) == EIZO_SUCCESS);
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 120);
+
+    struct test_lut_writer w;
+    test_start_lut_write(&m, &w);
+    v[0] = 44;
+    check_eq(eizo_emulator_set_value(m.emu, EIZO_USAGE_BRIGHTNESS, v, sizeof(v)), EIZO_SUCCESS);
+    check_eq(eizo_dispatch(m.handle), 1);
+    uint64_t dispatched = eizo_emulator_get_request_count(m.emu);
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 44);
+
+    pthread_join(w.thread, nullptr);
+    check_eq(w.res, EIZO_SUCCESS);
+    check(dispatched < eizo_emulator_get_request_count(m.emu));
+
+    test_close(&m);
+}
+
+int
+main()
+{
+    test_get_set();
+    test_short_overtakes_long();
+    test_dispatch();
+    return test_result();
+}
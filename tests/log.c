@@ -0,0 +1,157 @@
+#include <string.h>
+
+#include "test.h"
+#include "eizo/eeprom.h"
+#include "eizo/log.h"
+
+struct test_messages {
+    int n;
+    enum eizo_log_level level;
+    char func[32];
+    char msg[64];
+};
+
+static void
+test_log_cb(enum eizo_log_level level, const char *func, const char *msg, void *userdata)
+{
+    struct test_messages *t = userdata;
+    ++t->n;
+    t->level = level;
+    snprintf(t->func, sizeof(t->func), "%s", func);
+    snprintf(t->msg, sizeof(t->msg), "%s", msg);
+}
+
+static void
+test_callback()
+{
+    struct test_messages t = {};
+    eizo_set_log_callback(test_log_cb, &t);
+
+    eizo_log(EIZO_LOG_WARNING, "test", "value %d", 42);
+    check_eq(t.n, 1);
+    check_eq(t.level, EIZO_LOG_WARNING);
+    check(strcmp(t.func, "test") == 0);
+    check(strcmp(t.msg, "value 42") == 0);
+
+    // Debug messages are dropped by default.
+    eizo_log(EIZO_LOG_DEBUG, "test", "hidden");
+    check_eq(t.n, 1);
+    eizo_set_log_level(EIZO_LOG_DEBUG);
+    eizo_log(EIZO_LOG_DEBUG, "test", "shown");
+    check_eq(t.n, 2);
+    eizo_set_log_level(EIZO_LOG_ERROR);
+    eizo_log(EIZO_LOG_WARNING, "test", "hidden");
+    check_eq(t.n, 2);
+    eizo_set_log_level(EIZO_LOG_INFO);
+
+    eizo_set_log_callback(nullptr, nullptr);
+}
+
+struct test_dump {
+    int n;
+    int first;
+    int last;
+    bool ordered;
+};
+
+static void
+test_dump_cb(enum eizo_log_level, const char *, const char *msg, void *userdata)
+{
+    struct test_dump *t = userdata;
+    int i = atoi(msg);
+    if (t->n == 0) {
+        t->first = i;
+    } else if (i != t->last + 1) {
+        t->ordered = false;
+    }
+    t->last = i;
+    ++t->n;
+}
+
+static void
+test_ring()
+{
+    struct test_messages t = {};
+    eizo_set_log_callback(test_log_cb, &t);
+    eizo_set_log_ring(true);
+
+    // The ring keeps the messages to itself.
+    for (int i = 0; i < 10; ++i) {
+        eizo_log(EIZO_LOG_INFO, "test", "%d", i);
+    }
+    check_eq(t.n, 0);
+
+    struct test_dump d = { .ordered = true };
+    eizo_dump_log_ring(test_dump_cb, &d);
+    check_eq(d.n, 10);
+    check_eq(d.first, 0);
+    check_eq(d.last, 9);
+    check(d.ordered);
+
+    // Only the newest survive, oldest first.
+    constexpr int total = 10 + 3 * EIZO_LOG_RING_SIZE + 7;
+    for (int i = 10; i < total; ++i) {
+        eizo_log(EIZO_LOG_INFO, "test", "%d", i);
+    }
+    d = (struct test_dump) { .ordered = true };
+    eizo_dump_log_ring(test_dump_cb, &d);
+    check_eq(d.n, EIZO_LOG_RING_SIZE);
+    check_eq(d.first, total - (int)EIZO_LOG_RING_SIZE);
+    check_eq(d.last, total - 1);
+    check(d.ordered);
+
+    eizo_set_log_ring(false);
+    eizo_log(EIZO_LOG_INFO, "test", "direct");
+    check_eq(t.n, 1);
+    eizo_set_log_callback(nullptr, nullptr);
+}
+
+static void
+test_nested_cb(enum eizo_log_level level, const char *func, const char *msg, void *userdata)
+{
+    struct test_messages *t = userdata;
+    test_log_cb(level, func, msg, userdata);
+    if (t->n == 1) {
+        eizo_log(EIZO_LOG_INFO, "nested", "from the callback");
+    }
+}
+
+static void
+test_nested()
+{
+    // A callback that logs itself gets its own message, rather than
+    // waiting for itself.
+    struct test_messages t = {};
+    eizo_set_log_callback(test_nested_cb, &t);
+    eizo_log(EIZO_LOG_INFO, "test", "outer");
+    check_eq(t.n, 2);
+    check(strcmp(t.func, "nested") == 0);
+    eizo_set_log_callback(nullptr, nullptr);
+}
+
+static void
+test_levels()
+{
+    // Failures the caller is told about as well still show up above info.
+    struct test_messages t = {};
+    eizo_set_log_callback(test_log_cb, &t);
+    eizo_set_log_level(EIZO_LOG_WARNING);
+
+    struct eizo_eeprom_image image;
+    check_eq(eizo_load_eeprom_image("/nonexistent/libeizo.eeprom", &image), EIZO_ERROR_IO);
+    check_eq(t.n, 1);
+    check_eq(t.level, EIZO_LOG_WARNING);
+
+    eizo_set_log_level(EIZO_LOG_INFO);
+    eizo_set_log_callback(nullptr, nullptr);
+}
+
+int
+main()
+{
+    test_callback();
+    test_ring();
+    test_nested();
+    test_levels();
+    return test_result();
+}
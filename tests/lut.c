@@ -0,0 +1,147 @@
+#include <math.h>
+
+#include "test.h"
+#include "eizo/lut.h"
+
+static float red[EIZO_LUT_ENTRIES], green[EIZO_LUT_ENTRIES], blue[EIZO_LUT_ENTRIES];
+static float r[EIZO_LUT_ENTRIES], g[EIZO_LUT_ENTRIES], b[EIZO_LUT_ENTRIES];
+
+static bool
+test_lut_equal()
+{
+    for (size_t i = 0; i < EIZO_LUT_ENTRIES; ++i) {
+        if (fabsf(r[i] - red[i]) > 1e-4f || fabsf(g[i] - green[i]) > 1e-4f || fabsf(b[i] - blue[i]) > 1e-4f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint64_t
+test_get_cost(struct test_monitor *m)
+{
+    uint64_t requests = eizo_emulator_get_request_count(m->emu);
+    test_get_u16(m->handle, EIZO_USAGE_BRIGHTNESS);
+    return eizo_emulator_get_request_count(m->emu) - requests;
+}
+
+static void
+test_pages()
+{
+    struct test_monitor m;
+    require(test_open(&m, EIZO_OPEN_DEFAULT));
+    uint64_t get = test_get_cost(&m);
+
+    require(eizo_read_lut(m.handle, EIZO_LUT_FRONT, red, green, blue) == EIZO_SUCCESS);
+
+    // What was just read is known to be on the monitor, a single page read
+    // back confirms it.
+    size_t pages = SIZE_MAX;
+    uint64_t requests = eizo_emulator_get_request_count(m.emu);
+    check_eq(eizo_write_lut(m.handle, EIZO_LUT_FRONT, red, green, blue, &pages), EIZO_SUCCESS);
+    check_eq(pages, 0);
+    check_eq(eizo_emulator_get_request_count(m.emu) - requests, get);
+
+    // One entry only needs its page.
+    green[500] = 0.25f;
+    check_eq(eizo_write_lut(m.handle, EIZO_LUT_FRONT, red, green, blue, &pages), EIZO_SUCCESS);
+    check_eq(pages, 1);
+
+    // Everything once the handle forgets.
+    eizo_invalidate_lut(m.handle, EIZO_LUT_FRONT);
+    check_eq(eizo_write_lut(m.handle, EIZO_LUT_FRONT, red, green, blue, &pages), EIZO_SUCCESS);
+    size_t full = pages;
+    check(full > 1);
+
+    // Another client may have changed it in the meantime, which shows when
+    // the page is read back and then all of them go out again.
+    eizo_emulator_bump_counter(m.emu);
+    blue[0] = 0.5f;
+    check_eq(eizo_write_lut(m.handle, EIZO_LUT_FRONT, red, green, blue, &pages), EIZO_SUCCESS);
+    check_eq(pages, full);
+
+    check_eq(eizo_read_lut(m.handle, EIZO_LUT_FRONT, r, g, b), EIZO_SUCCESS);
+    check(test_lut_equal());
+
+    // The luts are tracked apart.
+    check_eq(eizo_write_lut(m.handle, EIZO_LUT_REAR, red, green, blue, &pages), EIZO_SUCCESS);
+    check_eq(pages, full);
+
+    test_close(&m);
+}
+
+static void
+test_profile()
+{
+    struct test_monitor m;
+    require(test_open(&m, EIZO_OPEN_DEFAULT));
+    uint64_t get = test_get_cost(&m);
+
+    require(eizo_read_lut(m.handle, EIZO_LUT_FRONT, red, green, blue) == EIZO_SUCCESS);
+    green[500] = 0.25f;
+    size_t pages = SIZE_MAX;
+    check_eq(eizo_write_lut(m.handle, EIZO_LUT_FRONT, red, green, blue, &pages), EIZO_SUCCESS);
+    check_eq(pages, 1);
+
+    // The OSD switches the profile, which loads other LUTs without the
+    // handle's counter changing. Reading back a page shows it.
+    uint8_t profile = 1;
+    check_eq(eizo_emulator_set_value(m.emu, EIZO_USAGE_PROFILE, &profile, 1), EIZO_SUCCESS);
+    check_eq(eizo_write_lut(m.handle, EIZO_LUT_FRONT, red, green, blue, &pages), EIZO_SUCCESS);
+    size_t full = pages;
+    check(full > 1);
+    check_eq(eizo_read_lut(m.handle, EIZO_LUT_FRONT, r, g, b), EIZO_SUCCESS);
+    check(test_lut_equal());
+
+    // Switching it through the handle forgets the shadow right away, so
+    // nothing is read back before the upload.
+    profile = 2;
+    check_eq(eizo_set_value(m.handle, EIZO_USAGE_PROFILE, &profile, 1), EIZO_SUCCESS);
+    uint64_t requests = eizo_emulator_get_request_count(m.emu);
+    check_eq(eizo_write_lut(m.handle, EIZO_LUT_FRONT, red, green, blue, &pages), EIZO_SUCCESS);
+    check_eq(pages, full);
+    uint64_t upload = eizo_emulator_get_request_count(m.emu) - requests;
+
+    // A confirmed shadow costs the read back on top of the changed page.
+    green[500] = 0.5f;
+    requests = eizo_emulator_get_request_count(m.emu);
+    check_eq(eizo_write_lut(m.handle, EIZO_LUT_FRONT, red, green, blue, &pages), EIZO_SUCCESS);
+    check_eq(pages, 1);
+    check_eq(eizo_emulator_get_request_count(m.emu) - requests, get + upload / full);
+
+    test_close(&m);
+}
+
+static void
+test_resume()
+{
+    struct test_monitor m;
+    require(test_open(&m, EIZO_OPEN_DEFAULT));
+
+    for (size_t i = 0; i < EIZO_LUT_ENTRIES; ++i) {
+        red[i] = powf((float)i / (EIZO_LUT_ENTRIES - 1), 2.2f);
+        green[i] = (float)i / (EIZO_LUT_ENTRIES - 1);
+        blue[i] = 1.0f - green[i];
+    }
+
+    // Taking over the monitor in the middle of a transfer makes it continue
+    // where it stopped with the new counter.
+    eizo_emulator_bump_counter_after(m.emu, 10);
+    check_eq(eizo_write_lut(m.handle, EIZO_LUT_FRONT, red, green, blue, nullptr), EIZO_SUCCESS);
+
+    eizo_emulator_bump_counter_after(m.emu, 10);
+    check_eq(eizo_read_lut(m.handle, EIZO_LUT_FRONT, r, g, b), EIZO_SUCCESS);
+    check(test_lut_equal());
+
+    eizo_emulator_bump_counter_after(m.emu, 0);
+    test_close(&m);
+}
+
+int
+main()
+{
+    test_pages();
+    test_profile();
+    test_resume();
+    return test_result();
+}
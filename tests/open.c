@@ -0,0 +1,62 @@
+#include <string.h>
+
+#include "test.h"
+
+static void
+test_open_eager_and_lazy()
+{
+    struct test_monitor m;
+    require(test_open(&m, EIZO_OPEN_DEFAULT));
+    check_eq(eizo_get_pid(m.handle), EIZO_PID_FLEXSCAN_EV2760);
+    check_eq(eizo_get_serial(m.handle), 12345678);
+    check(strcmp(eizo_get_product(m.handle), "EV2760") == 0);
+    uint64_t eager = eizo_emulator_get_request_count(m.emu);
+    test_close(&m);
+
+    // A lazy open only acquires the counter, the rest follows on demand.
+    require(test_open(&m, EIZO_OPEN_LAZY));
+    uint64_t lazy = eizo_emulator_get_request_count(m.emu);
+    check(lazy < eager);
+    check_eq(eizo_get_serial(m.handle), 12345678);
+    check(strcmp(eizo_get_product(m.handle), "EV2760") == 0);
+    check(eizo_emulator_get_request_count(m.emu) > lazy);
+
+    uint64_t product = eizo_emulator_get_request_count(m.emu);
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 120);
+    check(eizo_emulator_get_request_count(m.emu) > product + 1);
+
+    // Everything is loaded once, a get costs as much as on an eager handle.
+    uint64_t loaded = eizo_emulator_get_request_count(m.emu);
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 120);
+    uint64_t get = eizo_emulator_get_request_count(m.emu) - loaded;
+    check_eq(eizo_get_serial(m.handle), 12345678);
+    check_eq(eizo_emulator_get_request_count(m.emu) - loaded, get);
+    test_close(&m);
+
+    require(test_open(&m, EIZO_OPEN_DEFAULT));
+    loaded = eizo_emulator_get_request_count(m.emu);
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 120);
+    check_eq(eizo_emulator_get_request_count(m.emu) - loaded, get);
+    test_close(&m);
+}
+
+static void
+test_open_lazy_parts()
+{
+    // Only the controls deferred, the product is read right away.
+    struct test_monitor m;
+    require(test_open(&m, EIZO_OPEN_LAZY_CONTROLS));
+    uint64_t requests = eizo_emulator_get_request_count(m.emu);
+    check_eq(eizo_get_serial(m.handle), 12345678);
+    check_eq(eizo_emulator_get_request_count(m.emu), requests);
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_CONTRAST), 100);
+    test_close(&m);
+}
+
+int
+main()
+{
+    test_open_eager_and_lazy();
+    test_open_lazy_parts();
+    return test_result();
+}
@@ -0,0 +1,43 @@
+#include "test.h"
+
+static void
+test_retry()
+{
+    struct test_monitor m;
+    require(test_open(&m, EIZO_OPEN_DEFAULT));
+
+    // Gets are retried with the new counter by default.
+    eizo_emulator_bump_counter(m.emu);
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 120);
+
+    // Sets are not, the next one goes through.
+    eizo_emulator_bump_counter(m.emu);
+    check_eq(test_set_u16(m.handle, EIZO_USAGE_BRIGHTNESS, 90), EIZO_ERROR_RACE_CONDITION);
+    check_eq(test_set_u16(m.handle, EIZO_USAGE_BRIGHTNESS, 90), EIZO_SUCCESS);
+
+    eizo_set_retry_policy(m.handle, EIZO_RETRY_GETS | EIZO_RETRY_SETS, 1);
+    eizo_emulator_bump_counter(m.emu);
+    check_eq(test_set_u16(m.handle, EIZO_USAGE_BRIGHTNESS, 95), EIZO_SUCCESS);
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 95);
+
+    // A single retry doesn't help if the counter moves again right away.
+    eizo_emulator_bump_counter(m.emu);
+    eizo_emulator_bump_counter_after(m.emu, 6);
+    uint8_t v[2];
+    check_eq(eizo_get_value(m.handle, EIZO_USAGE_BRIGHTNESS, v, sizeof(v)), EIZO_ERROR_RACE_CONDITION);
+    eizo_emulator_bump_counter_after(m.emu, 0);
+
+    eizo_set_retry_policy(m.handle, EIZO_RETRY_NONE, 0);
+    eizo_emulator_bump_counter(m.emu);
+    check_eq(eizo_get_value(m.handle, EIZO_USAGE_BRIGHTNESS, v, sizeof(v)), EIZO_ERROR_RACE_CONDITION);
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 95);
+
+    test_close(&m);
+}
+
+int
+main()
+{
+    test_retry();
+    return test_result();
+}
@@ -0,0 +1,42 @@
+#include "test.h"
+
+static void
+test_shared_controls()
+{
+    struct eizo_emulator_config config = test_config();
+    struct test_monitor a, b, c;
+    require(test_open_config(&a, &config, EIZO_OPEN_DEFAULT));
+    require(test_open_config(&b, &config, EIZO_OPEN_DEFAULT));
+
+    // Monitors of the same model parse the descriptor once.
+    const struct eizo_control_table *ta, *tb, *tc;
+    size_t n = eizo_get_controls(a.handle, &ta);
+    check_eq(eizo_get_controls(b.handle, &tb), n);
+    check(ta == tb);
+
+    // Another descriptor gets its own table.
+    config.extra_controls = 20;
+    require(test_open_config(&c, &config, EIZO_OPEN_DEFAULT));
+    check_eq(eizo_get_controls(c.handle, &tc), n + 20);
+    check(tc != ta);
+
+    // What is left stays usable when the others are gone.
+    test_close(&a);
+    test_close(&c);
+    check_eq(test_get_u16(b.handle, EIZO_USAGE_BRIGHTNESS), 120);
+    check(eizo_control_find(b.handle, EIZO_USAGE_CONTRAST, nullptr));
+    test_close(&b);
+
+    // The table is freed with the last handle, a new one parses again.
+    require(test_open(&a, EIZO_OPEN_DEFAULT));
+    check_eq(eizo_get_controls(a.handle, &ta), n);
+    check_eq(test_get_u16(a.handle, EIZO_USAGE_BRIGHTNESS), 120);
+    test_close(&a);
+}
+
+int
+main()
+{
+    test_shared_controls();
+    return test_result();
+}
@@ -0,0 +1,172 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "test.h"
+#include "eizo/snapshot.h"
+
+constexpr int TEST_UPDATES = 200000;
+
+static atomic_bool test_done;
+
+static int64_t
+test_now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void *
+test_writer(void *arg)
+{
+    eizo_snapshot_t snapshot = arg;
+    for (int i = 1; i <= TEST_UPDATES; ++i) {
+        struct eizo_snapshot_monitor m = {
+            .fields = EIZO_SNAPSHOT_PRESENT | EIZO_SNAPSHOT_BRIGHTNESS | EIZO_SNAPSHOT_USAGE_TIME,
+            .brightness = (uint16_t)i,
+            .contrast = (uint16_t)~i,
+            .serial = (uint64_t)i,
+            .usage_time = i,
+        };
+        eizo_snapshot_update(snapshot, 3, &m);
+    }
+    atomic_store(&test_done, true);
+    return nullptr;
+}
+
+static void
+test_torn_reads()
+{
+    eizo_snapshot_t writer, reader;
+    require(eizo_snapshot_new(&writer) == EIZO_SUCCESS);
+    require(eizo_snapshot_map(eizo_snapshot_get_fd(writer), &reader) == EIZO_SUCCESS);
+
+    struct eizo_snapshot_monitor m;
+    check_eq(eizo_snapshot_read(reader, 3, &m), EIZO_INCOMPLETE);
+    check_eq(eizo_snapshot_read(reader, EIZO_SNAPSHOT_SLOTS, &m), EIZO_ERROR_INVALID_ARGUMENT);
+
+    pthread_t thread;
+    require(pthread_create(&thread, nullptr, test_writer, writer) == 0);
+
+    // Every copy either is one the writer published or is reported as
+    // raced, never a mix of two.
+    uint64_t last = 0;
+    int reads = 0;
+    while (!atomic_load(&test_done)) {
+        enum eizo_result res = eizo_snapshot_read(reader, 3, &m);
+        if (res != EIZO_SUCCESS) {
+            check(res == EIZO_INCOMPLETE || res == EIZO_ERROR_RACE_CONDITION);
+            continue;
+        }
+        check_eq(m.brightness, (uint16_t)m.serial);
+        check_eq(m.contrast, (uint16_t)~m.serial);
+        check_eq(m.usage_time, (int64_t)m.serial);
+        check(m.serial >= last);
+        last = m.serial;
+        ++reads;
+    }
+    pthread_join(thread, nullptr);
+
+    check(reads > 0);
+    check_eq(eizo_snapshot_read(reader, 3, &m), EIZO_SUCCESS);
+    check_eq(m.serial, TEST_UPDATES);
+    check_eq(eizo_snapshot_get_generation(reader), TEST_UPDATES);
+
+    check_eq(eizo_snapshot_update(writer, 3, nullptr), EIZO_SUCCESS);
+    check_eq(eizo_snapshot_read(reader, 3, &m), EIZO_INCOMPLETE);
+
+    eizo_snapshot_free(reader);
+    eizo_snapshot_free(writer);
+}
+
+static void
+test_read_only()
+{
+    eizo_snapshot_t writer;
+    require(eizo_snapshot_new(&writer) == EIZO_SUCCESS);
+
+    // Readers get an fd they can't write through.
+    int fd = eizo_snapshot_get_fd(writer);
+    long page = sysconf(_SC_PAGESIZE);
+    void *p = mmap(nullptr, (size_t)page, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    check(p == MAP_FAILED);
+    if (p != MAP_FAILED) {
+        munmap(p, (size_t)page);
+    }
+    check(write(fd, "x", 1) < 0);
+
+    eizo_snapshot_free(writer);
+}
+
+static void
+test_wait()
+{
+    eizo_snapshot_t writer, reader;
+    require(eizo_snapshot_new(&writer) == EIZO_SUCCESS);
+    require(eizo_snapshot_map(eizo_snapshot_get_fd(writer), &reader) == EIZO_SUCCESS);
+
+    uint32_t generation = eizo_snapshot_get_generation(reader);
+    int64_t start = test_now_ms();
+    check_eq(eizo_snapshot_wait(reader, generation, 100), EIZO_INCOMPLETE);
+    int64_t elapsed = test_now_ms() - start;
+    check(elapsed >= 100 && elapsed < 1000);
+
+    struct eizo_snapshot_monitor m = { .fields = EIZO_SNAPSHOT_PRESENT };
+    check_eq(eizo_snapshot_update(writer, 0, &m), EIZO_SUCCESS);
+    check_eq(eizo_snapshot_wait(reader, generation, 0), EIZO_SUCCESS);
+    check_eq(eizo_snapshot_get_generation(reader), generation + 1);
+
+    eizo_snapshot_free(reader);
+    eizo_snapshot_free(writer);
+}
+
+
+static void
+test_monitor_state()
+{
+    struct test_monitor m;
+    require(test_open(&m, EIZO_OPEN_DEFAULT));
+
+    // Only what the monitor has is filled in.
+    struct eizo_snapshot_monitor st = {};
+    eizo_snapshot_monitor_refresh(m.handle, &st);
+    uint32_t fields = EIZO_SNAPSHOT_BRIGHTNESS | EIZO_SNAPSHOT_CONTRAST | EIZO_SNAPSHOT_PROFILE
+        | EIZO_SNAPSHOT_INPUT_PORT | EIZO_SNAPSHOT_POWER | EIZO_SNAPSHOT_TEMPERATURE_1
+        | EIZO_SNAPSHOT_USAGE_TIME;
+    check_eq(st.fields, fields);
+    check_eq(st.brightness, 120);
+    check_eq(st.contrast, 100);
+    check_eq(st.input_port, 0x0300);
+    check_eq(st.power, 1);
+    check_eq(st.temperature[0], 38);
+    check_eq(st.usage_time, 0x1234 * 60);
+
+    // Values are decoded after the control, signed ones sign extended.
+    uint8_t v[2] = { 0xfb, 0 };
+    check(eizo_snapshot_monitor_apply(m.handle, &st, EIZO_USAGE_TEMPERATURE_1, v, 1));
+    check_eq(st.temperature[0], -5);
+    check(eizo_snapshot_monitor_apply(m.handle, &st, EIZO_USAGE_BRIGHTNESS, v, 2));
+    check_eq(st.brightness, 0xfb);
+    check(!eizo_snapshot_monitor_apply(m.handle, &st, EIZO_USAGE_GAMMA, v, 1));
+    check_eq(st.fields, fields);
+
+    // The value API the daemon serves from.
+    check_eq(eizo_get_value_size(m.handle, EIZO_USAGE_USAGE_TIME), 3);
+    check_eq(eizo_get_value_size(m.handle, 0xff00fffe), 0);
+
+    test_close(&m);
+}
+
+int
+main()
+{
+    test_torn_reads();
+    test_read_only();
+    test_wait();
+    test_monitor_state();
+    return test_result();
+}
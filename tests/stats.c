@@ -0,0 +1,71 @@
+#include "test.h"
+
+static uint64_t
+test_result_count(const struct eizo_op_stats *op, enum eizo_result res)
+{
+    return op->results[res - EIZO_STATS_RESULT_MIN];
+}
+
+static uint64_t
+test_latency_count(const struct eizo_op_stats *op)
+{
+    uint64_t n = 0;
+    for (size_t i = 0; i < EIZO_STATS_LATENCY_BUCKETS; ++i) {
+        n += op->latency[i];
+    }
+    return n;
+}
+
+static void
+test_stats()
+{
+    struct test_monitor m;
+    require(test_open(&m, EIZO_OPEN_DEFAULT));
+    eizo_reset_stats(m.handle);
+    uint64_t requests = eizo_emulator_get_request_count(m.emu);
+
+    struct eizo_stats stats;
+    eizo_get_stats(m.handle, &stats);
+    check_eq(stats.op[EIZO_STATS_GET_VALUE].count, 0);
+    check_eq(stats.get_feature + stats.set_feature, 0);
+
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 120);
+    check_eq(test_set_u16(m.handle, EIZO_USAGE_BRIGHTNESS, 80), EIZO_SUCCESS);
+    check(test_set_u16(m.handle, EIZO_USAGE_BRIGHTNESS, 250) < EIZO_SUCCESS);
+
+    // The retried get counts once, its failed verify is kept apart.
+    eizo_emulator_bump_counter(m.emu);
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 80);
+
+    eizo_get_stats(m.handle, &stats);
+    const struct eizo_op_stats *get = &stats.op[EIZO_STATS_GET_VALUE];
+    const struct eizo_op_stats *set = &stats.op[EIZO_STATS_SET_VALUE];
+    const struct eizo_op_stats *verify = &stats.op[EIZO_STATS_VERIFY];
+    check_eq(get->count, 2);
+    check_eq(test_result_count(get, EIZO_SUCCESS), 2);
+    check_eq(test_latency_count(get), 2);
+    check_eq(set->count, 2);
+    check_eq(test_result_count(set, EIZO_SUCCESS), 1);
+    check_eq(test_result_count(verify, EIZO_ERROR_RACE_CONDITION), 1);
+    check_eq(verify->count, 5);
+    check(get->total_ns > 0);
+
+    // Every request the emulator served is a feature report.
+    check_eq(stats.get_feature + stats.set_feature, eizo_emulator_get_request_count(m.emu) - requests);
+    check(stats.bytes_short > 0);
+    check_eq(stats.bytes_long, 0);
+
+    eizo_reset_stats(m.handle);
+    eizo_get_stats(m.handle, &stats);
+    check_eq(stats.op[EIZO_STATS_VERIFY].count, 0);
+    check_eq(stats.get_feature, 0);
+
+    test_close(&m);
+}
+
+int
+main()
+{
+    test_stats();
+    return test_result();
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "eizo/handle.h"
+#include "eizo/emulator.h"
+#include "internal.h"
+
+// Every test is a program of its own that runs all of its checks and
+// exits non-zero if any of them failed.
+static int test_failures;
+
+#define check(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: %s: check failed: %s\n", __FILE__, __LINE__, __func__, #cond); \
+            ++test_failures; \
+        } \
+    } while (0)
+
+#define check_eq(a, b) \
+    do { \
+        long long _a = (long long)(a), _b = (long long)(b); \
+        if (_a != _b) { \
+            fprintf(stderr, "%s:%d: %s: %s == %s failed: %lld != %lld\n", \
+                    __FILE__, __LINE__, __func__, #a, #b, _a, _b); \
+            ++test_failures; \
+        } \
+    } while (0)
+
+// Give up on the current test function.
+#define require(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: %s: requirement failed: %s\n", __FILE__, __LINE__, __func__, #cond); \
+            ++test_failures; \
+            return; \
+        } \
+    } while (0)
+
+static inline int
+test_result()
+{
+    return test_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// An emulated EV2760 with nothing else set.
+static inline struct eizo_emulator_config
+test_config()
+{
+    return (struct eizo_emulator_config) {
+        .pid = EIZO_PID_FLEXSCAN_EV2760,
+        .serial = 12345678,
+        .product = "EV2760",
+    };
+}
+
+struct test_monitor {
+    eizo_emulator_t emu;
+    eizo_handle_t handle;
+};
+
+static inline bool
+test_open_config(struct test_monitor *m, const struct eizo_emulator_config *config, enum eizo_open_flags flags)
+{
+    m->handle = nullptr;
+    if (eizo_emulator_new(config, &m->emu) < EIZO_SUCCESS) {
+        m->emu = nullptr;
+        return false;
+    }
+    return eizo_emulator_open(m->emu, flags, &m->handle) >= EIZO_SUCCESS;
+}
+
+static inline bool
+test_open(struct test_monitor *m, enum eizo_open_flags flags)
+{
+    struct eizo_emulator_config config = test_config();
+    return test_open_config(m, &config, flags);
+}
+
+static inline void
+test_close(struct test_monitor *m)
+{
+    if (m->handle) {
+        eizo_close(m->handle);
+    }
+    if (m->emu) {
+        eizo_emulator_free(m->emu);
+    }
+}
+
+static inline uint16_t
+test_get_u16(eizo_handle_t handle, enum eizo_usage usage)
+{
+    uint8_t v[2] = {};
+    check_eq(eizo_get_value(handle, usage, v, sizeof(v)), EIZO_SUCCESS);
+    return (uint16_t)(v[0] | v[1] << 8);
+}
+
+static inline enum eizo_result
+test_set_u16(eizo_handle_t handle, enum eizo_usage usage, uint16_t x)
+{
+    uint8_t v[2] = { (uint8_t)x, (uint8_t)(x >> 8) };
+    return eizo_set_value(handle, usage, v, sizeof(v));
+}
@@ -0,0 +1,155 @@
+#include <string.h>
+
+#include "test.h"
+#include "eizo/lut.h"
+
+// The front LUT is self addressed, three channels of 16 bit entries.
+constexpr size_t TEST_LUT_SIZE = 3 * EIZO_LUT_ENTRIES * sizeof(uint16_t);
+
+struct test_transfer {
+    enum eizo_usage offset_size;
+    enum eizo_usage data;
+    uint8_t *buf;
+    size_t len;
+    // Repeat the write with the same transfer.
+    uint8_t *again;
+    size_t size;
+};
+
+static enum eizo_result
+test_read_job(struct eizo_handle *handle, void *arg)
+{
+    struct test_transfer *a = arg;
+    struct eizo_transfer t;
+    enum eizo_result res = eizo_transfer_begin(handle, &t, a->offset_size, a->data);
+    if (res < EIZO_SUCCESS) {
+        return res;
+    }
+    if (!a->offset_size) {
+        t.size = a->len;
+    }
+    a->size = t.size;
+    if (t.size > a->len) {
+        return EIZO_ERROR_INVALID_ARGUMENT;
+    }
+    return eizo_transfer_read(handle, &t, a->buf);
+}
+
+static enum eizo_result
+test_write_job(struct eizo_handle *handle, void *arg)
+{
+    struct test_transfer *a = arg;
+    struct eizo_transfer t;
+    enum eizo_result res = eizo_transfer_begin(handle, &t, a->offset_size, a->data);
+    if (res < EIZO_SUCCESS) {
+        return res;
+    }
+    res = eizo_transfer_write(handle, &t, a->buf, a->len);
+    if (res < EIZO_SUCCESS || !a->again) {
+        return res;
+    }
+    return eizo_transfer_write(handle, &t, a->again, a->len);
+}
+
+static void
+test_fill(uint8_t *buf, size_t len, uint8_t seed)
+{
+    for (size_t i = 0; i < len; ++i) {
+        buf[i] = (uint8_t)(i * 7 + seed);
+    }
+}
+
+static void
+test_self_addressed()
+{
+    struct test_monitor m;
+    require(test_open(&m, EIZO_OPEN_DEFAULT));
+
+    static uint8_t a[TEST_LUT_SIZE], b[TEST_LUT_SIZE], back[TEST_LUT_SIZE];
+    test_fill(a, sizeof(a), 1);
+    test_fill(b, sizeof(b), 2);
+
+    struct test_transfer w = { 0, EIZO_USAGE_FRONT_LUT, a, sizeof(a) };
+    struct test_transfer r = { 0, EIZO_USAGE_FRONT_LUT, back, sizeof(back) };
+    check_eq(eizo_io_run(m.handle, EIZO_IO_LONG, test_write_job, &w), EIZO_SUCCESS);
+    check_eq(eizo_io_run(m.handle, EIZO_IO_LONG, test_read_job, &r), EIZO_SUCCESS);
+    check(memcmp(back, a, sizeof(a)) == 0);
+
+    // A completed write of the same length starts over.
+    w.again = b;
+    check_eq(eizo_io_run(m.handle, EIZO_IO_LONG, test_write_job, &w), EIZO_SUCCESS);
+    check_eq(eizo_io_run(m.handle, EIZO_IO_LONG, test_read_job, &r), EIZO_SUCCESS);
+    check(memcmp(back, b, sizeof(b)) == 0);
+
+    test_close(&m);
+}
+
+static void
+test_resume()
+{
+    struct test_monitor m;
+    require(test_open(&m, EIZO_OPEN_DEFAULT));
+
+    static uint8_t a[TEST_LUT_SIZE], back[TEST_LUT_SIZE];
+    test_fill(a, sizeof(a), 3);
+
+    // Taking over the monitor in the middle of a transfer makes it continue
+    // where it stopped with the new counter.
+    struct test_transfer w = { 0, EIZO_USAGE_FRONT_LUT, a, sizeof(a) };
+    eizo_emulator_bump_counter_after(m.emu, 5);
+    uint64_t requests = eizo_emulator_get_request_count(m.emu);
+    check_eq(eizo_io_run(m.handle, EIZO_IO_LONG, test_write_job, &w), EIZO_SUCCESS);
+    uint64_t written = eizo_emulator_get_request_count(m.emu) - requests;
+
+    struct test_transfer r = { 0, EIZO_USAGE_FRONT_LUT, back, sizeof(back) };
+    eizo_emulator_bump_counter_after(m.emu, 5);
+    check_eq(eizo_io_run(m.handle, EIZO_IO_LONG, test_read_job, &r), EIZO_SUCCESS);
+    check(memcmp(back, a, sizeof(a)) == 0);
+
+    // Only the interrupted page went out again, not the whole object.
+    eizo_emulator_bump_counter_after(m.emu, 0);
+    requests = eizo_emulator_get_request_count(m.emu);
+    check_eq(eizo_io_run(m.handle, EIZO_IO_LONG, test_write_job, &w), EIZO_SUCCESS);
+    uint64_t clean = eizo_emulator_get_request_count(m.emu) - requests;
+    check(written > clean);
+    check(written < 2 * clean);
+
+    test_close(&m);
+}
+
+static void
+test_offset_size()
+{
+    struct test_monitor m;
+    require(test_open(&m, EIZO_OPEN_DEFAULT));
+
+    // The offset/size usage tells the size, and the position is seeked to
+    // again after a race.
+    uint8_t clean[1024], raced[1024];
+    struct test_transfer r = {
+        EIZO_USAGE_EV_AVAILABLE_CUSTOM_KEY_LOCK_OFFSET_SIZE,
+        EIZO_USAGE_EV_AVAILABLE_CUSTOM_KEY_LOCK_DATA,
+        clean,
+        sizeof(clean),
+    };
+    check_eq(eizo_io_run(m.handle, EIZO_IO_LONG, test_read_job, &r), EIZO_SUCCESS);
+    size_t size = r.size;
+    check(size > 62);
+
+    r.buf = raced;
+    eizo_emulator_bump_counter_after(m.emu, 3);
+    check_eq(eizo_io_run(m.handle, EIZO_IO_LONG, test_read_job, &r), EIZO_SUCCESS);
+    check_eq(r.size, size);
+    check(memcmp(clean, raced, size) == 0);
+
+    test_close(&m);
+}
+
+int
+main()
+{
+    test_self_addressed();
+    test_resume();
+    test_offset_size();
+    return test_result();
+}
@@ -0,0 +1,31 @@
+#include "test.h"
+
+static void
+test_usage_names()
+{
+    for (size_t i = 0; i < eizo_usage_table.n; ++i) {
+        const struct eizo_usage_info *info = &eizo_usage_table.info[i];
+        check(eizo_usage_get_info(info->usage) == info);
+
+        const char *name = eizo_usage_to_string(info->usage);
+        require(name);
+        const struct eizo_usage_info *found = eizo_usage_from_string(name);
+        require(found);
+        check_eq(found->usage, info->usage);
+    }
+
+    const struct eizo_usage_info *info = eizo_usage_from_string("brightness");
+    require(info);
+    check_eq(info->usage, EIZO_USAGE_BRIGHTNESS);
+    check(eizo_usage_from_string("") == nullptr);
+    check(eizo_usage_from_string("brightnes") == nullptr);
+    check(eizo_usage_from_string("BRIGHTNESS_") == nullptr);
+    check(eizo_usage_get_info((enum eizo_usage)0x12340001) == nullptr);
+}
+
+int
+main()
+{
+    test_usage_names();
+    return test_result();
+}
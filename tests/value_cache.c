@@ -0,0 +1,51 @@
+#include "test.h"
+
+static void
+test_value_cache()
+{
+    struct test_monitor m;
+    require(test_open(&m, EIZO_OPEN_DEFAULT));
+    require(eizo_enable_value_cache(m.handle, 60000) == EIZO_SUCCESS);
+
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 120);
+    uint64_t requests = eizo_emulator_get_request_count(m.emu);
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 120);
+    check_eq(eizo_emulator_get_request_count(m.emu), requests);
+
+    // A change on the OSD arrives as an input report and drops the entry.
+    uint8_t osd[2] = { 42, 0 };
+    check_eq(eizo_emulator_set_value(m.emu, EIZO_USAGE_BRIGHTNESS, osd, sizeof(osd)), EIZO_SUCCESS);
+    check_eq(eizo_dispatch(m.handle), 1);
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 42);
+    check(eizo_emulator_get_request_count(m.emu) > requests);
+
+    // So does a set through the handle.
+    check_eq(test_set_u16(m.handle, EIZO_USAGE_BRIGHTNESS, 60), EIZO_SUCCESS);
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 60);
+
+    // A ttl of 0 always asks the monitor.
+    check_eq(eizo_set_value_cache_ttl(m.handle, EIZO_USAGE_BRIGHTNESS, 0), EIZO_SUCCESS);
+    requests = eizo_emulator_get_request_count(m.emu);
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 60);
+    check(eizo_emulator_get_request_count(m.emu) > requests);
+
+    // Other usages keep the handle wide ttl.
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_CONTRAST), 100);
+    requests = eizo_emulator_get_request_count(m.emu);
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_CONTRAST), 100);
+    check_eq(eizo_emulator_get_request_count(m.emu), requests);
+
+    eizo_disable_value_cache(m.handle);
+    check_eq(eizo_set_value_cache_ttl(m.handle, EIZO_USAGE_BRIGHTNESS, 0), EIZO_ERROR_INVALID_ARGUMENT);
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_CONTRAST), 100);
+    check(eizo_emulator_get_request_count(m.emu) > requests);
+
+    test_close(&m);
+}
+
+int
+main()
+{
+    test_value_cache();
+    return test_result();
+}
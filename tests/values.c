@@ -0,0 +1,47 @@
+#include "test.h"
+
+// Not a control of the emulator.
+constexpr uint32_t TEST_USAGE_MISSING = 0xff00fffe;
+
+static void
+test_get_set()
+{
+    struct test_monitor m;
+    require(test_open(&m, EIZO_OPEN_DEFAULT));
+
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 120);
+    check_eq(test_set_u16(m.handle, EIZO_USAGE_BRIGHTNESS, 80), EIZO_SUCCESS);
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 80);
+
+    // Above the logical maximum, the monitor refuses it.
+    check(test_set_u16(m.handle, EIZO_USAGE_BRIGHTNESS, 250) < EIZO_SUCCESS);
+    check_eq(test_get_u16(m.handle, EIZO_USAGE_BRIGHTNESS), 80);
+
+    // Usages the monitor doesn't have never reach it.
+    uint64_t requests = eizo_emulator_get_request_count(m.emu);
+    uint8_t v[2];
+    check_eq(eizo_get_value(m.handle, TEST_USAGE_MISSING, v, sizeof(v)), EIZO_ERROR_INVALID_USAGE);
+    check_eq(eizo_emulator_get_request_count(m.emu), requests);
+
+    enum eizo_usage usages[] = { EIZO_USAGE_BRIGHTNESS, (enum eizo_usage)TEST_USAGE_MISSING, EIZO_USAGE_CONTRAST };
+    uint8_t a[2], b[2], c[2];
+    uint8_t *const values[] = { a, b, c };
+    size_t lens[] = { 2, 2, 2 };
+    enum eizo_result results[3];
+    check_eq(eizo_get_values(m.handle, usages, 3, values, lens, results), EIZO_INCOMPLETE);
+    check_eq(results[0], EIZO_SUCCESS);
+    check_eq(results[1], EIZO_ERROR_INVALID_USAGE);
+    check_eq(results[2], EIZO_SUCCESS);
+    check_eq(lens[1], 0);
+    check_eq(a[0], 80);
+    check_eq(c[0], 100);
+
+    test_close(&m);
+}
+
+int
+main()
+{
+    test_get_set();
+    return test_result();
+}